@@ -0,0 +1,120 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Capture multi-megabyte command substitution outputs with
+ * execute_capture, against a capture that reads a default-sized pipe
+ * 4 KB at a time into a buffer grown to fit each read exactly, as
+ * appending with an exact-size Str would.
+ */
+
+#define ROUNDS 5
+#define NAIVE_READ 4096
+
+static void make_file(const char *path, size_t bytes)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    char block[1 << 16];
+    memset(block, 'x', sizeof(block));
+    for (size_t i = 63; i < sizeof(block); i += 64) {
+        block[i] = '\n';
+    }
+    for (size_t written = 0; written < bytes; written += sizeof(block)) {
+        if (write(fd, block, sizeof(block)) != sizeof(block)) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(fd);
+}
+
+typedef struct NaiveJob {
+    const Node *tree;
+    int out;
+} NaiveJob;
+
+static void* run_naive(void *arg)
+{
+    NaiveJob *job = arg;
+    execute(job->tree, STDIN_FILENO, job->out);
+    close(job->out);
+    return NULL;
+}
+
+static size_t capture_naive(const Node *tree)
+{
+    int ends[2];
+    pipe2(ends, O_CLOEXEC);
+    NaiveJob job = { tree, ends[1] };
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_naive, &job);
+    char *buffer = NULL;
+    size_t length = 0;
+    char chunk[NAIVE_READ];
+    ssize_t n;
+    while ((n = read(ends[0], chunk, sizeof(chunk))) > 0) {
+        buffer = realloc(buffer, length + n + 1);
+        memcpy(buffer + length, chunk, n);
+        length += n;
+        buffer[length] = '\0';
+    }
+    close(ends[0]);
+    pthread_join(thread, NULL);
+    free(buffer);
+    return length;
+}
+
+static size_t capture(const Node *tree)
+{
+    Str out = Str_value(0);
+    execute_capture(tree, STDIN_FILENO, &out);
+    size_t length = Str_length(&out);
+    Str_drop(&out);
+    return length;
+}
+
+static double throughput(const Node *tree, size_t (*run)(const Node*))
+{
+    uint64_t start = Profile_now();
+    size_t bytes = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        bytes += run(tree);
+    }
+    uint64_t elapsed = Profile_now() - start;
+    return bytes / 1e6 / (elapsed / 1e9);
+}
+
+int main()
+{
+    char path[] = "/tmp/thsh_capture_bench_XXXXXX";
+    close(mkstemp(path));
+    size_t sizes[] = { 1 << 20, 16 << 20, 64 << 20 };
+    const char *commands[][2] = {
+        { "cat %s", "builtin cat" },
+        { "/bin/cat %s", "/bin/cat" },
+    };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        make_file(path, sizes[i]);
+        printf("%zu MB output\n", sizes[i] >> 20);
+        for (size_t j = 0; j < sizeof(commands) / sizeof(commands[0]); ++j) {
+            char line[256];
+            snprintf(line, sizeof(line), commands[j][0], path);
+            Scanner scanner = Scanner_value(CharItr_value(line, strlen(line)));
+            Node *tree = parse(&scanner);
+            printf("  %-12s execute_capture %8.1f MB/s   naive %8.1f MB/s\n", commands[j][1],
+                    throughput(tree, capture), throughput(tree, capture_naive));
+            Node_drop(tree);
+        }
+    }
+    unlink(path);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Env.h"
+#include "Exec.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Launch overhead with 500 exported variables. First the envp alone:
+ * built for every launch, a "name=value" string per variable, against
+ * taken from the Env's cached block. Then whole launches of a command,
+ * with the variables exported and without.
+ */
+
+#define VARIABLES 500
+#define BUILDS 20000
+#define LAUNCHES 2000
+
+/* An envp of the exported variables built from scratch, as per launch. */
+static char** naive_envp(Env *env, char *const names[])
+{
+    char **envp = malloc((VARIABLES + 1) * sizeof(char*));
+    Str value = Str_value(64);
+    for (int i = 0; i < VARIABLES; ++i) {
+        Str_splice(&value, 0, Str_length(&value), NULL, 0);
+        Env_get(env, names[i], strlen(names[i]), &value);
+        size_t name_length = strlen(names[i]);
+        envp[i] = malloc(name_length + Str_length(&value) + 2);
+        memcpy(envp[i], names[i], name_length);
+        envp[i][name_length] = '=';
+        memcpy(envp[i] + name_length + 1, Str_cstr(&value), Str_length(&value) + 1);
+    }
+    envp[VARIABLES] = NULL;
+    Str_drop(&value);
+    return envp;
+}
+
+static void free_envp(char **envp)
+{
+    for (char **entry = envp; *entry != NULL; ++entry) {
+        free(*entry);
+    }
+    free(envp);
+}
+
+/* Launches per second of `line`. */
+static double launches(const char *line, int out)
+{
+    Scanner scanner = Scanner_value(CharItr_value(line, strlen(line)));
+    Node *tree = parse(&scanner);
+    uint64_t start = Profile_now();
+    for (int round = 0; round < LAUNCHES; ++round) {
+        if (execute(tree, STDIN_FILENO, out) != 0) {
+            fprintf(stderr, "%s failed\n", line);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t elapsed = Profile_now() - start;
+    Node_drop(tree);
+    return LAUNCHES / (elapsed / 1e9);
+}
+
+int main()
+{
+    int out = open("/dev/null", O_WRONLY);
+    double bare = launches("/bin/true", out);
+
+    Env *env = Env_shell();
+    char *names[VARIABLES];
+    for (int i = 0; i < VARIABLES; ++i) {
+        char name[32], value[64];
+        snprintf(name, sizeof(name), "THSH_BENCH_%d", i);
+        snprintf(value, sizeof(value), "value of variable number %d", i);
+        names[i] = strdup(name);
+        Env_export(env, name, value);
+    }
+
+    uint64_t start = Profile_now();
+    for (int round = 0; round < BUILDS; ++round) {
+        free_envp(naive_envp(env, names));
+    }
+    double naive = (Profile_now() - start) / (double) BUILDS;
+
+    start = Profile_now();
+    for (int round = 0; round < BUILDS; ++round) {
+        EnvBlock_drop(Env_block(env));
+    }
+    double cached = (Profile_now() - start) / (double) BUILDS;
+
+    start = Profile_now();
+    for (int round = 0; round < BUILDS; ++round) {
+        Env_set(env, names[round % VARIABLES], round % 2 == 0 ? "even" : "odd");
+        EnvBlock_drop(Env_block(env));
+    }
+    double changed = (Profile_now() - start) / (double) BUILDS;
+
+    double exported = launches("/bin/true", out);
+
+    printf("%d exported variables\n", VARIABLES);
+    printf("  envp, ns    rebuilt per launch %10.0f   cached %8.0f   after each change %10.0f\n",
+            naive, cached, changed);
+    printf("  launches/s  few exported %10.0f   %d exported %10.0f\n",
+            bare, VARIABLES, exported);
+
+    for (int i = 0; i < VARIABLES; ++i) {
+        Env_unset(env, names[i]);
+        free(names[i]);
+    }
+    close(out);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Time `cat big | wc -c` with the builtin cat, which splices the file
+ * into the pipe, against /bin/cat. A second pipeline adds a cat
+ * between two pipes, where the builtin splices pipe to pipe.
+ */
+
+#define FILE_BYTES (256 << 20)
+#define ROUNDS 5
+
+static void make_file(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    char block[1 << 16];
+    memset(block, 'x', sizeof(block));
+    for (size_t written = 0; written < FILE_BYTES; written += sizeof(block)) {
+        if (write(fd, block, sizeof(block)) != sizeof(block)) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+    }
+    close(fd);
+}
+
+static double throughput(const char *line)
+{
+    Scanner scanner = Scanner_value(CharItr_value(line, strlen(line)));
+    Node *tree = parse(&scanner);
+    int out = open("/dev/null", O_WRONLY);
+    uint64_t start = Profile_now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        if (execute(tree, STDIN_FILENO, out) != 0) {
+            fprintf(stderr, "%s failed\n", line);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t elapsed = Profile_now() - start;
+    close(out);
+    Node_drop(tree);
+    return (double) ROUNDS * FILE_BYTES / 1e6 / (elapsed / 1e9);
+}
+
+int main()
+{
+    char path[] = "/tmp/thsh_io_bench_XXXXXX";
+    close(mkstemp(path));
+    make_file(path);
+
+    const char *pipelines[][2] = {
+        { "cat %s | wc -c", "builtin cat | wc -c" },
+        { "/bin/cat %s | wc -c", "/bin/cat | wc -c" },
+        { "cat %s | cat | wc -c", "builtin cat | cat | wc -c" },
+        { "/bin/cat %s | /bin/cat | wc -c", "/bin/cat | /bin/cat | wc -c" },
+    };
+    printf("file: %d MB, %d rounds\n", FILE_BYTES >> 20, ROUNDS);
+    for (size_t i = 0; i < sizeof(pipelines) / sizeof(pipelines[0]); ++i) {
+        char line[256];
+        snprintf(line, sizeof(line), pipelines[i][0], path);
+        printf("%-30s %8.0f MB/s\n", pipelines[i][1], throughput(line));
+    }
+    unlink(path);
+    return EXIT_SUCCESS;
+}
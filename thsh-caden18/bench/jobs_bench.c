@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "JobTable.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Cost of reaping finished background jobs while many others are
+ * still running. Reaping is driven by one event per exited process,
+ * so the cost per job should not grow with the number still running.
+ */
+
+#define FINISHING 500
+
+static void start(JobTable *jobs, const char *line, size_t count)
+{
+    Scanner scanner = Scanner_value(CharItr_value(line, strlen(line)));
+    Node *tree = parse(&scanner);
+    int out = open("/dev/null", O_WRONLY);
+    for (size_t i = 0; i < count; ++i) {
+        execute_with(tree, STDIN_FILENO, out, jobs);
+    }
+    close(out);
+    Node_drop(tree);
+}
+
+static double reap_cost(size_t running)
+{
+    JobTable jobs = JobTable_value(-1);
+    start(&jobs, "sleep 2 &", running);
+    start(&jobs, "true &", FINISHING);
+    struct timespec pause = { 0, 200 * 1000 * 1000 };
+    nanosleep(&pause, NULL);
+
+    uint64_t begin = Profile_now();
+    size_t reaped = 0;
+    while (reaped < FINISHING) {
+        reaped += JobTable_poll(&jobs, -1);
+    }
+    uint64_t elapsed = Profile_now() - begin;
+
+    FILE *sink = fopen("/dev/null", "w");
+    JobTable_notify(&jobs, sink);
+    while (JobTable_count(&jobs) > 0) {
+        JobTable_poll(&jobs, -1);
+        JobTable_notify(&jobs, sink);
+    }
+    fclose(sink);
+    JobTable_drop(&jobs);
+    return elapsed / 1e3 / FINISHING;
+}
+
+int main()
+{
+    size_t running[] = { 0, 100, 1000 };
+    printf("%d finishing jobs\n", FINISHING);
+    for (size_t i = 0; i < sizeof(running) / sizeof(running[0]); ++i) {
+        printf("%5zu running  %6.2f us per reaped job\n", running[i], reap_cost(running[i]));
+    }
+    return EXIT_SUCCESS;
+}
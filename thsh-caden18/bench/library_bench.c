@@ -0,0 +1,72 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Profile.h"
+#include "thsh.h"
+
+/*
+ * Parse the same lines with thsh_parse from 1, 2, 4, ... threads up to
+ * the number of online cores, each thread with its own Arena, and
+ * report total parses per second. Threads share nothing, so throughput
+ * should scale with cores.
+ */
+
+#define PARSES_PER_THREAD 200000
+
+static const char *lines[] = {
+    "ls -lah /var/log | grep -e error | sort | uniq -c",
+    "echo building target release with flags -O2 -g",
+    "cat results.txt | tail -n 100 | wc -l",
+};
+
+static void* worker(void *arg)
+{
+    size_t *failures = arg;
+    Arena arena = Arena_value(4096);
+    thsh_options options = { 1 << 16, 1 << 20 };
+    for (size_t i = 0; i < PARSES_PER_THREAD; ++i) {
+        const char *line = lines[i % 3];
+        thsh_result result;
+        if (thsh_parse(line, strlen(line), &options, &arena, &result) != THSH_OK) {
+            ++*failures;
+        }
+        Arena_reset(&arena);
+    }
+    Arena_drop(&arena);
+    return NULL;
+}
+
+int main()
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("%d parses per thread, %ld cores\n", PARSES_PER_THREAD, cores);
+
+    double single = 0;
+    for (long threads = 1; threads <= cores; threads *= 2) {
+        pthread_t ids[threads];
+        size_t failures[threads];
+        uint64_t start = Profile_now();
+        for (long t = 0; t < threads; ++t) {
+            failures[t] = 0;
+            pthread_create(&ids[t], NULL, worker, &failures[t]);
+        }
+        for (long t = 0; t < threads; ++t) {
+            pthread_join(ids[t], NULL);
+            if (failures[t] != 0) {
+                fprintf(stderr, "unexpected parse failure\n");
+                return EXIT_FAILURE;
+            }
+        }
+        uint64_t elapsed = Profile_now() - start;
+        double rate = (double) threads * PARSES_PER_THREAD / (elapsed / 1e9);
+        if (threads == 1) {
+            single = rate;
+        }
+        printf("%2ld threads   %12.0f parses/s  %5.2fx\n", threads, rate, rate / single);
+    }
+    return EXIT_SUCCESS;
+}
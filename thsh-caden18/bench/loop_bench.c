@@ -0,0 +1,80 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Per-iteration cost of a for loop of 1M iterations whose body runs
+ * only builtins, its tree parsed once, against scanning and parsing
+ * the body again on every iteration with the variable substituted
+ * into its text, as a shell that re-reads loop bodies would.
+ */
+
+#define ITERATIONS 1000000
+
+static const char *BODIES[] = {
+    "true",
+    "echo $i",
+    "true && echo $i; false || true",
+};
+
+static Node* parse_text(const char *text)
+{
+    Scanner scanner = Scanner_value(CharItr_value(text, strlen(text)));
+    return parse(&scanner);
+}
+
+/* Nanoseconds per iteration of the loop run as one parsed tree. */
+static double parsed_once(const char *body, int out)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "for i in $(seq %d); do %s; done", ITERATIONS, body);
+    Node *tree = parse_text(line);
+    uint64_t start = Profile_now();
+    execute(tree, STDIN_FILENO, out);
+    uint64_t elapsed = Profile_now() - start;
+    Node_drop(tree);
+    return (double) elapsed / ITERATIONS;
+}
+
+/* Nanoseconds per iteration when each iteration parses its body. */
+static double reparsed(const char *body, int out)
+{
+    uint64_t start = Profile_now();
+    for (int i = 1; i <= ITERATIONS; ++i) {
+        char text[256];
+        size_t length = 0;
+        for (const char *c = body; *c != '\0' && length + 16 < sizeof(text); ++c) {
+            if (c[0] == '$' && c[1] == 'i') {
+                length += snprintf(text + length, sizeof(text) - length, "%d", i);
+                ++c;
+            } else {
+                text[length++] = *c;
+            }
+        }
+        text[length] = '\0';
+        Node *tree = parse_text(text);
+        execute(tree, STDIN_FILENO, out);
+        Node_drop(tree);
+    }
+    uint64_t elapsed = Profile_now() - start;
+    return (double) elapsed / ITERATIONS;
+}
+
+int main()
+{
+    int out = open("/dev/null", O_WRONLY);
+    printf("%d iterations, ns per iteration\n", ITERATIONS);
+    for (size_t i = 0; i < sizeof(BODIES) / sizeof(BODIES[0]); ++i) {
+        printf("%-32s parsed once %7.0f   reparsed %7.0f\n", BODIES[i],
+                parsed_once(BODIES[i], out), reparsed(BODIES[i], out));
+    }
+    close(out);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ParallelScan.h"
+#include "Profile.h"
+
+/*
+ * Scan a generated script with 1, 2, 4, ... threads up to the number
+ * of online cores and report throughput and speedup over sequential.
+ */
+
+#define SCRIPT_BYTES (64 << 20)
+#define CHUNK_BYTES (1 << 20)
+
+static char* make_script(size_t *length)
+{
+    static const char *lines[] = {
+        "ls -lah /var/log | grep -e error | sort | uniq -c\n",
+        "echo building target release with flags -O2 -g\n",
+        "cat results.txt | tail -n 100 | wc -l\n",
+    };
+    char *script = malloc(SCRIPT_BYTES + 64);
+    size_t used = 0;
+    for (size_t i = 0; used < SCRIPT_BYTES; ++i) {
+        const char *line = lines[i % 3];
+        size_t n = strlen(line);
+        memcpy(script + used, line, n);
+        used += n;
+    }
+    *length = used;
+    return script;
+}
+
+int main()
+{
+    size_t length;
+    char *script = make_script(&length);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    uint64_t start = Profile_now();
+    TokenSpans spans = TokenSpans_scan(script, length);
+    uint64_t sequential = Profile_now() - start;
+    size_t tokens = Vec_length(&spans);
+    Vec_drop(&spans);
+
+    printf("script: %zu MB, %zu tokens, %ld cores\n", length >> 20, tokens, cores);
+    printf("tokens per MB: %zu (%zu KB at %zu bytes per Token)\n",
+            tokens / (length >> 20), tokens / (length >> 20) * sizeof(Token) >> 10, sizeof(Token));
+    printf("%-12s %10.1f MB/s\n", "sequential", length / 1e6 / (sequential / 1e9));
+    for (long threads = 1; threads <= cores; threads *= 2) {
+        start = Profile_now();
+        spans = TokenSpans_scan_parallel(script, length, threads, CHUNK_BYTES);
+        uint64_t elapsed = Profile_now() - start;
+        if (Vec_length(&spans) != tokens) {
+            fprintf(stderr, "token count mismatch\n");
+            return EXIT_FAILURE;
+        }
+        Vec_drop(&spans);
+        printf("%2ld threads   %10.1f MB/s  %5.2fx\n", threads,
+                length / 1e6 / (elapsed / 1e9), (double) sequential / elapsed);
+    }
+
+    free(script);
+    return EXIT_SUCCESS;
+}
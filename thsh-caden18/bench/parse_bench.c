@@ -0,0 +1,99 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MemStats.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Parse a generated 1 MB script line by line with the libc allocator
+ * and report, per MB of script, the nodes and heap bytes of the parse
+ * trees, the allocations made building them, and parse throughput.
+ */
+
+#define SCRIPT_BYTES (1 << 20)
+#define ROUNDS 20
+#define MAX_SITES 64
+
+static const char *lines[] = {
+    "ls -lah /var/log | grep -e error | sort | uniq -c\n",
+    "echo building target release with flags -O2 -g\n",
+    "cat results.txt | tail -n 100 | wc -l\n",
+    "make\n",
+};
+
+static char* make_script(size_t *length)
+{
+    char *script = malloc(SCRIPT_BYTES + 64);
+    size_t used = 0;
+    for (size_t i = 0; used < SCRIPT_BYTES; ++i) {
+        const char *line = lines[i % 4];
+        size_t n = strlen(line);
+        memcpy(script + used, line, n);
+        used += n;
+    }
+    *length = used;
+    return script;
+}
+
+static size_t count_nodes(const Node *node)
+{
+    size_t count = 1;
+    while (node->type == PIPE_NODE) {
+        count += 1 + count_nodes(node->data.pipe.left);
+        node = node->data.pipe.right;
+    }
+    return count;
+}
+
+/* Parse each line of `script`, adding up the trees' nodes and bytes. */
+static void parse_all(const char *script, size_t length, size_t *nodes, size_t *bytes)
+{
+    const char *line = script;
+    const char *end = script + length;
+    while (line < end) {
+        const char *newline = memchr(line, '\n', end - line);
+        size_t n = (newline == NULL ? end : newline) - line;
+        Scanner scanner = Scanner_value(CharItr_value(line, n));
+        Node *tree = parse(&scanner);
+        if (nodes != NULL) {
+            *nodes += count_nodes(tree);
+            *bytes += Node_footprint(tree);
+        }
+        Node_drop(tree);
+        line += n + 1;
+    }
+}
+
+int main()
+{
+    size_t length;
+    char *script = make_script(&length);
+
+    uint64_t start = Profile_now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        parse_all(script, length, NULL, NULL);
+    }
+    uint64_t elapsed = Profile_now() - start;
+
+    /* Tracking slows allocation, so count only after timing. */
+    size_t nodes = 0;
+    size_t bytes = 0;
+    MemStats_enable();
+    parse_all(script, length, &nodes, &bytes);
+    MemSite sites[MAX_SITES];
+    size_t count = MemStats_sites(sites, MAX_SITES);
+    size_t allocations = 0;
+    for (size_t i = 0; i < count; ++i) {
+        allocations += sites[i].allocs + sites[i].reallocs;
+    }
+
+    printf("per MB of script: %zu nodes, %zu tree bytes, %zu allocations\n",
+            nodes, bytes, allocations);
+    printf("node size: %zu bytes\n", sizeof(Node));
+    printf("parse: %.1f MB/s\n", ROUNDS * length / 1e6 / (elapsed / 1e9));
+    free(script);
+    return EXIT_SUCCESS;
+}
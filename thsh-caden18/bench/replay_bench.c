@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LineReader.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Replay a large script through the LineReader with io_uring
+ * read-ahead, through the LineReader with blocking pread(2), and
+ * through getline(3) as main used to: once only splitting lines, where
+ * reading dominates, and once parsing every line as well.
+ */
+
+#define SCRIPT_BYTES (16 << 20)
+#define ROUNDS 3
+
+static const char *LINES[] = {
+    "echo hello world\n",
+    "ls -l /tmp | grep thsh | wc -l\n",
+    "cat notes.txt > copy.txt 2>&1\n",
+    "\n",
+    "sort < words.txt | uniq -c | sort -n >> counts.txt\n",
+    "sleep 1 &\n"
+};
+
+static void make_script(const char *path)
+{
+    FILE *out = fopen(path, "w");
+    size_t written = 0;
+    for (size_t i = 0; written < SCRIPT_BYTES; ++i) {
+        const char *line = LINES[i % (sizeof(LINES) / sizeof(LINES[0]))];
+        fputs(line, out);
+        written += strlen(line);
+    }
+    fclose(out);
+}
+
+static void parse_line(const char *line, size_t length, bool parsing)
+{
+    if (!parsing) {
+        return;
+    }
+    Scanner scanner = Scanner_value(CharItr_value(line, length));
+    Node_drop(parse(&scanner));
+}
+
+/* Returns MB/s, storing the system calls made to read. */
+static double replay(const char *path, bool ring, bool parsing, size_t *syscalls)
+{
+    uint64_t start = Profile_now();
+    *syscalls = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        int fd = open(path, O_RDONLY);
+        LineReader reader = LineReader_value(fd);
+        if (!ring) {
+            IoRing_drop(&reader.ring);
+        }
+        const char *line;
+        size_t length;
+        while ((line = LineReader_next(&reader, &length)) != NULL) {
+            parse_line(line, length, parsing);
+        }
+        *syscalls += LineReader_syscalls(&reader);
+        LineReader_drop(&reader);
+        close(fd);
+    }
+    uint64_t elapsed = Profile_now() - start;
+    *syscalls /= ROUNDS;
+    return (double) ROUNDS * SCRIPT_BYTES / 1e6 / (elapsed / 1e9);
+}
+
+static double replay_getline(const char *path, bool parsing)
+{
+    uint64_t start = Profile_now();
+    char *line = NULL;
+    size_t capacity = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        FILE *input = fopen(path, "r");
+        ssize_t length;
+        while ((length = getline(&line, &capacity, input)) >= 0) {
+            parse_line(line, length, parsing);
+        }
+        fclose(input);
+    }
+    free(line);
+    uint64_t elapsed = Profile_now() - start;
+    return (double) ROUNDS * SCRIPT_BYTES / 1e6 / (elapsed / 1e9);
+}
+
+int main()
+{
+    char path[] = "/tmp/thsh_replay_bench_XXXXXX";
+    close(mkstemp(path));
+    make_script(path);
+
+    int fd = open(path, O_RDONLY);
+    LineReader probe = LineReader_value(fd);
+    bool ring = IoRing_ready(&probe.ring);
+    LineReader_drop(&probe);
+    close(fd);
+
+    for (int parsing = 0; parsing <= 1; ++parsing) {
+        printf("%d MB script, %s\n", SCRIPT_BYTES >> 20, parsing ? "read and parsed" : "read");
+        size_t syscalls;
+        if (ring) {
+            double rate = replay(path, true, parsing, &syscalls);
+            printf("io_uring   %8.1f MB/s  %6zu syscalls\n", rate, syscalls);
+        } else {
+            printf("io_uring   unavailable\n");
+        }
+        double rate = replay(path, false, parsing, &syscalls);
+        printf("pread      %8.1f MB/s  %6zu syscalls\n", rate, syscalls);
+        printf("getline    %8.1f MB/s\n", replay_getline(path, parsing));
+    }
+    unlink(path);
+    return EXIT_SUCCESS;
+}
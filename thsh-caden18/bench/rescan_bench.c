@@ -0,0 +1,58 @@
+#include <stdio.h>
+
+#include "Profile.h"
+#include "Rescan.h"
+
+/*
+ * Single character edits on a 10 KB command line: incremental
+ * rescanning versus a full rescan after every keystroke.
+ */
+
+#define LINE_BYTES 10240
+#define EDITS 20000
+
+static Str make_line(void)
+{
+    Str line = Str_value(LINE_BYTES);
+    while (Str_length(&line) < LINE_BYTES) {
+        Str_append(&line, "grep -e pattern file.txt | ");
+    }
+    return line;
+}
+
+int main()
+{
+    Str line = make_line();
+    TokenSpans spans = TokenSpans_scan(Str_cstr(&line), Str_length(&line));
+
+    srand(1);
+    size_t relexed = 0;
+    uint64_t start = Profile_now();
+    for (int i = 0; i < EDITS; ++i) {
+        size_t offset = rand() % Str_length(&line);
+        Edit edit = { offset, 1, 1 };
+        Str_splice(&line, offset, 1, i % 2 ? " " : "x", 1);
+        relexed += TokenSpans_rescan(&spans, Str_cstr(&line), Str_length(&line), edit);
+    }
+    uint64_t incremental = Profile_now() - start;
+
+    start = Profile_now();
+    for (int i = 0; i < EDITS; ++i) {
+        size_t offset = rand() % Str_length(&line);
+        Str_splice(&line, offset, 1, i % 2 ? " " : "x", 1);
+        TokenSpans full = TokenSpans_scan(Str_cstr(&line), Str_length(&line));
+        Vec_drop(&spans);
+        spans = full;
+    }
+    uint64_t full = Profile_now() - start;
+
+    printf("line: %zu bytes, %zu tokens, %d edits\n",
+            Str_length(&line), Vec_length(&spans), EDITS);
+    printf("incremental: %8.3f us/edit (%.2f tokens relexed/edit)\n",
+            incremental / 1000.0 / EDITS, (double) relexed / EDITS);
+    printf("full:        %8.3f us/edit\n", full / 1000.0 / EDITS);
+
+    Vec_drop(&spans);
+    Str_drop(&line);
+    return EXIT_SUCCESS;
+}
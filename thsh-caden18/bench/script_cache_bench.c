@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LineReader.h"
+#include "Parser.h"
+#include "Profile.h"
+#include "Runner.h"
+#include "ScriptCache.h"
+
+/*
+ * Startup of a 50k-line script: reading its lines into trees by
+ * scanning and parsing them, against decoding them from a warm
+ * ScriptCache file, and then whole runs through the Runner with no
+ * cache, a cold cache, which parses and saves, and a warm one. Lines
+ * only run builtins, so that parsing is a visible part of a run.
+ */
+
+#define LINES 50000
+#define ROUNDS 5
+#define ARENA_CHUNK (64 << 10)
+
+static const char *LINE_KINDS[] = {
+    "echo $HOME a b c d e f && true || echo $(echo never run)",
+    "for i in a b c; do true; done",
+    "false || echo x y z; true",
+    "while false; do echo a b c; done",
+    "true",
+};
+
+static void write_script(const char *path)
+{
+    FILE *script = fopen(path, "w");
+    for (int i = 0; i < LINES; ++i) {
+        fprintf(script, "%s\n", LINE_KINDS[i % (sizeof(LINE_KINDS) / sizeof(LINE_KINDS[0]))]);
+    }
+    fclose(script);
+}
+
+static void clear(const char *dir)
+{
+    char command[256];
+    snprintf(command, sizeof(command), "rm -f %s/*.thc", dir);
+    if (system(command) != 0) {
+        perror("rm");
+    }
+}
+
+/* Milliseconds to parse every line of the script into a tree. */
+static double parse_all(const char *path)
+{
+    uint64_t start = Profile_now();
+    int fd = open(path, O_RDONLY);
+    LineReader input = LineReader_value(fd);
+    Arena arena = Arena_value(ARENA_CHUNK);
+    const char *line;
+    size_t length;
+    while ((line = LineReader_next(&input, &length)) != NULL) {
+        Scanner scanner = Scanner_value_with(CharItr_value(line, length), Arena_allocator(&arena));
+        Node_drop(parse(&scanner));
+        Arena_reset(&arena);
+    }
+    Arena_drop(&arena);
+    LineReader_drop(&input);
+    close(fd);
+    return (Profile_now() - start) / 1e6;
+}
+
+/* Milliseconds to key the script and decode every line from the cache. */
+static double decode_all(const char *path, const char *dir)
+{
+    uint64_t start = Profile_now();
+    int fd = open(path, O_RDONLY);
+    ScriptKey key;
+    CachedScript cached;
+    if (!ScriptKey_of(fd, &key) || !CachedScript_open(&cached, dir, path, &key)) {
+        fprintf(stderr, "cache miss\n");
+        exit(EXIT_FAILURE);
+    }
+    Arena arena = Arena_value(ARENA_CHUNK);
+    Node *tree;
+    while ((tree = CachedScript_next(&cached, Arena_allocator(&arena))) != NULL) {
+        Node_drop(tree);
+        Arena_reset(&arena);
+    }
+    Arena_drop(&arena);
+    CachedScript_drop(&cached);
+    close(fd);
+    return (Profile_now() - start) / 1e6;
+}
+
+/* Milliseconds to run the script, clearing the cache first if `cold`. */
+static double run(const char *path, const char *dir, bool cold, int out)
+{
+    if (cold) {
+        clear(dir);
+    }
+    int status;
+    uint64_t start = Profile_now();
+    Runner_run(&path, 1, 1, out, &status, dir);
+    return (Profile_now() - start) / 1e6;
+}
+
+int main()
+{
+    char path[] = "/tmp/thsh_script_cache_bench_XXXXXX";
+    close(mkstemp(path));
+    char dir[] = "/tmp/thsh_script_cache_bench_dir_XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    write_script(path);
+    int out = open("/dev/null", O_WRONLY);
+
+    double parsed = 0, decoded = 0, uncached = 0, cold = 0, warm = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        parsed += parse_all(path);
+        uncached += run(path, NULL, false, out);
+        cold += run(path, dir, true, out);
+        decoded += decode_all(path, dir);
+        warm += run(path, dir, false, out);
+    }
+    printf("%d lines, ms, mean of %d\n", LINES, ROUNDS);
+    printf("  load    parse %8.1f   cache decode %8.1f\n", parsed / ROUNDS, decoded / ROUNDS);
+    printf("  run     no cache %8.1f   cold %8.1f   warm %8.1f\n",
+            uncached / ROUNDS, cold / ROUNDS, warm / ROUNDS);
+
+    close(out);
+    clear(dir);
+    rmdir(dir);
+    unlink(path);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,57 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Parser.h"
+#include "Profile.h"
+
+/*
+ * Launch rate of a plain command against the same command with every
+ * kind of redirection. Files are opened by the shell and only dup2'd
+ * in the child, so the two should run at about the same rate.
+ */
+
+#define ROUNDS 2000
+
+static double launches(const char *line)
+{
+    Scanner scanner = Scanner_value(CharItr_value(line, strlen(line)));
+    Node *tree = parse(&scanner);
+    int out = open("/dev/null", O_WRONLY);
+    uint64_t start = Profile_now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        if (execute(tree, STDIN_FILENO, out) != 0) {
+            fprintf(stderr, "%s failed\n", line);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t elapsed = Profile_now() - start;
+    close(out);
+    Node_drop(tree);
+    return ROUNDS / (elapsed / 1e9);
+}
+
+int main()
+{
+    char path[] = "/tmp/thsh_spawn_bench_XXXXXX";
+    close(mkstemp(path));
+
+    const char *commands[][2] = {
+        { "true", "true" },
+        { "true < /dev/null > %s", "true < /dev/null > file" },
+        { "true >> %s 2> /dev/null", "true >> file 2> /dev/null" },
+        { "true < /dev/null > %s 2>&1", "true < /dev/null > file 2>&1" },
+    };
+    printf("%d rounds\n", ROUNDS);
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+        char line[256];
+        snprintf(line, sizeof(line), commands[i][0], path);
+        printf("%-32s %6.0f launches/s\n", commands[i][1], launches(line));
+    }
+    unlink(path);
+    return EXIT_SUCCESS;
+}
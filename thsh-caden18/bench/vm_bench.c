@@ -0,0 +1,59 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Parser.h"
+#include "Profile.h"
+#include "Program.h"
+
+/*
+ * Per-iteration cost of for loops of 1M iterations whose bodies run
+ * only builtins, compiled to a Program and run by its interpreter,
+ * against walking the same tree with execute.
+ */
+
+#define ITERATIONS 1000000
+
+static const char *BODIES[] = {
+    "true",
+    "true; true; true; true",
+    "false || true && true",
+    "for j in a b; do true; done",
+    "echo $i",
+};
+
+/* Nanoseconds per iteration of the loop run by `compiled` or not. */
+static double time_loop(const Node *tree, bool compiled, int out)
+{
+    uint64_t start = Profile_now();
+    if (compiled) {
+        Program program = Program_compile(tree);
+        Program_run(&program, STDIN_FILENO, out, NULL);
+        Program_drop(&program);
+    } else {
+        execute(tree, STDIN_FILENO, out);
+    }
+    uint64_t elapsed = Profile_now() - start;
+    return (double) elapsed / ITERATIONS;
+}
+
+int main()
+{
+    int out = open("/dev/null", O_WRONLY);
+    printf("%d iterations, ns per iteration\n", ITERATIONS);
+    for (size_t i = 0; i < sizeof(BODIES) / sizeof(BODIES[0]); ++i) {
+        char line[256];
+        snprintf(line, sizeof(line), "for i in $(seq %d); do %s; done", ITERATIONS, BODIES[i]);
+        Scanner scanner = Scanner_value(CharItr_value(line, strlen(line)));
+        Node *tree = parse(&scanner);
+        printf("%-32s tree walk %7.0f   program %7.0f\n", BODIES[i],
+                time_loop(tree, false, out), time_loop(tree, true, out));
+        Node_drop(tree);
+    }
+    close(out);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdlib.h>
+
+/**
+ * An Allocator is a vtable of memory operations plus an opaque
+ * context pointer handed back to each operation. Every Vec (and
+ * thus every Str, StrVec and Node built on top of one) remembers
+ * the Allocator it was constructed with and returns its memory to
+ * that same Allocator when dropped.
+ *
+ * Operations receive the size of the block they act upon so that
+ * allocators which do not keep per-block headers (arenas, pools)
+ * can still account for their memory.
+ */
+typedef struct Allocator {
+    /* Return `size` zeroed bytes or NULL when out of memory. */
+    void* (*alloc)(void *ctx, size_t size);
+    /* Grow or shrink `ptr` from `old_size` to `new_size` bytes. */
+    void* (*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    /* Release `ptr`, which was `size` bytes. */
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+} Allocator;
+
+/**
+ * The default Allocator backed by calloc/realloc/free. Used by
+ * every constructor that does not take an Allocator.
+ */
+extern const Allocator LIBC_ALLOCATOR;
+
+/* Convenience wrappers which dispatch through the vtable. */
+void* Allocator_alloc(const Allocator *self, size_t size);
+void* Allocator_realloc(
+        const Allocator *self,
+        void *ptr,
+        size_t old_size,
+        size_t new_size
+      );
+void Allocator_free(const Allocator *self, void *ptr, size_t size);
+
+/**
+ * An Arena hands out memory from large chunks and releases it all at
+ * once in Arena_drop. Individual frees are no-ops, and a realloc of
+ * the most recent allocation grows it in place when the chunk has
+ * room. Use Arena_allocator to construct Vecs whose lifetime is
+ * bounded by the Arena's, e.g. everything produced by one parse.
+ */
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk *head;   /* chunk currently being carved up */
+    size_t chunk_size;  /* minimum size of each new chunk */
+    void *last;         /* most recent allocation, for in place realloc */
+    size_t last_size;
+    size_t allocated;   /* bytes handed out since the last reset */
+    size_t limit;       /* allocations beyond this fail; 0 is no limit */
+    Allocator allocator;
+} Arena;
+
+/**
+ * Construct an empty Arena. No memory is reserved until the first
+ * allocation. Owner is responsible for calling Arena_drop.
+ */
+Arena Arena_value(size_t chunk_size);
+
+/**
+ * Bound the bytes the Arena hands out between resets. Once an
+ * allocation would exceed `limit` it fails, returning NULL, which
+ * the guards of Vec and Node report as out of memory. A `limit` of 0
+ * removes the bound.
+ */
+void Arena_set_limit(Arena *self, size_t limit);
+
+/**
+ * Returns an Allocator that carves memory out of `self`. The Arena
+ * must not move while the Allocator (or anything built with it) is
+ * in use.
+ */
+const Allocator* Arena_allocator(Arena *self);
+
+/**
+ * Expire the lifetime of all memory handed out by the Arena while
+ * keeping its most recent chunk for reuse, so an Arena reset between
+ * units of work (lines, scripts) stops allocating once warmed up.
+ */
+void Arena_reset(Arena *self);
+
+/**
+ * Free every chunk the Arena owns, expiring the lifetime of all
+ * memory handed out by it.
+ */
+void Arena_drop(Arena *self);
+
+#endif
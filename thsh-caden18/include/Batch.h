@@ -0,0 +1,36 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+/*
+ * Batch mode runs a script as a three stage pipeline so that reading
+ * and parsing of upcoming lines overlaps execution of the current one:
+ *
+ *   reader thread  --lines-->  parser threads  --trees-->  executor
+ *
+ * The stages share a bounded ring of `depth` slots. Each slot moves
+ * through EMPTY -> READ -> PARSED -> EMPTY, with every transition made
+ * by a single atomic store, so no stage ever takes a lock. Lines may
+ * be parsed out of order by the parser pool but the executor, which
+ * is the calling thread, always runs them in their original order.
+ * Each line is parsed alone; the executor parses again, in order, the
+ * lines that continue a list or loop begun on the lines before them.
+ *
+ * Commands run with /dev/null as stdin, since the script occupies
+ * the shell's stdin, and write to `out_fd`.
+ */
+
+typedef struct BatchOptions {
+    size_t parsers; /* parser threads, at least 1 */
+    size_t depth;   /* lines in flight, at least 1 */
+} BatchOptions;
+
+/*
+ * Reads `script` to its end and executes each line. Returns the exit
+ * status of the last line executed. A syntax error stops execution
+ * and returns EXIT_SYNTAX_ERROR.
+ */
+int Batch_run(FILE *script, int out_fd, BatchOptions options);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef BUILTIN_H
+#define BUILTIN_H
+
+/*
+ * Builtins are commands the shell runs itself instead of spawning a
+ * process. They read `in`, write `out` and report errors on `err`,
+ * none of which they may close. Returns an exit status.
+ */
+typedef int (*Builtin)(char *const argv[], int in, int out, int err);
+
+/*
+ * The builtin that runs `argv`, or NULL if argv[0] is not a builtin.
+ * Builtins stand in for external commands of the same name, so a
+ * builtin also returns NULL for any arguments it does not support,
+ * leaving them to the external command.
+ */
+Builtin Builtin_find(char *const argv[]);
+
+#endif
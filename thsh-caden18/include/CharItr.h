@@ -15,6 +15,22 @@ typedef struct CharItr {
     const char *sentinel;
 } CharItr;
 
+/*
+ * A CharSpan is a borrowed run of `length` chars starting at `start`.
+ */
+typedef struct CharSpan {
+    const char *start;
+    size_t length;
+} CharSpan;
+
+/*
+ * Character classes for the bulk operations below. A class mask is
+ * any combination of these bits.
+ */
+#define CHAR_SPACE    0x1 /* ' ', '\t', '\n' and '\0' */
+#define CHAR_OPERATOR 0x2 /* '|', '<', '>', '&' and ';' */
+#define CHAR_DOLLAR   0x4 /* '$' and '`', which may begin a substitution */
+
 /*
  * Constructor. Resulting CharItr value does not own any
  * heap memory thus there is no drop function. Resulting
@@ -55,4 +71,35 @@ char CharItr_peek(const CharItr *self);
  */
 char CharItr_next(CharItr *self);
 
+/*
+ * The classes `c` belongs to, as a mask of CHAR_* bits.
+ */
+unsigned CharItr_class(char c);
+
+/*
+ * Advance the cursor past every char in one of the classes of
+ * `class_mask`. Returns the number of chars skipped.
+ */
+size_t CharItr_skip_while(CharItr *self, unsigned class_mask);
+
+/*
+ * Advance the cursor up to, but not past, the first char in one of
+ * the classes of `class_mask`, or to the end. Returns the chars
+ * passed over.
+ */
+CharSpan CharItr_take_until(CharItr *self, unsigned class_mask);
+
+/*
+ * Advance the cursor to the next occurrence of `byte`. Returns true if
+ * one was found; otherwise the cursor is left at the end and returns
+ * false.
+ */
+bool CharItr_find(CharItr *self, char byte);
+
+/*
+ * Advance the cursor by `n` chars. Will exit with out of bounds error
+ * if fewer than `n` characters remain.
+ */
+void CharItr_advance(CharItr *self, size_t n);
+
 #endif
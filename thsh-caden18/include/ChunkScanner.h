@@ -0,0 +1,54 @@
+#ifndef CHUNK_SCANNER_H
+#define CHUNK_SCANNER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "CharItr.h"
+#include "Scanner.h"
+#include "Str.h"
+
+/*
+ * A ChunkScanner produces the same tokens as a Scanner, but from a
+ * stream read a fixed-size chunk at a time rather than from one
+ * contiguous buffer, so its memory is bounded by the chunk size and
+ * the longest token, never by the length of the script.
+ *
+ * Most tokens lie within a single chunk and are returned in place.
+ * The rare token that straddles chunks, such as a word whose command
+ * substitution spans several, is stitched together in a side buffer.
+ */
+
+typedef struct ChunkToken {
+    TokenType type;
+    uint8_t flags;      /* TOKEN_* flags */
+    uint64_t offset;    /* of the lexeme's first byte within the stream */
+    CharSpan lexeme;    /* valid until the next call to ChunkScanner_next */
+} ChunkToken;
+
+typedef struct ChunkScanner {
+    FILE *input;
+    char *chunk;        /* the current chunk */
+    size_t chunk_size;  /* capacity of `chunk` */
+    CharItr char_itr;   /* position within the current chunk */
+    uint64_t consumed;  /* stream offset of the current chunk's start */
+    uint8_t flags;      /* TOKEN_* flags for the next token so far */
+    Str stitch;         /* a token straddling chunks */
+} ChunkScanner;
+
+/*
+ * A ChunkScanner reading `input` in chunks of `chunk_size` bytes.
+ * The caller keeps ownership of `input`. Owner is responsible for
+ * calling ChunkScanner_drop.
+ */
+ChunkScanner ChunkScanner_value(FILE *input, size_t chunk_size);
+
+void ChunkScanner_drop(ChunkScanner *self);
+
+/*
+ * Take the next token. At the end of the stream returns an END_TOKEN
+ * with an empty lexeme, as do all calls after it.
+ */
+ChunkToken ChunkScanner_next(ChunkScanner *self);
+
+#endif
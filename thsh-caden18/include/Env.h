@@ -0,0 +1,102 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Str.h"
+#include "Vec.h"
+
+/*
+ * An Env is a store of shell variables, each of which may be exported
+ * to the commands the shell spawns.
+ *
+ * The envp handed to each spawn is not built per command. The Env
+ * keeps one EnvBlock: the exported variables as "name=value" strings
+ * in a single contiguous Str, with a NULL terminated array of
+ * pointers into it. The block is stamped with the Env's generation,
+ * a counter bumped only when an exported variable changes. It is
+ * rebuilt on the first request after such a change, and otherwise
+ * shared, so launching a command costs no allocation however many
+ * variables are exported.
+ *
+ * Blocks are reference counted. A holder keeps a block valid while
+ * the Env moves on to newer ones. An Env is safe to use from several
+ * threads at once.
+ */
+
+typedef struct EnvBlock {
+    uint32_t refs;       /* holders, the Env among them while current */
+    uint64_t generation; /* of the Env it was built from */
+    Str text;            /* each exported "name=value", null terminated */
+    Vec envp;            /* char*, into text, NULL terminated */
+} EnvBlock;
+
+typedef struct Env {
+    Vec vars;            /* EnvVar, in the order first set */
+    Vec slots;           /* size_t index + 1 into vars, 0 if free; a power of two */
+    uint64_t generation; /* bumped when an exported variable changes */
+    EnvBlock *block;     /* envp of some generation, NULL until asked for */
+    pthread_mutex_t lock;
+} Env;
+
+/* An empty Env. Owner is responsible for calling Env_drop. */
+Env Env_value(void);
+
+/*
+ * An Env holding each "name=value" of the NULL terminated `envp`,
+ * exported, as from `environ`. Owner is responsible for calling
+ * Env_drop.
+ */
+Env Env_from(char *const envp[]);
+
+/* Frees the Env, and its block once no holder is left. */
+void Env_drop(Env *self);
+
+/*
+ * Sets the variable `name` to `value`, creating it unexported if it
+ * is not set, else keeping whether it is exported.
+ */
+void Env_set(Env *self, const char *name, const char *value);
+
+/*
+ * Exports the variable `name`, first setting it to `value` unless
+ * `value` is NULL. Exporting a variable that is not set, with no
+ * value, sets it to "".
+ */
+void Env_export(Env *self, const char *name, const char *value);
+
+/* Removes the variable `name`, if it is set. */
+void Env_unset(Env *self, const char *name);
+
+/*
+ * Appends the value of the variable named by the `length` chars at
+ * `name` to `out`. Returns false, appending nothing, if it is not set.
+ */
+bool Env_get(Env *self, const char *name, size_t length, Str *out);
+
+/* Bumped whenever an exported variable is set, exported or unset. */
+uint64_t Env_generation(Env *self);
+
+/*
+ * The exported variables as an envp, built only if an exported
+ * variable changed since it was last asked for. The caller holds one
+ * reference, released with EnvBlock_drop.
+ */
+EnvBlock* Env_block(Env *self);
+
+/* The NULL terminated envp of a block. */
+char* const* EnvBlock_envp(const EnvBlock *self);
+
+/* Releases one holder's reference, freeing the block after the last. */
+void EnvBlock_drop(EnvBlock *self);
+
+/*
+ * The shell's own variables, which `$name` expands to, which the
+ * export and unset builtins change, and which are exported to every
+ * command spawned. Built from `environ` on first use.
+ */
+Env* Env_shell(void);
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include "JobTable.h"
+#include "Node.h"
+#include "Str.h"
+#include "Vec.h"
+
+/* Exit status reported when a command cannot be found. */
+#define EXIT_NOT_FOUND 127
+
+/* Exit status reported for a tree that failed to parse. */
+#define EXIT_SYNTAX_ERROR 2
+
+/*
+ * A variable bound by an enclosing for loop. Bindings live on the
+ * stack of the loop that makes them, innermost first.
+ */
+typedef struct Binding {
+    const char *name;
+    const char *value;
+    const struct Binding *outer;
+} Binding;
+
+/*
+ * A command's argv after expansion: its fields, each null terminated,
+ * in `text`, and a NULL terminated array of pointers to them in `argv`.
+ */
+typedef struct Expansion {
+    Str text;
+    Vec argv; /* char* */
+} Expansion;
+
+/**
+ * Executes the tree rooted at `node` and waits for every process it
+ * starts. Each command's substitutions run first, in the order
+ * written, and their output replaces them in its words, as the values
+ * of variables replace them: a for loop's variable, or else the
+ * shell's, from Env_shell, whose exported variables are the
+ * environment of every command spawned and whose PATH is searched for
+ * it. The first command of a pipeline reads from `in_fd` and the last
+ * writes to `out_fd`; standard error is inherited. The pipelines of a
+ * list run one after another, skipping those that '&&' or '||' rule
+ * out, and a loop runs the same body tree on every iteration. The tree
+ * is only read, so shared trees may be executed.
+ *
+ * Returns the exit status of the last command of the last pipeline
+ * run, or 128 plus the signal number if it was killed by a signal.
+ *
+ * Without a JobTable there is nowhere to track a background job, so
+ * a pipeline ending in '&' runs in the foreground.
+ */
+int execute(const Node *node, int in_fd, int out_fd);
+
+/**
+ * Like execute, but a pipeline ending in '&' is started in its own
+ * process group and added to `jobs` without waiting for it, with
+ * status 0. The job builtins of `jobs` are available as commands,
+ * including as stages of a pipeline, though not of one in the
+ * background.
+ */
+int execute_with(const Node *node, int in_fd, int out_fd, JobTable *jobs);
+
+/**
+ * Executes the tree rooted at `node` as a command substitution,
+ * reading from `in_fd`, and appends its standard output to `out` less
+ * any trailing newlines. Output is read through an enlarged pipe in
+ * large chunks into `out`'s spare capacity, which grows geometrically.
+ * Returns the exit status, as execute does.
+ */
+int execute_capture(const Node *node, int in_fd, Str *out);
+
+/**
+ * Runs one pipeline, or a BACKGROUND_NODE holding one, as execute_with
+ * does, with the variables of `bindings` in scope. Returns its status.
+ */
+int execute_pipeline(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings);
+
+/**
+ * Expands `command`'s words into `expansion`, replacing each command
+ * substitution with its output, read from `in_fd`, and each variable
+ * with its innermost binding in `bindings`, else its value in
+ * Env_shell, else nothing. Returns the status of the last command
+ * substitution, or 0. The caller drops `expansion`.
+ */
+int execute_expand(const CommandValue *command, int in_fd, const Binding *bindings,
+        Expansion *expansion);
+
+/* Free the text and argv of an expansion. */
+void Expansion_drop(Expansion *self);
+
+/** The exit status waitpid's `wstatus` stands for. */
+int exit_status(int wstatus);
+
+#endif
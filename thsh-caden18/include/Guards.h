@@ -1,6 +1,66 @@
 #ifndef GUARDS_H
 #define GUARDS_H
 
-void OOM_GUARD(void *ptr, char *file, int number);
+#include <setjmp.h>
+#include <stddef.h>
+
+/*
+ * Guards report unrecoverable errors: running out of memory or
+ * indexing out of bounds. By default they print the error with its
+ * file and line and exit the process. A thread which must never
+ * exit, such as one serving library calls, can install a Recovery
+ * first; errors on that thread then longjmp back to it instead.
+ */
+
+/* Messages guards fail with; compare Recovery.message against them. */
+extern const char OUT_OF_MEMORY[];
+extern const char OUT_OF_BOUNDS[];
+
+typedef struct Recovery Recovery;
+
+struct Recovery {
+    jmp_buf env;
+    const char *message; /* the error that was recovered from */
+    const char *file;
+    int line;
+    Recovery *previous;  /* enclosing Recovery on this thread */
+};
+
+/*
+ * Install `self` as the calling thread's Recovery. Immediately call
+ * setjmp(self->env): a guard failure on this thread will return there
+ * a second time with a non-zero value. Every Recovery_begin must be
+ * paired with Recovery_end on all paths, including the error path.
+ *
+ * Usage:
+ *
+ *   Recovery recovery;
+ *   Recovery_begin(&recovery);
+ *   if (setjmp(recovery.env) != 0) {
+ *       Recovery_end(&recovery);
+ *       ... handle recovery.message ...
+ *   }
+ *   ... work that may fail a guard ...
+ *   Recovery_end(&recovery);
+ */
+void Recovery_begin(Recovery *self);
+
+/* Restore the thread's previous Recovery, if any. */
+void Recovery_end(Recovery *self);
+
+/*
+ * Fail with `message` at file:number. Never returns: jumps to the
+ * thread's Recovery, or prints the error and exits.
+ */
+__attribute__((noreturn)) void PANIC(const char *message, const char *file, int number);
+
+void OOM_GUARD(void *ptr, const char *file, int number);
+
+/*
+ * OOM_GUARD for an allocation of `size` bytes. When MemStats tracking
+ * is enabled the block is also attributed to file:number. `prev` is
+ * the block being resized, or NULL for a fresh allocation.
+ */
+void ALLOC_GUARD(void *ptr, void *prev, size_t size, const char *file, int number);
 
 #endif
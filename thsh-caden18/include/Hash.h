@@ -0,0 +1,10 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 64-bit FNV-1a hash of `length` bytes. */
+uint64_t Hash_bytes(const char *bytes, size_t length);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A Histogram counts unsigned 64-bit samples in log-linear buckets
+ * in the style of HdrHistogram: each power of two range is split
+ * into 16 equal sub-buckets, bounding the relative error of any
+ * reported value to about 6%. Recording is a handful of arithmetic
+ * operations and relaxed atomic increments, so it is safe to
+ * record from several threads at once.
+ */
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 2) * (1 << (HISTOGRAM_SUB_BITS - 1)))
+
+typedef struct Histogram {
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+/* Zero every bucket. Histograms with static storage start zeroed. */
+void Histogram_reset(Histogram *self);
+
+void Histogram_record(Histogram *self, uint64_t value);
+
+uint64_t Histogram_count(const Histogram *self);
+
+uint64_t Histogram_max(const Histogram *self);
+
+/*
+ * Returns the smallest value v such that at least `percentile`
+ * percent of samples are <= v, reported as the upper bound of v's
+ * bucket and never more than the largest sample. Returns 0 for an
+ * empty Histogram.
+ */
+uint64_t Histogram_percentile(const Histogram *self, double percentile);
+
+#endif
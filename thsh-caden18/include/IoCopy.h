@@ -0,0 +1,32 @@
+#ifndef IO_COPY_H
+#define IO_COPY_H
+
+#include <sys/types.h>
+
+/*
+ * Copies between file descriptors for builtins, keeping the bytes in
+ * the kernel whenever the descriptors allow it:
+ *
+ *   pipe on either side        splice(2)
+ *   file to file               copy_file_range(2)
+ *   file to anything else      sendfile(2)
+ *   otherwise, or on refusal   read(2)/write(2) through a large buffer
+ *
+ * Each call falls back to the next strategy if the kernel refuses the
+ * faster one before any bytes have moved.
+ */
+
+/*
+ * Copy from `in` to `out` until end of input. Returns the number of
+ * bytes copied, or -1 with errno set.
+ */
+ssize_t IoCopy_copy(int in, int out);
+
+/*
+ * Copy from `in` to both `out` and `copy` until end of input, using
+ * tee(2) when `in` and `out` are both pipes. Returns the number of
+ * bytes read from `in`, or -1 with errno set.
+ */
+ssize_t IoCopy_tee(int in, int out, int copy);
+
+#endif
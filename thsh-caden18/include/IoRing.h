@@ -0,0 +1,74 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * A minimal io_uring instance, driven through the raw system calls.
+ *
+ * Requests are queued in the shared submission ring without a system
+ * call and handed to the kernel in batches by IoRing_enter, which can
+ * also wait for completions in the same call. Completions are then
+ * taken from the shared completion ring, again without a system call.
+ *
+ * Where io_uring is unavailable, because the kernel predates it or a
+ * sandbox forbids it, IoRing_value returns a ring for which
+ * IoRing_ready is false and callers use the blocking system calls.
+ *
+ * An IoRing is not thread-safe.
+ */
+
+typedef struct IoRing {
+    int fd;                  /* -1 when io_uring is unavailable */
+    unsigned entries;        /* submission ring size */
+    unsigned queued;         /* requests queued but not yet submitted */
+    unsigned *sq_head;       /* shared ring indices and arrays */
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;            /* mappings, for IoRing_drop */
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+    size_t enters;           /* io_uring_enter calls made */
+} IoRing;
+
+/*
+ * Set up a ring of at least `entries` submission slots. Owner is
+ * responsible for calling IoRing_drop.
+ */
+IoRing IoRing_value(unsigned entries);
+
+/* Tears the ring down. Requests still in flight must have completed. */
+void IoRing_drop(IoRing *self);
+
+/* Whether io_uring is available through this ring. */
+bool IoRing_ready(const IoRing *self);
+
+/*
+ * Queue a read of up to `length` bytes of `fd` at `offset` into
+ * `buffer`, tagged `tag`. Returns false if the submission ring is full.
+ */
+bool IoRing_read(IoRing *self, int fd, void *buffer, unsigned length, uint64_t offset, uint64_t tag);
+
+/*
+ * Submit every queued request and wait until at least `wait` requests
+ * have completed, in one system call. Returns 0, or -1 with errno set.
+ */
+int IoRing_enter(IoRing *self, unsigned wait);
+
+/*
+ * Take one completion, if there is any, storing its tag and its result:
+ * a byte count, or a negated errno value.
+ */
+bool IoRing_complete(IoRing *self, uint64_t *tag, int32_t *result);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef JOB_TABLE_H
+#define JOB_TABLE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "Vec.h"
+
+/*
+ * A JobTable tracks the pipelines run in the background with '&'.
+ *
+ * Each process of a job is watched through a pidfd registered with an
+ * epoll instance, whose event points straight at the process. When
+ * children exit, JobTable_poll reaps exactly those, so the cost of an
+ * event does not depend on how many jobs are running, and nothing
+ * calls waitpid in a loop over the table. The epoll descriptor itself
+ * becomes readable when a job's process exits, so a REPL can wait on
+ * it alongside its input. On kernels without pidfds, processes are
+ * instead checked with WNOHANG on every poll.
+ *
+ * Every job runs in its own process group, so that `fg` can hand it
+ * the terminal and `bg` can continue it with one signal.
+ *
+ * A JobTable is not thread-safe; it belongs to the shell's main loop.
+ */
+
+typedef enum JobState {
+    JOB_RUNNING,
+    JOB_STOPPED,
+    JOB_DONE
+} JobState;
+
+typedef struct Job Job;
+
+typedef struct JobTable {
+    int epoll_fd;     /* readable when a watched process has exited */
+    int terminal;     /* given to jobs brought to the foreground, or -1 */
+    Vec jobs;         /* Job* at index id - 1, NULL where an id is free */
+    Vec finished;     /* Job* done since the last notify, NULL once removed */
+    size_t count;     /* jobs in the table */
+    size_t unwatched; /* processes without a pidfd */
+} JobTable;
+
+/*
+ * Construct an empty JobTable. `terminal` is the controlling
+ * terminal of an interactive shell, or -1 when there is none. Owner is
+ * responsible for calling JobTable_drop.
+ */
+JobTable JobTable_value(int terminal);
+
+/* Forgets every job, leaving their processes running. */
+void JobTable_drop(JobTable *self);
+
+/* A descriptor that polls readable while JobTable_poll has work. */
+int JobTable_fd(const JobTable *self);
+
+/* Number of jobs in the table, finished or not. */
+size_t JobTable_count(const JobTable *self);
+
+/*
+ * Track the `count` processes of a pipeline just started in the
+ * background, the first of which leads their process group. `command`
+ * is copied to describe the job. Returns the new job's id, announcing
+ * it on standard error when the shell is interactive.
+ */
+size_t JobTable_add(JobTable *self, const pid_t pids[], size_t count, const char *command);
+
+/*
+ * Reap the job processes that have exited, waiting up to `timeout_ms`
+ * milliseconds, or forever if negative, for the first. Jobs whose
+ * processes have all exited are marked done. Returns the number of
+ * processes reaped.
+ */
+size_t JobTable_poll(JobTable *self, int timeout_ms);
+
+/*
+ * Report each job that has finished since the last call to `out`, in
+ * job order, and remove it from the table. With a NULL `out` they are
+ * removed unreported, as a script's are. Only finished jobs are
+ * visited, however many are still running.
+ */
+void JobTable_notify(JobTable *self, FILE *out);
+
+/*
+ * Builtins that act on the job table: `jobs`, `wait`, `fg` and `bg`.
+ * They write to `out` and report errors on `err`. Returns an exit
+ * status.
+ */
+typedef int (*JobBuiltin)(JobTable *jobs, char *const argv[], int out, int err);
+
+/* The job builtin that runs `argv`, or NULL if there is none. */
+JobBuiltin JobTable_find_builtin(char *const argv[]);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "IoRing.h"
+#include "Str.h"
+
+/*
+ * A LineReader splits the input of a file descriptor into lines,
+ * reading it a large block at a time and returning lines in place.
+ *
+ * A regular file is read ahead through an IoRing: every block not
+ * being consumed has a read in flight at the next offset, and reads
+ * are handed to the kernel in batches when the reader has to wait, so
+ * a script costs far fewer system calls than its blocks. Pipes and
+ * terminals are only read when no line is buffered, since bytes read
+ * from them cannot be handed back to the commands run. Without
+ * io_uring, blocks are read with plain pread(2) or read(2).
+ */
+
+#define LINE_READER_BLOCKS 4
+#define LINE_READER_BLOCK_SIZE (64 << 10)
+
+typedef enum BlockState {
+    BLOCK_EMPTY,
+    BLOCK_IN_FLIGHT,
+    BLOCK_FILLED
+} BlockState;
+
+typedef struct ReadBlock {
+    char *data;
+    BlockState state;
+    size_t length;   /* bytes read, 0 at end of input */
+    uint64_t offset; /* of data[0] within a regular file */
+} ReadBlock;
+
+typedef struct LineReader {
+    int fd;
+    bool seekable;       /* a regular file, read at explicit offsets */
+    IoRing ring;
+    ReadBlock blocks[LINE_READER_BLOCKS]; /* consumed in turn from `head` */
+    size_t head;
+    size_t position;     /* within the head block */
+    uint64_t next_offset; /* of the next block to read */
+    uint64_t end;        /* offset of the end of a regular file, once seen */
+    uint64_t consumed;   /* offset just past the last line returned */
+    bool synced;         /* the file offset was handed to a command */
+    Str carry;           /* a line straddling blocks */
+    size_t syscalls;     /* read(2), pread(2) and lseek(2) calls */
+} LineReader;
+
+/*
+ * A LineReader of `fd`, which the caller keeps ownership of. Owner is
+ * responsible for calling LineReader_drop.
+ */
+LineReader LineReader_value(int fd);
+
+/* Waits for reads in flight, then frees the reader's buffers. */
+void LineReader_drop(LineReader *self);
+
+/*
+ * The next line, including its '\n' unless it ends the input, and
+ * its length. Valid until the next call. Returns NULL at the end of
+ * the input or on a read error.
+ */
+const char* LineReader_next(LineReader *self, size_t *length);
+
+/* Whether a whole line is buffered, so that reading it cannot block. */
+bool LineReader_buffered(const LineReader *self);
+
+/*
+ * Move the descriptor's file offset to just past the last line
+ * returned, where a command run next should find the rest of a
+ * script. Lines are read on from wherever the command leaves the
+ * offset. Does nothing for pipes and terminals.
+ */
+void LineReader_sync(LineReader *self);
+
+/* System calls made to read and seek so far, io_uring_enter(2) included. */
+size_t LineReader_syscalls(const LineReader *self);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/*
+ * MemStats is an optional allocation tracker. When enabled, every
+ * allocation that passes through ALLOC_GUARD is attributed to the
+ * __FILE__:__LINE__ callsite that made it, and every block released
+ * through Allocator_free is credited back to that same callsite.
+ *
+ * Tracking is off by default, in which case each hook costs a single
+ * atomic load and branch. It must be enabled before the first tracked
+ * allocation; blocks allocated earlier, or while it was disabled, are
+ * ignored when freed. The switch may be read from any thread.
+ */
+
+typedef struct MemSite {
+    const char *file;
+    int line;
+    size_t allocs;    /* number of fresh allocations */
+    size_t reallocs;  /* number of resizes */
+    size_t live;      /* bytes currently outstanding */
+    size_t peak;      /* high-water mark of live */
+} MemSite;
+
+/* Turn tracking on until MemStats_disable. */
+void MemStats_enable(void);
+
+/* Turn tracking off. Callsites recorded so far are kept. */
+void MemStats_disable(void);
+
+bool MemStats_enabled(void);
+
+/*
+ * Record that `ptr` now holds `size` bytes on behalf of file:line.
+ * `prev` is the block `ptr` replaced when resizing, NULL otherwise.
+ */
+void MemStats_alloc(const void *ptr, const void *prev, size_t size, const char *file, int line);
+
+/* Record that `ptr` was released. Unknown pointers are ignored. */
+void MemStats_free(const void *ptr);
+
+/* Totals across every callsite. */
+size_t MemStats_live(void);
+size_t MemStats_peak(void);
+
+/*
+ * Copy up to `capacity` callsites into `out`, ordered by peak bytes
+ * descending. Returns the number of callsites copied.
+ */
+size_t MemStats_sites(MemSite *out, size_t capacity);
+
+/* Print a human readable table of callsites. */
+void MemStats_report(FILE *out);
+
+/*
+ * Print one tab separated line per callsite, preceded by a header:
+ * file, line, allocs, reallocs, live, peak.
+ */
+void MemStats_dump(FILE *out);
+
+/* Forget every callsite and live block. Tracking stays enabled. */
+void MemStats_reset(void);
+
+#endif
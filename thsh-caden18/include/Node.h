@@ -1,34 +1,127 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include "Str.h"
-#include "StrVec.h"
+#include <stdint.h>
+
+#include "Allocator.h"
+#include "CharItr.h"
 
 typedef enum NodeType {
     ERROR_NODE = -1,
     COMMAND_NODE = 0,
-    PIPE_NODE = 1
+    PIPE_NODE = 1,
+    BACKGROUND_NODE = 2,
+    SEQUENCE_NODE = 3, /* left ; right */
+    AND_NODE = 4,      /* left && right */
+    OR_NODE = 5,       /* left || right */
+    FOR_NODE = 6,      /* for name in words; do body; done */
+    WHILE_NODE = 7     /* while condition; do body; done */
 } NodeType;
 
 typedef struct Node Node;
 
 typedef const char* ErrorValue;
 
-typedef StrVec CommandValue;
+typedef enum RedirectType {
+    REDIRECT_IN = 0,        /* < file */
+    REDIRECT_OUT = 1,       /* > file */
+    REDIRECT_APPEND = 2,    /* >> file */
+    REDIRECT_ERR = 3,       /* 2> file */
+    REDIRECT_ERR_TO_OUT = 4 /* 2>&1 */
+} RedirectType;
+
+typedef struct Redirect {
+    RedirectType type;
+    const char *target; /* null terminated file name, NULL for 2>&1 */
+} Redirect;
+
+/* A Redirect to construct a command with; `target` is copied. */
+typedef struct RedirectSpan {
+    RedirectType type;
+    CharSpan target;
+} RedirectSpan;
+
+/*
+ * A command substitution within a word, `$(...)` or `...` in
+ * backquotes, replaced by the output of its parsed `tree` when the
+ * command runs. A Substitution without a tree is a variable, `$name`
+ * or `${name}`, replaced by the variable's value.
+ */
+typedef struct Substitution {
+    uint32_t word;   /* index of the word it lies in */
+    uint32_t start;  /* of its first delimiter within the word */
+    uint32_t length; /* including its delimiters */
+    Node *tree;      /* NULL for a variable */
+} Substitution;
+
+#define COMMAND_INLINE_WORDS 3
+
+/*
+ * A command's words, redirections and substitutions. Their bytes share
+ * one heap block, each word and file name null terminated, after the
+ * arrays of Redirects and Substitutions. Pointers to the words form a
+ * NULL terminated argv, which is kept inline for commands of up to
+ * COMMAND_INLINE_WORDS words and otherwise at the front of the heap
+ * block. Words keep the text of their substitutions.
+ */
+typedef struct CommandValue {
+    uint32_t length;             /* words, at least one */
+    uint32_t redirect_count;     /* Redirects, applied in order */
+    uint32_t substitution_count; /* Substitutions, in the order written */
+    uint32_t block_size;         /* bytes in the heap block */
+    union {
+        char *inline_argv[COMMAND_INLINE_WORDS + 1];
+        char **heap_argv;
+    } argv;
+} CommandValue;
 
 typedef struct PipeValue {
     Node *left;
     Node *right;
 } PipeValue;
 
+/* A pipeline run as a background job, as in `pipeline &`. */
+typedef struct BackgroundValue {
+    Node *pipeline;
+} BackgroundValue;
+
+/*
+ * A list of pipelines joined by ';', '&&' or '||', the type of its
+ * Node. Lists lean right: `left` is always a pipeline, perhaps run in
+ * the background, and `right` the rest of the list, so `a && b || c`
+ * is AND(a, OR(b, c)). Each operator applies to the status of the
+ * pipelines run before it, which is left to right, as in sh.
+ */
+typedef struct ListValue {
+    Node *left;
+    Node *right;
+} ListValue;
+
+/*
+ * A loop, whose body is parsed once and run as the same tree on every
+ * iteration. A FOR_NODE's head is a COMMAND_NODE of the variable's
+ * name followed by the words it is bound to in turn; a WHILE_NODE's
+ * head is the list run as its condition.
+ */
+typedef struct LoopValue {
+    Node *head;
+    Node *body;
+} LoopValue;
+
 typedef union NodeValue {
     ErrorValue error;
     CommandValue command;
     PipeValue pipe;
+    BackgroundValue background;
+    ListValue list;
+    LoopValue loop;
 } NodeValue;
 
+/* Laid out to fit a 64-byte cache line. */
 struct Node {
     NodeType type;
+    uint32_t refs;              /* owners sharing this Node */
+    const Allocator *allocator; /* source of this Node's memory */
     NodeValue data;
 };
 
@@ -36,10 +129,98 @@ struct Node {
 
 Node* ErrorNode_new(const char *msg);
 
-Node* CommandNode_new(StrVec words);
+/**
+ * A command of `count` words, at least one, `redirect_count`
+ * redirections and `substitution_count` command substitutions within
+ * its words. The bytes of words and redirections are copied; the
+ * command takes ownership of the substitutions' trees.
+ */
+Node* CommandNode_new(
+        const CharSpan words[],
+        size_t count,
+        const RedirectSpan redirects[],
+        size_t redirect_count,
+        const Substitution substitutions[],
+        size_t substitution_count
+    );
 
 Node* PipeNode_new(Node *left, Node *right);
 
+Node* BackgroundNode_new(Node *pipeline);
+
+/** A list Node of `type` SEQUENCE_NODE, AND_NODE or OR_NODE. */
+Node* ListNode_new(NodeType type, Node *left, Node *right);
+
+/** A loop Node of `type` FOR_NODE or WHILE_NODE. */
+Node* LoopNode_new(NodeType type, Node *head, Node *body);
+
+/**
+ * Variants of the constructors above whose Node, and a command's
+ * words, are allocated by `allocator` rather than libc. Children keep
+ * whatever allocator they were built with.
+ */
+Node* ErrorNode_new_with(const char *msg, const Allocator *allocator);
+
+Node* CommandNode_new_with(
+        const CharSpan words[],
+        size_t count,
+        const RedirectSpan redirects[],
+        size_t redirect_count,
+        const Substitution substitutions[],
+        size_t substitution_count,
+        const Allocator *allocator
+    );
+
+Node* PipeNode_new_with(Node *left, Node *right, const Allocator *allocator);
+
+Node* BackgroundNode_new_with(Node *pipeline, const Allocator *allocator);
+
+Node* ListNode_new_with(NodeType type, Node *left, Node *right, const Allocator *allocator);
+
+Node* LoopNode_new_with(NodeType type, Node *head, Node *body, const Allocator *allocator);
+
+/** Number of words in a command. */
+size_t Command_length(const CommandValue *self);
+
+/** The null terminated word at `index`. Panics when out of bounds. */
+const char* Command_word(const CommandValue *self, size_t index);
+
+/** A NULL terminated argv of the command's words, for exec. */
+char* const* Command_argv(const CommandValue *self);
+
+/** Number of redirections of a command. */
+size_t Command_redirect_count(const CommandValue *self);
+
+/** The command's redirections, in the order they were written. */
+const Redirect* Command_redirects(const CommandValue *self);
+
+/** Number of command substitutions within a command's words. */
+size_t Command_substitution_count(const CommandValue *self);
+
+/** The command's substitutions, in the order they were written. */
+const Substitution* Command_substitutions(const CommandValue *self);
+
+/**
+ * Releases one owner's reference to a Node. When the last reference
+ * is dropped, the Node and everything it owns are freed: a command's
+ * words and substitutions, a pipe's or list's left and right
+ * subtrees, a background pipeline or a loop's head and body. Always returns NULL so callers may write
+ * `node = Node_drop(node);`.
+ */
 void* Node_drop(Node *self);
 
+/**
+ * Adds an owner to a Node and returns it. A Node with more than one
+ * owner is shared and must be treated as read-only by all of them.
+ * Reference counting is atomic, so shared trees may be read and
+ * dropped from several threads.
+ */
+Node* Node_retain(Node *self);
+
+/**
+ * Approximate number of heap bytes owned by the tree rooted at
+ * `self`, including the Node headers themselves.
+ */
+size_t Node_footprint(const Node *self);
+
 #endif
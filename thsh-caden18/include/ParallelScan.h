@@ -0,0 +1,26 @@
+#ifndef PARALLEL_SCAN_H
+#define PARALLEL_SCAN_H
+
+#include "Rescan.h"
+
+/*
+ * Scans a large input on several threads. The input is cut into
+ * chunks of roughly `chunk_size` bytes, each ending just after a
+ * newline, which only a word with a command substitution spanning
+ * lines straddles. Chunks are handed out to `threads` workers,
+ * scanned into per-chunk TokenSpans, and stitched together in input
+ * order. Where a chunk was cut inside a substitution, the stitching
+ * lexes in sequence from the word until the lexer is again between
+ * tokens at the start of a chunk.
+ *
+ * The result is identical to TokenSpans_scan(input, length). Owner is
+ * responsible for calling Vec_drop.
+ */
+TokenSpans TokenSpans_scan_parallel(
+        const char *input,
+        size_t length,
+        size_t threads,
+        size_t chunk_size
+    );
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Node.h"
+#include "Vec.h"
+
+/*
+ * A ParseCache maps the raw bytes of an input line to the tree that
+ * parsing it produces, so that a repeated line costs a hash lookup
+ * and a Node_retain rather than a scan and a parse. Entries are
+ * evicted least recently used first once the trees held exceed the
+ * cache's byte budget.
+ *
+ * Trees handed out by the cache are shared: callers own one reference
+ * and must release it with Node_drop, but must never mutate the tree.
+ *
+ * A ParseCache is not thread-safe; give each thread its own.
+ */
+
+typedef struct CacheEntry CacheEntry;
+
+typedef struct ParseCache {
+    Vec buckets;        /* CacheEntry* chains, indexed by hash */
+    CacheEntry *newest; /* head of the LRU list */
+    CacheEntry *oldest; /* tail of the LRU list, evicted first */
+    size_t entries;
+    size_t bytes;       /* footprint of keys and trees held */
+    size_t budget;      /* maximum bytes before eviction */
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} ParseCache;
+
+/*
+ * Construct an empty ParseCache holding at most `budget` bytes of
+ * keys and trees. Owner is responsible for calling ParseCache_drop.
+ */
+ParseCache ParseCache_value(size_t budget);
+
+/* Releases the cache's reference to every tree it holds. */
+void ParseCache_drop(ParseCache *self);
+
+/*
+ * Returns the tree for the `length` bytes at `line`, parsing them on a
+ * miss. The caller owns one reference to the returned Node.
+ */
+Node* ParseCache_parse(ParseCache *self, const char *line, size_t length);
+
+/* Print hit, miss and eviction counters and memory use. */
+void ParseCache_report(const ParseCache *self, FILE *out);
+
+#endif
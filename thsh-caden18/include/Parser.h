@@ -12,4 +12,83 @@
  */
 Node* parse(Scanner *s);
 
+/**
+ * The error of the ERROR_NODE that `parse` returns for input with no
+ * tokens at all, e.g. a blank line. Compare a tree's error against it
+ * to tell blank input apart from a syntax error.
+ */
+extern const char PARSE_EMPTY_INPUT[];
+
+/**
+ * The error of the ERROR_NODE that `parse` returns for input ending
+ * in a '|', which more input could complete.
+ */
+extern const char PARSE_INCOMPLETE[];
+
+/**
+ * The error of the ERROR_NODE that `parse` returns for input ending
+ * in a '&&' or '||', which more input could likewise complete.
+ */
+extern const char PARSE_INCOMPLETE_LIST[];
+
+/**
+ * The error of the ERROR_NODE that `parse` returns for input ending
+ * within a loop, before its 'done'.
+ */
+extern const char PARSE_INCOMPLETE_LOOP[];
+
+/**
+ * Whether `tree` is the ERROR_NODE of input that more lines could
+ * complete: a PARSE_INCOMPLETE, PARSE_INCOMPLETE_LIST or
+ * PARSE_INCOMPLETE_LOOP error.
+ */
+bool parse_incomplete(const Node *tree);
+
+/**
+ * A PushParser parses a list that arrives in pieces, such as an
+ * interactive line ending in '|' or '&&' followed by its continuation
+ * lines, or a loop written over several lines. Each piece is scanned
+ * once: pipelines and commands already parsed are kept between pushes
+ * rather than re-scanned, so resuming costs only the new bytes. The
+ * text of an unfinished loop is kept instead: each line pushed into it
+ * is only scanned to count the loops it opens and closes, and the
+ * whole loop is parsed once its last 'done' arrives.
+ */
+typedef struct PushParser {
+    Vec items;          /* pipelines of the list begun so far */
+    Vec commands;       /* Node* of the pipeline begun so far */
+    Vec words;          /* scratch CharSpans of the command being parsed */
+    Vec redirects;      /* scratch RedirectSpans of the same */
+    Vec substitutions;  /* scratch Substitutions of the same */
+    Str loop;           /* text of an unfinished loop */
+    size_t loop_counted; /* bytes of `loop` whose tokens are counted */
+    size_t loop_depth;   /* loops begun in them and not yet done */
+    int loop_state;      /* what their next token may be */
+} PushParser;
+
+PushParser PushParser_value(void);
+
+void PushParser_drop(PushParser *self);
+
+/**
+ * True when earlier pushes began a list that still needs a command
+ * after its last '|', '&&' or '||', or a loop that needs its 'done'.
+ */
+bool PushParser_pending(const PushParser *self);
+
+/**
+ * Push one or more whole lines of input. Returns the parse tree, as
+ * `parse` would, once the pushed text completes a list. Returns NULL
+ * when it ends right after a '|', '&&' or '||', or within a loop,
+ * keeping the list so far for the next push. The caller owns any returned `Node*`.
+ */
+Node* PushParser_push(PushParser *self, const char *text, size_t length);
+
+/**
+ * At the end of input: returns a PARSE_INCOMPLETE,
+ * PARSE_INCOMPLETE_LIST or PARSE_INCOMPLETE_LOOP ERROR_NODE if a list
+ * is pending, discarding it, or NULL otherwise.
+ */
+Node* PushParser_finish(PushParser *self);
+
 #endif
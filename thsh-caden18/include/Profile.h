@@ -0,0 +1,67 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Histogram.h"
+
+/*
+ * Phase level latency instrumentation. Each phase of handling a line
+ * of input has a Histogram of monotonic clock durations in
+ * nanoseconds. Recording only happens after Profile_enable, so a
+ * disabled timer costs an atomic load and a branch. The switch may be
+ * read from any thread. Building with -DTHSH_NO_PROFILE removes the
+ * timers entirely.
+ */
+
+typedef enum Phase {
+    PHASE_READ = 0,  /* reading a line of input */
+    PHASE_SCAN = 1,  /* producing one Token */
+    PHASE_PARSE = 2, /* parsing one line, including its scanning */
+    PHASE_EXEC = 3,  /* executing one parsed line */
+    PHASE_COUNT
+} Phase;
+
+void Profile_enable(void);
+
+void Profile_disable(void);
+
+bool Profile_enabled(void);
+
+/* Nanoseconds on the monotonic clock. */
+uint64_t Profile_now(void);
+
+void Profile_record(Phase phase, uint64_t nanos);
+
+/* The Histogram backing a phase. */
+const Histogram* Profile_histogram(Phase phase);
+
+/* Print count, p50, p99 and max of each phase that has samples. */
+void Profile_report(FILE *out);
+
+void Profile_reset(void);
+
+/*
+ * Usage:
+ *
+ *   PROFILE_START(t);
+ *   ... work ...
+ *   PROFILE_STOP(t, PHASE_PARSE);
+ */
+#ifdef THSH_NO_PROFILE
+#define PROFILE_START(timer)
+#define PROFILE_STOP(timer, phase)
+#else
+#define PROFILE_START(timer) \
+    uint64_t timer = Profile_enabled() ? Profile_now() : 0
+#define PROFILE_STOP(timer, phase) \
+    do { \
+        if (timer != 0) { \
+            Profile_record(phase, Profile_now() - timer); \
+        } \
+    } while (0)
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "Builtin.h"
+#include "JobTable.h"
+#include "Node.h"
+#include "Vec.h"
+
+/*
+ * A Program is a parse tree lowered to a flat array of instructions,
+ * so that running a list or a loop is one pass over an array rather
+ * than a recursive walk: the '&&' and '||' of a list and the ends of
+ * every loop are resolved to jump targets once, when compiling.
+ *
+ * Pipelines are still run by Exec, which owns their pipes, redirects,
+ * builtin threads and jobs, except a lone builtin command with nothing
+ * to expand or redirect: that is resolved when compiling and called
+ * directly, with none of a pipeline's setup.
+ *
+ * A Program borrows the tree it was compiled from, which must outlive
+ * it and not change. Running one only reads it, so one Program may be
+ * run by several threads at once.
+ */
+
+typedef enum Opcode {
+    OP_RUN = 0,              /* run pipeline nodes[operand] */
+    OP_BUILTIN = 1,          /* call builtin calls[operand] */
+    OP_JUMP_IF_FAILED = 2,   /* continue at operand if the status is not 0 */
+    OP_JUMP_IF_SUCCEEDED = 3,/* continue at operand if the status is 0 */
+    OP_WHILE = 4,            /* enter a while loop */
+    OP_TEST = 5,             /* leave the loop for operand if its condition failed */
+    OP_FOR = 6,              /* enter a for loop over the head nodes[operand] */
+    OP_NEXT = 7,             /* bind the loop's next word, or leave it for operand */
+    OP_REPEAT = 8,           /* keep the body's status and jump back to operand */
+    OP_ERROR = 9,            /* report the syntax error nodes[operand] */
+    OP_HALT = 10,            /* stop with the status */
+    OPCODE_COUNT
+} Opcode;
+
+typedef struct Instruction {
+    uint32_t opcode;
+    uint32_t operand;
+} Instruction;
+
+/* A builtin command resolved when compiling, and the argv to call it with. */
+typedef struct BuiltinCall {
+    Builtin builtin;
+    char *const *argv;
+} BuiltinCall;
+
+typedef struct Program {
+    Vec code;     /* Instruction */
+    Vec nodes;    /* const Node*, the operands of OP_RUN, OP_FOR and OP_ERROR */
+    Vec calls;    /* BuiltinCall, the operands of OP_BUILTIN */
+    size_t depth; /* deepest nesting of loops */
+} Program;
+
+/*
+ * Compile the tree rooted at `tree`, which may be an ERROR_NODE.
+ * Owner is responsible for calling Program_drop.
+ */
+Program Program_compile(const Node *tree);
+
+void Program_drop(Program *self);
+
+/*
+ * Run the program as execute_with runs the tree it was compiled from,
+ * with the same output and exit status.
+ */
+int Program_run(const Program *self, int in_fd, int out_fd, JobTable *jobs);
+
+/* Print one line per instruction, for debugging. */
+void Program_print(const Program *self, FILE *out);
+
+#endif
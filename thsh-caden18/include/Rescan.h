@@ -0,0 +1,52 @@
+#ifndef RESCAN_H
+#define RESCAN_H
+
+#include "Scanner.h"
+#include "Vec.h"
+
+/*
+ * Incremental scanning for interactive editing. Tokens record where
+ * their lexemes lie within the input. After an edit, Rescan re-lexes
+ * only from the last token boundary before the edit until the new
+ * token stream lines up again with the old one, then shifts the
+ * remaining tokens.
+ */
+
+/* TokenSpans is a Vec of Token values, excluding END_TOKEN. */
+typedef Vec TokenSpans;
+
+/*
+ * An edit that replaced `deleted` bytes starting at `offset` with
+ * `inserted` bytes.
+ */
+typedef struct Edit {
+    size_t offset;
+    size_t deleted;
+    size_t inserted;
+} Edit;
+
+/*
+ * Scan all `length` bytes of `input` into a new TokenSpans. Owner is
+ * responsible for calling Vec_drop.
+ */
+TokenSpans TokenSpans_scan(const char *input, size_t length);
+
+/*
+ * Scan the bytes of `input` from offset `from` up to `to`. Token
+ * offsets are into `input`, not into the range. `from` must not fall
+ * inside a token.
+ */
+TokenSpans TokenSpans_scan_range(const char *input, size_t from, size_t to);
+
+/* Append a token, growing the buffer geometrically. */
+void TokenSpans_push(TokenSpans *self, Token token);
+
+/*
+ * Update `spans`, previously scanned from the text before `edit`, to
+ * describe `input`, the text after `edit` was applied. The result is
+ * identical to TokenSpans_scan(input, length). Returns the number of
+ * tokens that had to be re-lexed.
+ */
+size_t TokenSpans_rescan(TokenSpans *spans, const char *input, size_t length, Edit edit);
+
+#endif
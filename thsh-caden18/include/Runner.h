@@ -0,0 +1,40 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <stddef.h>
+
+/*
+ * Runs many scripts inside one process on a pool of worker threads,
+ * so that each script does not pay for starting a shell.
+ *
+ * Scripts are dealt out to the workers in contiguous blocks. A worker
+ * takes scripts from the front of its own block, and once its block
+ * is empty steals from the back of another worker's block. Every
+ * worker owns an Arena for the trees it parses, reset after each
+ * line, so workers share no mutable parser state.
+ *
+ * A script is parsed as standard input is: a line ending in '|',
+ * '&&' or '||', or within a loop, continues on the lines after it. A
+ * syntax error ends the script.
+ *
+ * Each script's commands read /dev/null and write to a private
+ * capture file. Captured output is copied to `out_fd` in script order
+ * as soon as each script and all scripts before it have finished.
+ *
+ * With a cache directory, a script whose lines were parsed by an
+ * earlier run is read back from its ScriptCache file rather than
+ * parsed, and one that was not is saved there after it runs.
+ */
+
+/*
+ * Run `count` scripts at the paths in `scripts` on `workers` threads.
+ * Stores each script's exit status, that of its last command, in
+ * `statuses`. A script that cannot be opened has status 127, and one
+ * with a syntax error has status 2. Returns
+ * the last non-zero status in script order, or 0 if all succeeded.
+ * `cache_dir` may be NULL to parse every script.
+ */
+int Runner_run(const char **scripts, size_t count, size_t workers, int out_fd, int *statuses,
+        const char *cache_dir);
+
+#endif
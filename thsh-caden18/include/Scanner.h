@@ -2,6 +2,7 @@
 #define SCANNER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "CharItr.h"
 #include "Str.h"
 
@@ -10,21 +11,56 @@
 typedef enum TokenType {
     END_TOKEN = -1,
     WORD_TOKEN = 0,
-    PIPE_TOKEN = 1
+    PIPE_TOKEN = 1,       /* | */
+    LESS_TOKEN = 2,       /* < */
+    GREAT_TOKEN = 3,      /* > */
+    DGREAT_TOKEN = 4,     /* >> */
+    ERR_GREAT_TOKEN = 5,  /* 2> */
+    ERR_TO_OUT_TOKEN = 6, /* 2>&1 */
+    AMP_TOKEN = 7,        /* & */
+    SEMI_TOKEN = 8,       /* ; */
+    AND_IF_TOKEN = 9,     /* && */
+    OR_IF_TOKEN = 10      /* || */
 } TokenType;
 
+/* The longest operator token, in bytes. */
+#define MAX_OPERATOR_LENGTH 4
+
+/* Token flags, describing what precedes a token. */
+#define TOKEN_SPACE_BEFORE 0x1 /* whitespace or the start of input */
+#define TOKEN_LINE_START   0x2 /* only blanks since a newline or the start */
+
+/*
+ * A WORD_TOKEN's lexeme runs to the next whitespace or operator
+ * outside of any command substitution, so `echo $(ls | wc -l)` is two
+ * words.
+ *
+ * A Token does not own its lexeme: it locates it within the source
+ * text the Scanner reads, which must outlive the Token. At 12 bytes,
+ * about five Tokens share a cache line. Sources are limited to 4 GB.
+ */
 typedef struct Token {
-    TokenType type;
-    Str lexeme;
+    int8_t type;     /* a TokenType */
+    uint8_t flags;   /* TOKEN_* flags */
+    uint32_t offset; /* of the lexeme's first byte within the source */
+    uint32_t length; /* of the lexeme in bytes */
 } Token;
 
+/*
+ * The first byte of `token`'s lexeme within `source`. The lexeme is
+ * `token.length` bytes long and is not null terminated.
+ */
+const char* Token_lexeme(Token token, const char *source);
+
 /** 
  * Scanner is a peekable iterator that produces Tokens from a CharItr input.
  **/
 
 typedef struct Scanner {
     CharItr char_itr;
+    const char *source;         /* Token offsets are relative to this */
     Token next;
+    const Allocator *allocator; /* source of the parse tree's memory */
 } Scanner;
 
 /**
@@ -32,6 +68,12 @@ typedef struct Scanner {
  **/
 Scanner Scanner_value(CharItr char_itr);
 
+/**
+ * A Scanner whose parse tree's Nodes and words are allocated by
+ * `allocator`. Scanning itself allocates nothing.
+ **/
+Scanner Scanner_value_with(CharItr char_itr, const Allocator *allocator);
+
 /**
  * Scanner_has_next returns true when there is another Token to
  * peek or take with next, false otherwise.
@@ -39,19 +81,72 @@ Scanner Scanner_value(CharItr char_itr);
 bool Scanner_has_next(const Scanner *self);
 
 /**
- * Peek the next Token without advancing the Scanner. The Scanner
- * still owns the Token (and, importantly, its lexeme Str).
+ * Peek the next Token without advancing the Scanner.
  */
 Token Scanner_peek(const Scanner *self);
 
 /**
- * Take the next Token and advance the Scanner. The caller of
- * Scanner_next owns the returned Token and is responsible for
- * calling Str_drop on its lexeme Str. 
+ * Take the next Token and advance the Scanner. Its lexeme is
+ * Token_lexeme(token, scanner->source).
  *
- * When there are no more tokens in the stream, return a token of
- * END_TOKEN type with an empty Str lexeme.
+ * When there are no more tokens in the stream, peek returns a token
+ * of END_TOKEN type with an empty lexeme.
  */
 Token Scanner_next(Scanner *self);
 
+/**
+ * A ScannerMark is a checkpoint of a Scanner's position: its cursor
+ * and pending Token. Marks own nothing and may be freely copied.
+ */
+typedef struct ScannerMark {
+    CharItr char_itr;
+    Token next;
+} ScannerMark;
+
+/**
+ * Checkpoint the Scanner so a parser can scan ahead speculatively and
+ * later rewind with Scanner_reset. O(1); copies no lexemes.
+ */
+ScannerMark Scanner_mark(const Scanner *self);
+
+/**
+ * Rewind the Scanner to `mark`, which must have been taken from this
+ * same Scanner. Tokens taken since the mark will be produced again.
+ */
+void Scanner_reset(Scanner *self, ScannerMark mark);
+
+/**
+ * The operator that `text` begins with, setting `length` to its size,
+ * or WORD_TOKEN if it does not begin with one. `available` is the
+ * number of bytes readable at `text`; an operator is only recognised
+ * whole, so callers scanning a stream should make at least
+ * MAX_OPERATOR_LENGTH bytes available until its end.
+ */
+TokenType Scanner_operator(const char *text, size_t available, size_t *length);
+
+/**
+ * The length of the command substitution that `text` begins with,
+ * `$(...)` or `...` in backquotes, including its delimiters, or 0 if
+ * it does not begin one. Parentheses nest within `$(...)`. Sets
+ * `closed` to false for a substitution left open at the end of the
+ * `available` bytes, whose length then runs to the end.
+ */
+size_t Scanner_substitution(const char *text, size_t available, bool *closed);
+
+/**
+ * The length of the variable that `text` begins with, `$name` or
+ * `${name}`, or 0 if it does not begin one. A name is a letter or '_'
+ * followed by letters, digits and '_'. Sets `name` to the offset of
+ * the name within `text` and `name_length` to its length.
+ */
+size_t Scanner_variable(const char *text, size_t available, size_t *name, size_t *name_length);
+
+/**
+ * The Scanner's lexical rules without a Scanner: skips whitespace,
+ * then advances `char_itr` past one token and returns it, with its
+ * offset relative to `source`. `char_itr` must lie within `source`.
+ * At the end of input returns an END_TOKEN with a length of zero.
+ */
+Token Scanner_lex(CharItr *char_itr, const char *source);
+
 #endif
@@ -0,0 +1,104 @@
+#ifndef SCRIPT_CACHE_H
+#define SCRIPT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Allocator.h"
+#include "Node.h"
+#include "Str.h"
+
+/*
+ * A script cache keeps the parsed lines of scripts on disk, so that a
+ * script run again is read back as trees rather than scanned and
+ * parsed. Each cache file holds one script's lines. It is named after
+ * the script's canonical path and stamped with the ScriptKey of its
+ * source: changing the script's bytes or its modification time changes
+ * the key, so a stale file is never used, and it is overwritten when
+ * the changed script is next run. There is one file per script, and
+ * nothing to invalidate by hand.
+ *
+ * A file holds no pointers, only lengths and counts, so it is read in
+ * place wherever it is mapped. Trees are decoded from the mapping one
+ * line at a time into the caller's allocator, with their words copied
+ * straight from the file; the text of error messages stays in the
+ * mapping, so a line's tree must be dropped before the CachedScript.
+ *
+ * Files are written to a temporary name and renamed into place, so
+ * scripts run at once by several threads or processes never see a
+ * partly written file.
+ */
+
+/* Message of the error tree decoded from a damaged cache file. */
+extern const char *SCRIPT_CACHE_CORRUPT;
+
+/* What a cache file is valid for: one version of one script's source. */
+typedef struct ScriptKey {
+    uint64_t hash;       /* FNV-1a of the source bytes */
+    uint64_t size;       /* of the source in bytes */
+    int64_t mtime_sec;   /* modification time of the source */
+    int64_t mtime_nsec;
+} ScriptKey;
+
+/*
+ * Stores the key of the regular file open at `fd` in `key`, reading
+ * all of it without moving its offset. Returns false if it cannot.
+ */
+bool ScriptKey_of(int fd, ScriptKey *key);
+
+/* A script's lines encoded as they are parsed, to save on a miss. */
+typedef struct ScriptEncoder {
+    Str bytes;
+    uint32_t lines;
+} ScriptEncoder;
+
+/* Owner is responsible for calling ScriptEncoder_drop. */
+ScriptEncoder ScriptEncoder_value(void);
+
+void ScriptEncoder_drop(ScriptEncoder *self);
+
+/* Append the tree of the script's next line, which is only read. */
+void ScriptEncoder_add(ScriptEncoder *self, const Node *tree);
+
+/*
+ * Write the lines added so far as the cache file in `dir` for the
+ * script at `source`, stamped with `key`, replacing any file for an
+ * older version of it and creating `dir` if needed. Returns false if
+ * the file cannot be written, leaving no file behind.
+ */
+bool ScriptEncoder_save(const ScriptEncoder *self, const char *dir, const char *source,
+        const ScriptKey *key);
+
+/* A cache file mapped into memory and the line to be decoded next. */
+typedef struct CachedScript {
+    char *map;
+    size_t size;
+    size_t cursor;      /* offset of the next line */
+    uint32_t remaining; /* lines not yet decoded */
+} CachedScript;
+
+/*
+ * Maps the cache file in `dir` for the script at `source`. Returns
+ * false, leaving nothing to drop, if there is none or it was written
+ * for another key, such as an older version of the script, or by
+ * another version of thsh.
+ */
+bool CachedScript_open(CachedScript *self, const char *dir, const char *source,
+        const ScriptKey *key);
+
+void CachedScript_drop(CachedScript *self);
+
+/*
+ * The tree of the next line, allocated by `allocator`, or NULL after
+ * the last. A damaged file decodes as an ERROR_NODE whose message is
+ * SCRIPT_CACHE_CORRUPT, and ends there.
+ */
+Node* CachedScript_next(CachedScript *self, const Allocator *allocator);
+
+/*
+ * The directory for cache files: $THSH_CACHE_DIR, else thsh within
+ * $XDG_CACHE_HOME or else ~/.cache. Empty when none of these is set.
+ */
+Str ScriptCache_dir(void);
+
+#endif
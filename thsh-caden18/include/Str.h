@@ -5,7 +5,9 @@
 
 /**
  * Str is just an alias of Vec to make its purpose of storing
- * char data and the following functions clear.
+ * char data and the following functions clear. As with Vec, the
+ * functions which may allocate are macros charging the memory to
+ * their caller's file and line.
  */
 typedef Vec Str;
 
@@ -13,7 +15,15 @@ typedef Vec Str;
  * Construct an empty Str value. Owner is responsible for calling
  * Str_drop when its lifetime expires.
  */
-Str Str_value(size_t capacity);
+#define Str_value(capacity) Str_value_at(capacity, &LIBC_ALLOCATOR, __FILE__, __LINE__)
+
+/**
+ * Construct an empty Str value whose buffer comes from `allocator`.
+ */
+#define Str_value_with(capacity, allocator) \
+    Str_value_at(capacity, allocator, __FILE__, __LINE__)
+
+Str Str_value_at(size_t capacity, const Allocator *allocator, const char *file, int line);
 
 /**
  * Owner of a Str must call to expire its buffer data's lifetime.
@@ -47,18 +57,31 @@ const char* Str_cstr(const Str *self);
  *
  * Usage: Str s = Str_from("hello, world");
  */
-Str Str_from(const char *cstr);
+#define Str_from(cstr) Str_from_at(cstr, &LIBC_ALLOCATOR, __FILE__, __LINE__)
+
+/**
+ * Str_from, with the copy's buffer allocated by `allocator`.
+ */
+#define Str_from_with(cstr, allocator) Str_from_at(cstr, allocator, __FILE__, __LINE__)
+
+Str Str_from_at(const char *cstr, const Allocator *allocator, const char *file, int line);
 
 /**
  * Starting from `index`, remove `delete_count` items from `self`,
  * and insert `insert_count` values from `cstr` at that index of `self`.
+ * When the Str must grow, its capacity at least doubles.
  */
-void Str_splice(
+#define Str_splice(self, index, delete_count, cstr, insert_count) \
+    Str_splice_at(self, index, delete_count, cstr, insert_count, __FILE__, __LINE__)
+
+void Str_splice_at(
         Str *self,
         size_t index,
         size_t delete_count,
         const char *cstr,
-        size_t insert_count
+        size_t insert_count,
+        const char *file,
+        int line
      );
 
 /**
@@ -66,7 +89,9 @@ void Str_splice(
  * memory allocation to be able to store the cstr's character
  * contents if necessary.
  */
-void Str_append(Str *self, const char *cstr);
+#define Str_append(self, cstr) Str_append_at(self, cstr, __FILE__, __LINE__)
+
+void Str_append_at(Str *self, const char *cstr, const char *file, int line);
 
 /**
  * Get a character at a specific index of the Str.
@@ -78,6 +103,8 @@ char Str_get(const Str *self, size_t index);
  * is the length of the Str, it will append the character to the
  * end of the Str and terminate with a null character.
  */
-void Str_set(Str *self, size_t index, const char value);
+#define Str_set(self, index, value) Str_set_at(self, index, value, __FILE__, __LINE__)
+
+void Str_set_at(Str *self, size_t index, const char value, const char *file, int line);
 
 #endif
@@ -13,6 +13,10 @@ typedef Vec StrVec;
  */
 StrVec StrVec_value(size_t capacity);
 
+/* Construct an empty StrVec value whose buffer of
+ * Str headers comes from `allocator`. */
+StrVec StrVec_value_with(size_t capacity, const Allocator *allocator);
+
 /* Owner of StrVec must call drop to expire
  * its lifetime and the heap memory its Str
  * items own. */
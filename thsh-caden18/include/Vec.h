@@ -4,8 +4,16 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "Allocator.h"
+
 /**
  * Vec - a dynamically growable array of any type.
+ *
+ * The operations which may allocate are macros that pass the caller's
+ * __FILE__ and __LINE__ on to a function ending in `_at`, so that
+ * MemStats charges the memory to the code that asked for it rather
+ * than to Vec itself. Wrappers such as Str pass their own caller's
+ * location on in turn.
  */
 
 /**
@@ -19,6 +27,7 @@ typedef struct Vec {
     size_t length;    /* number of items in Vec */
     size_t capacity;  /* number of items buffer can store */
     void *buffer;     /* heap memory storing items */
+    const Allocator *allocator; /* source of buffer's memory */
 } Vec;
 
 /* Constructor / Destructor */
@@ -31,7 +40,22 @@ typedef struct Vec {
  * @param item_size - sizeof an individual item
  * @return initialized Vec value.
  */
-Vec Vec_value(size_t capacity, size_t item_size);
+#define Vec_value(capacity, item_size) \
+    Vec_value_at(capacity, item_size, &LIBC_ALLOCATOR, __FILE__, __LINE__)
+
+/**
+ * Construct a Vec value whose buffer is allocated, grown and freed
+ * by `allocator`. The allocator must outlive the Vec. Vec_value is
+ * equivalent to passing &LIBC_ALLOCATOR.
+ */
+#define Vec_value_with(capacity, item_size, allocator) \
+    Vec_value_at(capacity, item_size, allocator, __FILE__, __LINE__)
+
+/**
+ * Vec_value_with, with the buffer charged to file:line.
+ */
+Vec Vec_value_at(size_t capacity, size_t item_size, const Allocator *allocator,
+        const char *file, int line);
 
 /**
  * Owner must call to expire a Vec value's lifetime.
@@ -74,7 +98,9 @@ void Vec_get(const Vec *self, size_t index, void *out);
  * to assign to an `index` greater than length will result
  * in an out of bounds crash.
  */
-void Vec_set(Vec *self, size_t index, const void *value);
+#define Vec_set(self, index, value) Vec_set_at(self, index, value, __FILE__, __LINE__)
+
+void Vec_set_at(Vec *self, size_t index, const void *value, const char *file, int line);
 
 /**
  * Compare deep equality with another Vec. Should return true
@@ -103,14 +129,25 @@ bool Vec_equals(const Vec *self, const Vec *other);
  * Vec_splice(&v, 0, 0, a, 2)   | [800, 900, 100, 200, 300, 400]
  * Vec_splice(&v, 0, 3, a, 1)   | [800, 400]
  */
-void Vec_splice(
-        Vec *self, 
-        size_t index, 
-        size_t delete_count, 
-        const void *items, 
-        size_t insert_count
+#define Vec_splice(self, index, delete_count, items, insert_count) \
+    Vec_splice_at(self, index, delete_count, items, insert_count, __FILE__, __LINE__)
+
+void Vec_splice_at(
+        Vec *self,
+        size_t index,
+        size_t delete_count,
+        const void *items,
+        size_t insert_count,
+        const char *file,
+        int line
         );
 
-static void ensure_capacity(Vec *self, size_t n);
+/**
+ * Ensure the Vec's buffer can hold at least `capacity` items without
+ * relocating. Never shrinks the buffer.
+ */
+#define Vec_reserve(self, capacity) Vec_reserve_at(self, capacity, __FILE__, __LINE__)
+
+void Vec_reserve_at(Vec *self, size_t capacity, const char *file, int line);
 
 #endif
@@ -0,0 +1,72 @@
+#ifndef THSH_H
+#define THSH_H
+
+#include <stddef.h>
+
+#include "Allocator.h"
+#include "Node.h"
+
+/*
+ * libthsh - the thsh scanner and parser as an embeddable library.
+ *
+ * Build with `make lib`, which produces build/lib/libthsh.a and
+ * build/lib/libthsh.so, and include this header.
+ *
+ * thsh_parse is reentrant and thread-safe: it touches no shared
+ * mutable state, so any number of threads may call it at once as long
+ * as each passes its own Arena. Every byte it allocates comes from
+ * that Arena and can be bounded with thsh_options.max_memory. It never
+ * prints and never exits the process; every failure, including
+ * running out of memory, is reported through its return value.
+ *
+ * Example:
+ *
+ *   Arena arena = Arena_value(4096);
+ *   thsh_options options = { 1 << 16, 1 << 20 };
+ *   thsh_result result;
+ *   if (thsh_parse(line, length, &options, &arena, &result) == THSH_OK) {
+ *       ... inspect result.tree ...
+ *   }
+ *   Arena_reset(&arena); // expires result.tree
+ *   ...
+ *   Arena_drop(&arena);
+ */
+
+typedef enum thsh_status {
+    THSH_OK = 0,             /* result.tree is a valid parse tree */
+    THSH_EMPTY = 1,          /* input contained no tokens */
+    THSH_SYNTAX_ERROR = 2,   /* result.error describes the problem */
+    THSH_TOO_LARGE = 3,      /* input longer than max_input */
+    THSH_NO_MEMORY = 4,      /* allocations exceeded max_memory */
+    THSH_INTERNAL_ERROR = 5  /* a bug in thsh; result.error has details */
+} thsh_status;
+
+typedef struct thsh_options {
+    size_t max_input;  /* longest input accepted in bytes; 0 is no limit */
+    size_t max_memory; /* bytes thsh_parse may take from the Arena; 0 is no limit */
+} thsh_options;
+
+typedef struct thsh_result {
+    thsh_status status;
+    const Node *tree;  /* owned by the Arena, NULL unless THSH_OK */
+    const char *error; /* static message, NULL when THSH_OK */
+} thsh_result;
+
+/*
+ * Parse `length` bytes of `input`, which need not be null terminated.
+ * The tree is allocated in `arena` and lives until the Arena is reset
+ * or dropped. `options` may be NULL for no limits. Fills `result` and
+ * returns its status.
+ */
+thsh_status thsh_parse(
+        const char *input,
+        size_t length,
+        const thsh_options *options,
+        Arena *arena,
+        thsh_result *result
+    );
+
+/* A static, human readable description of `status`. */
+const char* thsh_status_message(thsh_status status);
+
+#endif
@@ -0,0 +1,179 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "Allocator.h"
+#include "MemStats.h"
+
+/* libc Allocator */
+
+static void* libc_alloc(void *ctx, size_t size)
+{
+    return calloc(1, size);
+}
+
+static void* libc_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    return realloc(ptr, new_size);
+}
+
+static void libc_free(void *ctx, void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+const Allocator LIBC_ALLOCATOR = {
+    libc_alloc,
+    libc_realloc,
+    libc_free,
+    NULL
+};
+
+void* Allocator_alloc(const Allocator *self, size_t size)
+{
+    return self->alloc(self->ctx, size);
+}
+
+void* Allocator_realloc(const Allocator *self, void *ptr, size_t old_size, size_t new_size)
+{
+    return self->realloc(self->ctx, ptr, old_size, new_size);
+}
+
+void Allocator_free(const Allocator *self, void *ptr, size_t size)
+{
+    if (ptr != NULL) {
+        MemStats_free(ptr);
+        self->free(self->ctx, ptr, size);
+    }
+}
+
+/* Arena Allocator */
+
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t capacity;
+    size_t used;
+    max_align_t data[];
+};
+
+static size_t align_up(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static void* arena_alloc(void *ctx, size_t size)
+{
+    Arena *arena = ctx;
+    size = align_up(size == 0 ? 1 : size);
+    if (arena->limit != 0 && arena->allocated + size > arena->limit) {
+        return NULL;
+    }
+    ArenaChunk *chunk = arena->head;
+    if (chunk == NULL || chunk->capacity - chunk->used < size) {
+        size_t capacity = size > arena->chunk_size ? size : arena->chunk_size;
+        chunk = malloc(sizeof(ArenaChunk) + capacity);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = arena->head;
+        chunk->capacity = capacity;
+        chunk->used = 0;
+        arena->head = chunk;
+    }
+    void *ptr = (char*) chunk->data + chunk->used;
+    chunk->used += size;
+    arena->allocated += size;
+    memset(ptr, 0, size);
+    arena->last = ptr;
+    arena->last_size = size;
+    return ptr;
+}
+
+static void* arena_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    Arena *arena = ctx;
+    if (ptr != NULL && ptr == arena->last) {
+        ArenaChunk *chunk = arena->head;
+        size_t start = chunk->used - arena->last_size;
+        size_t size = align_up(new_size);
+        size_t allocated = arena->allocated - arena->last_size + size;
+        if (arena->limit != 0 && allocated > arena->limit) {
+            return NULL;
+        }
+        if (start + size <= chunk->capacity) {
+            chunk->used = start + size;
+            arena->allocated = allocated;
+            arena->last_size = size;
+            return ptr;
+        }
+    }
+    void *moved = arena_alloc(ctx, new_size);
+    if (moved != NULL && ptr != NULL) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return moved;
+}
+
+static void arena_free(void *ctx, void *ptr, size_t size)
+{
+    /* Memory is reclaimed all at once by Arena_drop. */
+}
+
+Arena Arena_value(size_t chunk_size)
+{
+    Arena arena = {
+        NULL,
+        align_up(chunk_size),
+        NULL,
+        0,
+        0,
+        0,
+        { arena_alloc, arena_realloc, arena_free, NULL }
+    };
+    return arena;
+}
+
+void Arena_set_limit(Arena *self, size_t limit)
+{
+    self->limit = limit;
+}
+
+const Allocator* Arena_allocator(Arena *self)
+{
+    self->allocator.ctx = self;
+    return &self->allocator;
+}
+
+void Arena_reset(Arena *self)
+{
+    ArenaChunk *keep = self->head;
+    if (keep == NULL) {
+        return;
+    }
+    ArenaChunk *chunk = keep->next;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    keep->next = NULL;
+    keep->used = 0;
+    self->last = NULL;
+    self->last_size = 0;
+    self->allocated = 0;
+}
+
+void Arena_drop(Arena *self)
+{
+    ArenaChunk *chunk = self->head;
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    self->head = NULL;
+    self->last = NULL;
+    self->last_size = 0;
+    self->allocated = 0;
+}
@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Batch.h"
+#include "Exec.h"
+#include "Guards.h"
+#include "ParseCache.h"
+#include "Parser.h"
+#include "Profile.h"
+
+#define PARSER_CACHE_BUDGET (256 << 10)
+#define NO_TOTAL ((size_t) -1)
+
+typedef enum SlotStage {
+    SLOT_EMPTY = 0,
+    SLOT_READ = 1,
+    SLOT_PARSED = 2
+} SlotStage;
+
+typedef struct Slot {
+    int stage;   /* SlotStage, accessed atomically */
+    size_t seq;  /* line number held, valid once stage is READ */
+    char *line;
+    size_t length;
+    Node *tree;
+} Slot;
+
+typedef struct Pipeline {
+    FILE *script;
+    Vec slots;          /* Slot values, line n lives in slot n % depth */
+    size_t depth;
+    size_t next_parse;  /* next line number a parser may claim */
+    size_t total;       /* lines read, NO_TOTAL until end of input */
+} Pipeline;
+
+/*
+ * Back off while waiting on another stage: spin briefly, then yield,
+ * then sleep, so that an idle stage does not burn a core.
+ */
+static void backoff(unsigned *attempt)
+{
+    if (*attempt < 64) {
+        /* spin */
+    } else if (*attempt < 128) {
+        sched_yield();
+    } else {
+        struct timespec nap = { 0, 50000 };
+        nanosleep(&nap, NULL);
+    }
+    ++*attempt;
+}
+
+static Slot* slot_of(Pipeline *self, size_t seq)
+{
+    return Vec_ref(&self->slots, seq % self->depth);
+}
+
+static int stage_of(const Slot *slot)
+{
+    return __atomic_load_n(&slot->stage, __ATOMIC_ACQUIRE);
+}
+
+static void set_stage(Slot *slot, SlotStage stage)
+{
+    __atomic_store_n(&slot->stage, stage, __ATOMIC_RELEASE);
+}
+
+static size_t total_of(Pipeline *self)
+{
+    return __atomic_load_n(&self->total, __ATOMIC_ACQUIRE);
+}
+
+static void* reader(void *arg)
+{
+    Pipeline *self = arg;
+    size_t seq = 0;
+    while (true) {
+        Slot *slot = slot_of(self, seq);
+        unsigned attempt = 0;
+        while (stage_of(slot) != SLOT_EMPTY) {
+            backoff(&attempt);
+        }
+
+        PROFILE_START(timer);
+        char *line = NULL;
+        size_t capacity = 0;
+        ssize_t length = getline(&line, &capacity, self->script);
+        PROFILE_STOP(timer, PHASE_READ);
+        if (length < 0) {
+            free(line);
+            break;
+        }
+        slot->line = line;
+        slot->length = length;
+        slot->seq = seq;
+        set_stage(slot, SLOT_READ);
+        ++seq;
+    }
+    __atomic_store_n(&self->total, seq, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* parser(void *arg)
+{
+    Pipeline *self = arg;
+    ParseCache cache = ParseCache_value(PARSER_CACHE_BUDGET);
+    while (true) {
+        size_t seq = __atomic_fetch_add(&self->next_parse, 1, __ATOMIC_RELAXED);
+        Slot *slot = slot_of(self, seq);
+        unsigned attempt = 0;
+        bool done = false;
+        while (stage_of(slot) != SLOT_READ || slot->seq != seq) {
+            if (seq >= total_of(self)) {
+                done = true;
+                break;
+            }
+            backoff(&attempt);
+        }
+        if (done) {
+            break;
+        }
+        slot->tree = ParseCache_parse(&cache, slot->line, slot->length);
+        set_stage(slot, SLOT_PARSED);
+    }
+    ParseCache_drop(&cache);
+    return NULL;
+}
+
+/*
+ * The tree that the line in `slot` completes, or NULL if it only
+ * continues a list or loop begun on the lines before it, which
+ * `continuation` keeps. Such lines were parsed alone by the parser
+ * pool, which cannot know what came before them, so their trees are
+ * dropped and the line pushed again here, in order. At the end of the
+ * script, when `slot` is NULL, a list still pending is a syntax error.
+ */
+static Node* continue_line(PushParser *continuation, Slot *slot)
+{
+    if (slot == NULL) {
+        return PushParser_finish(continuation);
+    }
+    Node *tree = slot->tree;
+    slot->tree = NULL;
+    if (PushParser_pending(continuation) || parse_incomplete(tree)) {
+        Node_drop(tree);
+        tree = PushParser_push(continuation, slot->line, slot->length);
+    }
+    return tree;
+}
+
+int Batch_run(FILE *script, int out_fd, BatchOptions options)
+{
+    size_t depth = options.depth == 0 ? 1 : options.depth;
+    size_t parsers = options.parsers == 0 ? 1 : options.parsers;
+    Pipeline self = {
+        script,
+        Vec_value(depth, sizeof(Slot)),
+        depth,
+        0,
+        NO_TOTAL
+    };
+    Slot empty = { SLOT_EMPTY, 0, NULL, 0, NULL };
+    for (size_t i = 0; i < depth; ++i) {
+        Vec_set(&self.slots, i, &empty);
+    }
+
+    int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (null_fd < 0) {
+        null_fd = STDIN_FILENO;
+    }
+
+    pthread_t reader_thread;
+    if (pthread_create(&reader_thread, NULL, reader, &self) != 0) {
+        OOM_GUARD(NULL, __FILE__, __LINE__);
+    }
+    Vec parser_threads = Vec_value(parsers, sizeof(pthread_t));
+    for (size_t i = 0; i < parsers; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, parser, &self) != 0) {
+            OOM_GUARD(NULL, __FILE__, __LINE__);
+        }
+        Vec_set(&parser_threads, i, &thread);
+    }
+
+    /*
+     * Lines ending in '|', '&&' or '||', or within a loop, continue on
+     * the lines after them, as they do on standard input. A syntax
+     * error ends the script with its status; the lines after it are
+     * still taken from the ring, so that the other stages finish, but
+     * not run.
+     */
+    PushParser continuation = PushParser_value();
+    bool failed = false;
+    int status = EXIT_SUCCESS;
+    for (size_t seq = 0; ; ++seq) {
+        Slot *slot = slot_of(&self, seq);
+        unsigned attempt = 0;
+        bool done = false;
+        while (stage_of(slot) != SLOT_PARSED || slot->seq != seq) {
+            if (seq >= total_of(&self)) {
+                done = true;
+                break;
+            }
+            backoff(&attempt);
+        }
+        if (done) {
+            slot = NULL;
+        }
+        Node *tree = failed ? NULL : continue_line(&continuation, slot);
+        if (tree != NULL) {
+            if (tree->type != ERROR_NODE || tree->data.error != PARSE_EMPTY_INPUT) {
+                failed = tree->type == ERROR_NODE;
+                status = execute(tree, null_fd, out_fd);
+            }
+            Node_drop(tree);
+        }
+        if (done) {
+            break;
+        }
+        if (slot->tree != NULL) {
+            slot->tree = Node_drop(slot->tree);
+        }
+        free(slot->line);
+        slot->line = NULL;
+        set_stage(slot, SLOT_EMPTY);
+    }
+    PushParser_drop(&continuation);
+
+    pthread_join(reader_thread, NULL);
+    for (size_t i = 0; i < parsers; ++i) {
+        pthread_join(*(pthread_t*) Vec_ref(&parser_threads, i), NULL);
+    }
+    Vec_drop(&parser_threads);
+    Vec_drop(&self.slots);
+    if (null_fd != STDIN_FILENO) {
+        close(null_fd);
+    }
+    return status;
+}
@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Builtin.h"
+#include "Env.h"
+#include "IoCopy.h"
+#include "Str.h"
+
+typedef struct BuiltinEntry {
+    const char *name;
+    Builtin run;
+    int max_files; /* operands supported, or -1 for any number */
+} BuiltinEntry;
+
+static int builtin_cat(char *const argv[], int in, int out, int err);
+static int builtin_tee(char *const argv[], int in, int out, int err);
+static int builtin_echo(char *const argv[], int in, int out, int err);
+static int builtin_true(char *const argv[], int in, int out, int err);
+static int builtin_false(char *const argv[], int in, int out, int err);
+static int builtin_export(char *const argv[], int in, int out, int err);
+static int builtin_unset(char *const argv[], int in, int out, int err);
+
+static const BuiltinEntry BUILTINS[] = {
+    { "cat", builtin_cat, -1 },
+    { "tee", builtin_tee, 1 },
+    { "echo", builtin_echo, -1 },
+    { "true", builtin_true, 0 },
+    { "false", builtin_false, 0 },
+    { "export", builtin_export, -1 },
+    { "unset", builtin_unset, -1 },
+};
+
+Builtin Builtin_find(char *const argv[])
+{
+    for (size_t i = 0; i < sizeof(BUILTINS) / sizeof(BUILTINS[0]); ++i) {
+        const BuiltinEntry *entry = &BUILTINS[i];
+        if (strcmp(argv[0], entry->name) != 0) {
+            continue;
+        }
+        int files = 0;
+        for (char *const *arg = argv + 1; *arg != NULL; ++arg) {
+            if ((*arg)[0] == '-' && (*arg)[1] != '\0') {
+                return NULL; /* options are left to the real command */
+            }
+            ++files;
+        }
+        if (entry->max_files >= 0 && files > entry->max_files) {
+            return NULL;
+        }
+        return entry->run;
+    }
+    return NULL;
+}
+
+static int fail(int err, const char *name, const char *operand)
+{
+    dprintf(err, "%s: %s: %s\n", name, operand, strerror(errno));
+    return EXIT_FAILURE;
+}
+
+/* cat [FILE]... where "-" is the input */
+static int builtin_cat(char *const argv[], int in, int out, int err)
+{
+    if (argv[1] == NULL) {
+        return IoCopy_copy(in, out) < 0 ? fail(err, "cat", "-") : EXIT_SUCCESS;
+    }
+    int status = EXIT_SUCCESS;
+    for (char *const *arg = argv + 1; *arg != NULL; ++arg) {
+        if (strcmp(*arg, "-") == 0) {
+            if (IoCopy_copy(in, out) < 0) {
+                status = fail(err, "cat", "-");
+            }
+            continue;
+        }
+        int fd = open(*arg, O_RDONLY | O_CLOEXEC);
+        if (fd < 0 || IoCopy_copy(fd, out) < 0) {
+            status = fail(err, "cat", *arg);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    return status;
+}
+
+/* tee [FILE] */
+static int builtin_tee(char *const argv[], int in, int out, int err)
+{
+    if (argv[1] == NULL) {
+        return IoCopy_copy(in, out) < 0 ? fail(err, "tee", "-") : EXIT_SUCCESS;
+    }
+    int fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        return fail(err, "tee", argv[1]);
+    }
+    int status = IoCopy_tee(in, out, fd) < 0 ? fail(err, "tee", argv[1]) : EXIT_SUCCESS;
+    close(fd);
+    return status;
+}
+
+/* echo [STRING]..., written with a single write(2) where possible */
+static int builtin_echo(char *const argv[], int in, int out, int err)
+{
+    (void) in;
+    Str line = Str_value(64);
+    for (char *const *arg = argv + 1; *arg != NULL; ++arg) {
+        if (arg > argv + 1) {
+            Str_append(&line, " ");
+        }
+        Str_append(&line, *arg);
+    }
+    Str_append(&line, "\n");
+    int status = EXIT_SUCCESS;
+    const char *cursor = Str_cstr(&line);
+    size_t left = Str_length(&line);
+    while (left > 0) {
+        ssize_t n = write(out, cursor, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            status = fail(err, "echo", "-");
+            break;
+        }
+        cursor += n;
+        left -= n;
+    }
+    Str_drop(&line);
+    return status;
+}
+
+/* true */
+static int builtin_true(char *const argv[], int in, int out, int err)
+{
+    (void) argv;
+    (void) in;
+    (void) out;
+    (void) err;
+    return EXIT_SUCCESS;
+}
+
+/* false */
+static int builtin_false(char *const argv[], int in, int out, int err)
+{
+    (void) argv;
+    (void) in;
+    (void) out;
+    (void) err;
+    return EXIT_FAILURE;
+}
+
+/* Whether the `length` chars at `name` make a variable name. */
+static bool is_name(const char *name, size_t length)
+{
+    if (length == 0 || !(isalpha((unsigned char) name[0]) || name[0] == '_')) {
+        return false;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if (!isalnum((unsigned char) name[i]) && name[i] != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * export [NAME[=VALUE]]... exports each NAME, set to VALUE if given.
+ * With no operands, lists the exported variables.
+ */
+static int builtin_export(char *const argv[], int in, int out, int err)
+{
+    (void) in;
+    Env *env = Env_shell();
+    if (argv[1] == NULL) {
+        EnvBlock *block = Env_block(env);
+        for (char *const *entry = EnvBlock_envp(block); *entry != NULL; ++entry) {
+            dprintf(out, "export %s\n", *entry);
+        }
+        EnvBlock_drop(block);
+        return EXIT_SUCCESS;
+    }
+    int status = EXIT_SUCCESS;
+    for (char *const *arg = argv + 1; *arg != NULL; ++arg) {
+        const char *equals = strchr(*arg, '=');
+        size_t length = equals != NULL ? (size_t) (equals - *arg) : strlen(*arg);
+        if (!is_name(*arg, length)) {
+            dprintf(err, "export: %s: not a valid name\n", *arg);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        char *name = strndup(*arg, length);
+        Env_export(env, name, equals != NULL ? equals + 1 : NULL);
+        free(name);
+    }
+    return status;
+}
+
+/* unset NAME... */
+static int builtin_unset(char *const argv[], int in, int out, int err)
+{
+    (void) in;
+    (void) out;
+    int status = EXIT_SUCCESS;
+    for (char *const *arg = argv + 1; *arg != NULL; ++arg) {
+        if (!is_name(*arg, strlen(*arg))) {
+            dprintf(err, "unset: %s: not a valid name\n", *arg);
+            status = EXIT_FAILURE;
+            continue;
+        }
+        Env_unset(Env_shell(), *arg);
+    }
+    return status;
+}
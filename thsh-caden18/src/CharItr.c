@@ -1,6 +1,23 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "CharItr.h"
+#include "Guards.h"
+
+/* The CHAR_* classes of every byte value. */
+static const unsigned char CLASSES[256] = {
+    ['\0'] = CHAR_SPACE,
+    [' '] = CHAR_SPACE,
+    ['\t'] = CHAR_SPACE,
+    ['\n'] = CHAR_SPACE,
+    ['|'] = CHAR_OPERATOR,
+    ['<'] = CHAR_OPERATOR,
+    ['>'] = CHAR_OPERATOR,
+    ['&'] = CHAR_OPERATOR,
+    [';'] = CHAR_OPERATOR,
+    ['$'] = CHAR_DOLLAR,
+    ['`'] = CHAR_DOLLAR,
+};
 
 CharItr CharItr_value(const char *start, size_t length)
 {
@@ -31,8 +48,7 @@ char CharItr_peek(const CharItr *self)
     if (CharItr_has_next(self)) {
         return *self->cursor;
     } else {
-        fprintf(stderr, "%s:%d - Out of Bounds", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
     }
 }
 
@@ -40,7 +56,53 @@ char CharItr_next(CharItr *self) {
     if (CharItr_has_next(self)) {
         return *self->cursor++;
     } else {
-        fprintf(stderr, "%s:%d - Out of Bounds", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
+    }
+}
+
+unsigned CharItr_class(char c)
+{
+    return CLASSES[(unsigned char) c];
+}
+
+size_t CharItr_skip_while(CharItr *self, unsigned class_mask)
+{
+    const char *start = self->cursor;
+    const char *cursor = start;
+    while (cursor < self->sentinel && (CLASSES[(unsigned char) *cursor] & class_mask)) {
+        ++cursor;
+    }
+    self->cursor = cursor;
+    return cursor - start;
+}
+
+CharSpan CharItr_take_until(CharItr *self, unsigned class_mask)
+{
+    const char *start = self->cursor;
+    const char *cursor = start;
+    while (cursor < self->sentinel && !(CLASSES[(unsigned char) *cursor] & class_mask)) {
+        ++cursor;
+    }
+    self->cursor = cursor;
+    CharSpan span = { start, cursor - start };
+    return span;
+}
+
+bool CharItr_find(CharItr *self, char byte)
+{
+    const char *found = memchr(self->cursor, byte, self->sentinel - self->cursor);
+    if (found == NULL) {
+        self->cursor = self->sentinel;
+        return false;
+    }
+    self->cursor = found;
+    return true;
+}
+
+void CharItr_advance(CharItr *self, size_t n)
+{
+    if (n > (size_t) (self->sentinel - self->cursor)) {
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
     }
+    self->cursor += n;
 }
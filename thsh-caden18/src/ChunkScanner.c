@@ -0,0 +1,194 @@
+#include <string.h>
+
+#include "ChunkScanner.h"
+#include "Guards.h"
+
+ChunkScanner ChunkScanner_value(FILE *input, size_t chunk_size)
+{
+    if (chunk_size == 0) {
+        chunk_size = 1;
+    }
+    /* Room to carry a partial operator over into the next chunk. */
+    size_t capacity = chunk_size + MAX_OPERATOR_LENGTH;
+    char *chunk = Allocator_alloc(&LIBC_ALLOCATOR, capacity);
+    ALLOC_GUARD(chunk, NULL, capacity, __FILE__, __LINE__);
+    ChunkScanner scanner = {
+        input,
+        chunk,
+        chunk_size,
+        CharItr_value(chunk, 0),
+        0,
+        TOKEN_SPACE_BEFORE | TOKEN_LINE_START,
+        Str_value(16)
+    };
+    return scanner;
+}
+
+void ChunkScanner_drop(ChunkScanner *self)
+{
+    Allocator_free(&LIBC_ALLOCATOR, self->chunk, self->chunk_size + MAX_OPERATOR_LENGTH);
+    self->chunk = NULL;
+    Str_drop(&self->stitch);
+}
+
+/* Offset within the stream of the cursor. */
+static uint64_t position(const ChunkScanner *self)
+{
+    return self->consumed + (CharItr_cursor(&self->char_itr) - self->chunk);
+}
+
+static size_t remaining(const ChunkScanner *self)
+{
+    return self->char_itr.sentinel - CharItr_cursor(&self->char_itr);
+}
+
+/*
+ * Make at least `wanted` chars available at the cursor, or as many as
+ * remain in the stream. Unread chars are carried to the front of the
+ * buffer and the next chunk is read in after them. Returns false when
+ * no chars remain at all.
+ */
+static bool refill(ChunkScanner *self, size_t wanted)
+{
+    size_t carried = remaining(self);
+    if (carried >= wanted) {
+        return true;
+    }
+    self->consumed = position(self);
+    memmove(self->chunk, CharItr_cursor(&self->char_itr), carried);
+    size_t length = carried;
+    while (length < wanted) {
+        size_t n = fread(self->chunk + length, 1, self->chunk_size, self->input);
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+    self->char_itr = CharItr_value(self->chunk, length);
+    return length > 0;
+}
+
+/* Append a run of a straddling token's bytes, growing geometrically. */
+static void stitch(ChunkScanner *self, CharSpan span)
+{
+    size_t length = Str_length(&self->stitch);
+    if (length + span.length + 1 > self->stitch.capacity) {
+        Vec_reserve(&self->stitch, (length + span.length + 1) * 2);
+    }
+    Str_splice(&self->stitch, length, 0, span.start, span.length);
+}
+
+/* Where a word being scanned stands within its command substitutions. */
+typedef struct WordScan {
+    size_t depth;    /* of parentheses open within a $(...) */
+    bool backquoted; /* within a `...` */
+} WordScan;
+
+/*
+ * Advance through the word at the cursor, and any command
+ * substitutions within it, by the rules of Scanner_lex. Returns true
+ * once the word ends before a char still in the chunk, or false when
+ * the chunk runs out first; a '$' whose next char is yet to be read is
+ * then left unread.
+ */
+static bool scan_word(ChunkScanner *self, WordScan *scan)
+{
+    CharItr *char_itr = &self->char_itr;
+    bool more = !feof(self->input) && !ferror(self->input);
+    while (CharItr_has_next(char_itr)) {
+        if (scan->backquoted) {
+            if (!CharItr_find(char_itr, '`')) {
+                return false;
+            }
+            CharItr_advance(char_itr, 1);
+            scan->backquoted = false;
+        } else if (scan->depth > 0) {
+            char c = CharItr_next(char_itr);
+            if (c == '(') {
+                ++scan->depth;
+            } else if (c == ')') {
+                --scan->depth;
+            }
+        } else {
+            CharItr_take_until(char_itr, CHAR_SPACE | CHAR_OPERATOR | CHAR_DOLLAR);
+            if (!CharItr_has_next(char_itr)) {
+                return false;
+            }
+            const char *cursor = CharItr_cursor(char_itr);
+            if (!(CharItr_class(*cursor) & CHAR_DOLLAR)) {
+                return true;
+            }
+            if (*cursor == '`') {
+                scan->backquoted = true;
+                CharItr_advance(char_itr, 1);
+            } else if (remaining(self) >= 2) {
+                scan->depth = cursor[1] == '(' ? 1 : 0;
+                CharItr_advance(char_itr, scan->depth > 0 ? 2 : 1);
+            } else if (more) {
+                return false;
+            } else {
+                CharItr_advance(char_itr, 1);
+            }
+        }
+    }
+    return false;
+}
+
+ChunkToken ChunkScanner_next(ChunkScanner *self)
+{
+    /* Whitespace runs may cross any number of chunks. */
+    while (refill(self, 1)) {
+        const char *start = CharItr_cursor(&self->char_itr);
+        size_t skipped = CharItr_skip_while(&self->char_itr, CHAR_SPACE);
+        if (skipped != 0) {
+            self->flags |= TOKEN_SPACE_BEFORE;
+            if (memchr(start, '\n', skipped) != NULL) {
+                self->flags |= TOKEN_LINE_START;
+            }
+        }
+        if (CharItr_has_next(&self->char_itr)) {
+            break;
+        }
+    }
+
+    ChunkToken token = { END_TOKEN, self->flags, position(self), { self->chunk, 0 } };
+    self->flags = 0;
+    if (!refill(self, MAX_OPERATOR_LENGTH)) {
+        return token;
+    }
+    token.offset = position(self);
+
+    size_t length;
+    const char *start = CharItr_cursor(&self->char_itr);
+    token.type = Scanner_operator(start, remaining(self), &length);
+    if (token.type != WORD_TOKEN) {
+        token.lexeme.start = start;
+        token.lexeme.length = length;
+        CharItr_advance(&self->char_itr, length);
+        return token;
+    }
+
+    WordScan scan = { 0, false };
+    bool ended = scan_word(self, &scan);
+    token.lexeme.start = start;
+    token.lexeme.length = CharItr_cursor(&self->char_itr) - start;
+    if (ended) {
+        return token;
+    }
+
+    /* The word reaches the end of the chunk and may continue in the next. */
+    Str_splice(&self->stitch, 0, Str_length(&self->stitch), NULL, 0);
+    stitch(self, token.lexeme);
+    while (refill(self, 2)) {
+        start = CharItr_cursor(&self->char_itr);
+        ended = scan_word(self, &scan);
+        CharSpan span = { start, CharItr_cursor(&self->char_itr) - start };
+        stitch(self, span);
+        if (ended) {
+            break;
+        }
+    }
+    token.lexeme.start = Str_cstr(&self->stitch);
+    token.lexeme.length = Str_length(&self->stitch);
+    return token;
+}
@@ -0,0 +1,279 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+
+#include "Env.h"
+#include "Guards.h"
+#include "Hash.h"
+
+extern char **environ;
+
+typedef struct EnvVar {
+    uint64_t hash; /* of the name */
+    Str name;
+    Str value;
+    bool set;      /* false once unset, when its slot is kept for reuse */
+    bool exported;
+} EnvVar;
+
+Env Env_value(void)
+{
+    Env env = {
+        Vec_value(16, sizeof(EnvVar)),
+        Vec_value(32, sizeof(size_t)),
+        0,
+        NULL,
+        PTHREAD_MUTEX_INITIALIZER
+    };
+    size_t free_slot = 0;
+    for (size_t i = 0; i < 32; ++i) {
+        Vec_set(&env.slots, i, &free_slot);
+    }
+    return env;
+}
+
+Env Env_from(char *const envp[])
+{
+    Env env = Env_value();
+    for (char *const *entry = envp; *entry != NULL; ++entry) {
+        const char *equals = strchr(*entry, '=');
+        if (equals == NULL || equals == *entry) {
+            continue;
+        }
+        char *name = strndup(*entry, equals - *entry);
+        OOM_GUARD(name, __FILE__, __LINE__);
+        Env_export(&env, name, equals + 1);
+        free(name);
+    }
+    return env;
+}
+
+void Env_drop(Env *self)
+{
+    for (size_t i = 0; i < Vec_length(&self->vars); ++i) {
+        EnvVar *var = Vec_ref(&self->vars, i);
+        Str_drop(&var->name);
+        Str_drop(&var->value);
+    }
+    Vec_drop(&self->vars);
+    Vec_drop(&self->slots);
+    if (self->block != NULL) {
+        EnvBlock_drop(self->block);
+    }
+    pthread_mutex_destroy(&self->lock);
+}
+
+/*
+ * The slot of the variable named by `length` chars at `name`, or of
+ * the free slot it would take. Slots are probed linearly, and never
+ * freed: an unset variable keeps its slot.
+ */
+static size_t* find(const Env *self, const char *name, size_t length, uint64_t hash)
+{
+    size_t mask = Vec_length(&self->slots) - 1;
+    size_t *slots = self->slots.buffer;
+    const EnvVar *vars = self->vars.buffer;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (slots[i] == 0) {
+            return &slots[i];
+        }
+        const EnvVar *var = &vars[slots[i] - 1];
+        if (var->hash == hash && Str_length(&var->name) == length
+                && memcmp(Str_cstr(&var->name), name, length) == 0) {
+            return &slots[i];
+        }
+    }
+}
+
+/* Doubles the slots, keeping them under half full. */
+static void grow(Env *self)
+{
+    size_t count = Vec_length(&self->slots) * 2;
+    Vec_drop(&self->slots);
+    self->slots = Vec_value(count, sizeof(size_t));
+    size_t free_slot = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Vec_set(&self->slots, i, &free_slot);
+    }
+    for (size_t i = 0; i < Vec_length(&self->vars); ++i) {
+        const EnvVar *var = Vec_ref(&self->vars, i);
+        *find(self, Str_cstr(&var->name), Str_length(&var->name), var->hash) = i + 1;
+    }
+}
+
+/* The variable `name`, created unset if there is none. */
+static EnvVar* lookup(Env *self, const char *name)
+{
+    size_t length = strlen(name);
+    uint64_t hash = Hash_bytes(name, length);
+    size_t *slot = find(self, name, length, hash);
+    size_t index = *slot;
+    if (index == 0) {
+        EnvVar var = { hash, Str_from(name), Str_value(16), false, false };
+        Vec_set(&self->vars, Vec_length(&self->vars), &var);
+        index = *slot = Vec_length(&self->vars);
+        if (2 * Vec_length(&self->vars) > Vec_length(&self->slots)) {
+            grow(self);
+        }
+    }
+    return Vec_ref(&self->vars, index - 1);
+}
+
+/* Sets `var` to `value`, returning whether it changed. */
+static bool assign(EnvVar *var, const char *value)
+{
+    size_t length = strlen(value);
+    if (var->set && Str_length(&var->value) == length
+            && memcmp(Str_cstr(&var->value), value, length) == 0) {
+        return false;
+    }
+    Str_splice(&var->value, 0, Str_length(&var->value), value, length);
+    var->set = true;
+    return true;
+}
+
+void Env_set(Env *self, const char *name, const char *value)
+{
+    pthread_mutex_lock(&self->lock);
+    EnvVar *var = lookup(self, name);
+    if (assign(var, value) && var->exported) {
+        ++self->generation;
+    }
+    pthread_mutex_unlock(&self->lock);
+}
+
+void Env_export(Env *self, const char *name, const char *value)
+{
+    pthread_mutex_lock(&self->lock);
+    EnvVar *var = lookup(self, name);
+    bool changed = !var->exported;
+    if (value != NULL || !var->set) {
+        changed = assign(var, value != NULL ? value : "") || changed;
+    }
+    var->exported = true;
+    if (changed) {
+        ++self->generation;
+    }
+    pthread_mutex_unlock(&self->lock);
+}
+
+void Env_unset(Env *self, const char *name)
+{
+    pthread_mutex_lock(&self->lock);
+    size_t length = strlen(name);
+    size_t *slot = find(self, name, length, Hash_bytes(name, length));
+    if (*slot != 0) {
+        EnvVar *var = Vec_ref(&self->vars, *slot - 1);
+        if (var->set && var->exported) {
+            ++self->generation;
+        }
+        var->set = false;
+        var->exported = false;
+        Str_splice(&var->value, 0, Str_length(&var->value), NULL, 0);
+    }
+    pthread_mutex_unlock(&self->lock);
+}
+
+bool Env_get(Env *self, const char *name, size_t length, Str *out)
+{
+    pthread_mutex_lock(&self->lock);
+    size_t *slot = find(self, name, length, Hash_bytes(name, length));
+    const EnvVar *var = *slot != 0 ? Vec_ref(&self->vars, *slot - 1) : NULL;
+    bool found = var != NULL && var->set;
+    if (found) {
+        Str_splice(out, Str_length(out), 0, Str_cstr(&var->value), Str_length(&var->value));
+    }
+    pthread_mutex_unlock(&self->lock);
+    return found;
+}
+
+uint64_t Env_generation(Env *self)
+{
+    pthread_mutex_lock(&self->lock);
+    uint64_t generation = self->generation;
+    pthread_mutex_unlock(&self->lock);
+    return generation;
+}
+
+/* The envp of the exported variables, with the Env's reference. */
+static EnvBlock* build(const Env *self)
+{
+    size_t size = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < Vec_length(&self->vars); ++i) {
+        const EnvVar *var = Vec_ref(&self->vars, i);
+        if (var->set && var->exported) {
+            size += Str_length(&var->name) + Str_length(&var->value) + 2;
+            ++count;
+        }
+    }
+    EnvBlock *block = malloc(sizeof(EnvBlock));
+    OOM_GUARD(block, __FILE__, __LINE__);
+    block->refs = 1;
+    block->generation = self->generation;
+    block->text = Str_value(size + 1);
+    block->envp = Vec_value(count + 1, sizeof(char*));
+    for (size_t i = 0; i < Vec_length(&self->vars); ++i) {
+        const EnvVar *var = Vec_ref(&self->vars, i);
+        if (var->set && var->exported) {
+            Str *text = &block->text;
+            Str_splice(text, Str_length(text), 0, Str_cstr(&var->name), Str_length(&var->name));
+            Str_splice(text, Str_length(text), 0, "=", 1);
+            /* Each entry keeps its null terminator. */
+            Str_splice(text, Str_length(text), 0, Str_cstr(&var->value),
+                    Str_length(&var->value) + 1);
+        }
+    }
+    /* Pointed into only once the text is whole, and will not move. */
+    char *entry = count > 0 ? Str_ref(&block->text, 0) : NULL;
+    for (size_t i = 0; i < count; ++i) {
+        Vec_set(&block->envp, i, &entry);
+        entry += strlen(entry) + 1;
+    }
+    char *terminator = NULL;
+    Vec_set(&block->envp, Vec_length(&block->envp), &terminator);
+    return block;
+}
+
+EnvBlock* Env_block(Env *self)
+{
+    pthread_mutex_lock(&self->lock);
+    if (self->block == NULL || self->block->generation != self->generation) {
+        if (self->block != NULL) {
+            EnvBlock_drop(self->block);
+        }
+        self->block = build(self);
+    }
+    EnvBlock *block = self->block;
+    __atomic_add_fetch(&block->refs, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&self->lock);
+    return block;
+}
+
+char* const* EnvBlock_envp(const EnvBlock *self)
+{
+    return self->envp.buffer;
+}
+
+void EnvBlock_drop(EnvBlock *self)
+{
+    if (__atomic_sub_fetch(&self->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        Str_drop(&self->text);
+        Vec_drop(&self->envp);
+        free(self);
+    }
+}
+
+static Env SHELL_ENV;
+static pthread_once_t SHELL_ENV_ONCE = PTHREAD_ONCE_INIT;
+
+static void init_shell_env(void)
+{
+    SHELL_ENV = Env_from(environ);
+}
+
+Env* Env_shell(void)
+{
+    pthread_once(&SHELL_ENV_ONCE, init_shell_env);
+    return &SHELL_ENV;
+}
@@ -0,0 +1,750 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Builtin.h"
+#include "Env.h"
+#include "Exec.h"
+#include "Profile.h"
+#include "Scanner.h"
+#include "Str.h"
+#include "Vec.h"
+
+/* Pipe capacity requested for capturing a command substitution. */
+#define CAPTURE_PIPE_SIZE (1 << 20)
+
+/* Free bytes made available for each read of a capture. */
+#define CAPTURE_CHUNK (64 << 10)
+
+/* Where commands are searched for when the shell has no PATH. */
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+static int run_list(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings);
+
+/* Collect the commands of a right-recursive pipe tree, in order. */
+static void flatten(const Node *node, Vec *commands)
+{
+    while (node->type == PIPE_NODE) {
+        Vec_set(commands, Vec_length(commands), &node->data.pipe.left);
+        node = node->data.pipe.right;
+    }
+    Vec_set(commands, Vec_length(commands), &node);
+}
+
+static int open_redirect(const Redirect *redirect)
+{
+    switch (redirect->type) {
+        case REDIRECT_IN:
+            return open(redirect->target, O_RDONLY | O_CLOEXEC);
+        case REDIRECT_OUT:
+        case REDIRECT_ERR:
+            return open(redirect->target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        case REDIRECT_APPEND:
+            return open(redirect->target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        case REDIRECT_ERR_TO_OUT:
+            break;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+static void close_all(Vec *fds)
+{
+    for (size_t i = 0; i < Vec_length(fds); ++i) {
+        close(*(int*) Vec_ref(fds, i));
+    }
+    Vec_splice(fds, 0, Vec_length(fds), NULL, 0);
+}
+
+/*
+ * Apply a command's redirections, in order, to `stdio`, which holds
+ * the descriptors to become its stdin, stdout and stderr. Files are
+ * opened here in the shell, close on exec, so that a bad path is
+ * reported before anything is spawned and the child has nothing left
+ * to do but dup2 them into place. Descriptors opened are appended to
+ * `opened`, to be closed once the command has started. Returns false,
+ * having reported the error, if a file cannot be opened.
+ */
+static bool apply_redirects(const CommandValue *command, int stdio[3], Vec *opened)
+{
+    const Redirect *redirects = Command_redirects(command);
+    for (size_t i = 0; i < Command_redirect_count(command); ++i) {
+        const Redirect *redirect = &redirects[i];
+        if (redirect->type == REDIRECT_ERR_TO_OUT) {
+            stdio[STDERR_FILENO] = stdio[STDOUT_FILENO];
+            continue;
+        }
+        int fd = open_redirect(redirect);
+        if (fd < 0) {
+            fprintf(stderr, "thsh: %s: %s\n", redirect->target, strerror(errno));
+            return false;
+        }
+        Vec_set(opened, Vec_length(opened), &fd);
+        stdio[redirect->type == REDIRECT_IN ? STDIN_FILENO
+                : redirect->type == REDIRECT_ERR ? STDERR_FILENO
+                : STDOUT_FILENO] = fd;
+    }
+    /*
+     * The child dup2s onto 0, 1 and 2 in order, so a source among them
+     * could be overwritten before it is read. Such sources are moved
+     * out of the way first.
+     */
+    for (int target = 0; target < 3; ++target) {
+        int source = stdio[target];
+        if (source < 3 && source != target) {
+            int fd = fcntl(source, F_DUPFD_CLOEXEC, 3);
+            if (fd < 0) {
+                perror("thsh: fcntl");
+                return false;
+            }
+            Vec_set(opened, Vec_length(opened), &fd);
+            stdio[target] = fd;
+        }
+    }
+    return true;
+}
+
+/*
+ * Sets `program` to the file that runs the command `name`: `name`
+ * itself if it holds a '/', else the first executable regular file
+ * called `name` in the ':' separated directories of `search`, where
+ * an empty one is the current directory. Returns false with errno set
+ * to ENOENT, or to EACCES if the only files found cannot be run.
+ */
+static bool resolve(const char *name, const Str *search, Str *program)
+{
+    size_t name_length = strlen(name);
+    Str_splice(program, 0, Str_length(program), name, name_length);
+    if (strchr(name, '/') != NULL) {
+        return true;
+    }
+    int error = ENOENT;
+    const char *dir = Str_cstr(search);
+    while (true) {
+        const char *end = strchr(dir, ':');
+        size_t length = end != NULL ? (size_t) (end - dir) : strlen(dir);
+        Str_splice(program, 0, Str_length(program), dir, length);
+        if (length > 0) {
+            Str_splice(program, length, 0, "/", 1);
+        }
+        Str_splice(program, Str_length(program), 0, name, name_length);
+        struct stat info;
+        if (stat(Str_cstr(program), &info) == 0 && S_ISREG(info.st_mode)) {
+            if (access(Str_cstr(program), X_OK) == 0) {
+                return true;
+            }
+            error = EACCES;
+        }
+        if (end == NULL) {
+            break;
+        }
+        dir = end + 1;
+    }
+    errno = error;
+    return false;
+}
+
+/*
+ * Spawn the file `program` as the command `argv` with `stdio` as its
+ * stdin, stdout and stderr, into process group `pgroup` unless it is
+ * negative; 0 starts a new group. Returns the child's pid, or -1 with
+ * errno set.
+ */
+static pid_t spawn(const char *program, char *const argv[], const int stdio[3], pid_t pgroup,
+        char *const envp[])
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (int target = 0; target < 3; ++target) {
+        if (stdio[target] != target) {
+            posix_spawn_file_actions_adddup2(&actions, stdio[target], target);
+        }
+    }
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    if (pgroup >= 0) {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, pgroup);
+    }
+
+    pid_t pid;
+    int error = posix_spawn(&pid, program, &actions, &attributes, argv, envp);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+/* A builtin running on its own thread as one stage of a pipeline. */
+typedef struct BuiltinJob {
+    Builtin run;
+    JobBuiltin run_job; /* run instead, on `jobs`, for a job builtin */
+    JobTable *jobs;
+    char *const *argv;
+    int in;       /* the job's own descriptors, closed when it finishes */
+    int out;
+    int err;
+    int status;
+    size_t stage; /* position in the pipeline */
+    pthread_t thread;
+} BuiltinJob;
+
+/* Job builtins of one pipeline take turns with the table they share. */
+static pthread_mutex_t job_builtin_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* run_builtin(void *arg)
+{
+    BuiltinJob *job = arg;
+    /*
+     * A write to a pipe whose reader has exited must fail with EPIPE
+     * rather than kill the shell. The signal stays pending on this
+     * thread and is discarded when it exits.
+     */
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+    if (job->run_job != NULL) {
+        pthread_mutex_lock(&job_builtin_lock);
+        job->status = job->run_job(job->jobs, job->argv, job->out, job->err);
+        pthread_mutex_unlock(&job_builtin_lock);
+    } else {
+        job->status = job->run(job->argv, job->in, job->out, job->err);
+    }
+    close(job->in);
+    close(job->out);
+    close(job->err);
+    return NULL;
+}
+
+/*
+ * Start a builtin pipeline stage on a thread. It gets duplicates of
+ * `stdio`, so that the caller may close its own descriptors at once.
+ */
+static bool start_builtin(BuiltinJob *job, const int stdio[3])
+{
+    job->in = fcntl(stdio[STDIN_FILENO], F_DUPFD_CLOEXEC, 0);
+    job->out = fcntl(stdio[STDOUT_FILENO], F_DUPFD_CLOEXEC, 0);
+    job->err = fcntl(stdio[STDERR_FILENO], F_DUPFD_CLOEXEC, 0);
+    if (job->in >= 0 && job->out >= 0 && job->err >= 0
+            && pthread_create(&job->thread, NULL, run_builtin, job) == 0) {
+        return true;
+    }
+    int fds[] = { job->in, job->out, job->err };
+    for (size_t i = 0; i < 3; ++i) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    return false;
+}
+
+/* A job's description: its commands' words, as `jobs` lists them. */
+static Str describe(const Vec *commands)
+{
+    Str text = Str_value(32);
+    for (size_t i = 0; i < Vec_length(commands); ++i) {
+        const CommandValue *command = &(*(Node**) Vec_ref(commands, i))->data.command;
+        if (i > 0) {
+            Str_append(&text, " | ");
+        }
+        for (size_t word = 0; word < Command_length(command); ++word) {
+            if (word > 0) {
+                Str_append(&text, " ");
+            }
+            Str_append(&text, Command_word(command, word));
+        }
+    }
+    return text;
+}
+
+/* A command substitution running on its own thread. */
+typedef struct CaptureJob {
+    const Node *tree;
+    int in;
+    int out;    /* the pipe's write end, closed when the tree finishes */
+    const Binding *bindings;
+    int status;
+} CaptureJob;
+
+static void* run_capture(void *arg)
+{
+    CaptureJob *job = arg;
+    job->status = run_list(job->tree, job->in, job->out, NULL, job->bindings);
+    close(job->out);
+    return NULL;
+}
+
+static int capture(const Node *node, int in_fd, const Binding *bindings, Str *out)
+{
+    int ends[2];
+    if (pipe2(ends, O_CLOEXEC) != 0) {
+        perror("thsh: pipe");
+        return EXIT_FAILURE;
+    }
+    /*
+     * A larger pipe lets a big output arrive in fewer, larger reads
+     * and writes. Failure, e.g. past the system's limit, is harmless.
+     */
+    fcntl(ends[0], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+
+    /* The tree runs on a thread while this one drains the pipe. */
+    CaptureJob job = { node, in_fd, ends[1], bindings, EXIT_FAILURE };
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_capture, &job) != 0) {
+        perror("thsh: pthread_create");
+        close(ends[0]);
+        close(ends[1]);
+        return EXIT_FAILURE;
+    }
+    size_t start = Str_length(out);
+    while (true) {
+        /* Capacity at least doubles, so reading n bytes costs O(n). */
+        if (out->capacity - out->length < CAPTURE_CHUNK) {
+            size_t wanted = out->length + CAPTURE_CHUNK;
+            Vec_reserve(out, wanted > out->capacity * 2 ? wanted : out->capacity * 2);
+        }
+        /* Read straight into the spare capacity, before the terminator. */
+        char *end = (char*) out->buffer + out->length - 1;
+        ssize_t n = read(ends[0], end, out->capacity - out->length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        out->length += n;
+        end[n] = '\0';
+    }
+    close(ends[0]);
+    pthread_join(thread, NULL);
+
+    size_t length = Str_length(out);
+    while (length > start && Str_get(out, length - 1) == '\n') {
+        --length;
+    }
+    Str_splice(out, length, Str_length(out) - length, NULL, 0);
+    return job.status;
+}
+
+int execute_capture(const Node *node, int in_fd, Str *out)
+{
+    return capture(node, in_fd, NULL, out);
+}
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+/* Append `length` chars to the current field, starting one if needed. */
+static void add_to_field(Str *text, Vec *fields, bool *open, const char *chars, size_t length)
+{
+    if (!*open) {
+        size_t offset = Str_length(text);
+        Vec_set(fields, Vec_length(fields), &offset);
+        *open = true;
+    }
+    Str_splice(text, Str_length(text), 0, chars, length);
+}
+
+static void end_field(Str *text, bool *open)
+{
+    if (*open) {
+        Str_splice(text, Str_length(text), 0, "", 1);
+        *open = false;
+    }
+}
+
+/*
+ * The value of the variable named by the `length` chars at `name`: its
+ * innermost binding, else its value in the shell's Env, copied into
+ * `scratch`, else "".
+ */
+static const char* lookup(const Binding *bindings, const char *name, size_t length,
+        Str *scratch)
+{
+    for (; bindings != NULL; bindings = bindings->outer) {
+        if (strncmp(bindings->name, name, length) == 0 && bindings->name[length] == '\0') {
+            return bindings->value;
+        }
+    }
+    Str_splice(scratch, 0, Str_length(scratch), NULL, 0);
+    Env_get(Env_shell(), name, length, scratch);
+    return Str_cstr(scratch);
+}
+
+/*
+ * As no quoting is possible, substituted text is split into fields at
+ * blanks, and a field left empty is dropped.
+ */
+int execute_expand(const CommandValue *command, int in_fd, const Binding *bindings,
+        Expansion *expansion)
+{
+    expansion->text = Str_value(64);
+    expansion->argv = Vec_value(Command_length(command) + 1, sizeof(char*));
+    Vec fields = Vec_value(Command_length(command), sizeof(size_t));
+    Str output = Str_value(0);
+    int status = EXIT_SUCCESS;
+    const Substitution *substitution = Command_substitutions(command);
+    const Substitution *last = substitution + Command_substitution_count(command);
+    for (size_t i = 0; i < Command_length(command); ++i) {
+        const char *word = Command_word(command, i);
+        bool open = false;
+        size_t done = 0;
+        for (; substitution < last && substitution->word == i; ++substitution) {
+            if (substitution->start > done) {
+                add_to_field(&expansion->text, &fields, &open, word + done,
+                        substitution->start - done);
+            }
+            done = substitution->start + substitution->length;
+            const char *cursor, *end;
+            if (substitution->tree != NULL) {
+                Str_splice(&output, 0, Str_length(&output), NULL, 0);
+                status = capture(substitution->tree, in_fd, bindings, &output);
+                cursor = Str_cstr(&output);
+                end = cursor + Str_length(&output);
+            } else {
+                size_t name, length;
+                const char *text = word + substitution->start;
+                Scanner_variable(text, substitution->length, &name, &length);
+                cursor = lookup(bindings, text + name, length, &output);
+                end = cursor + strlen(cursor);
+            }
+            while (cursor < end) {
+                const char *run = cursor;
+                while (cursor < end && !is_blank(*cursor)) {
+                    ++cursor;
+                }
+                if (cursor > run) {
+                    add_to_field(&expansion->text, &fields, &open, run, cursor - run);
+                }
+                if (cursor < end) {
+                    end_field(&expansion->text, &open);
+                    ++cursor;
+                }
+            }
+        }
+        if (word[done] != '\0') {
+            add_to_field(&expansion->text, &fields, &open, word + done, strlen(word + done));
+        }
+        end_field(&expansion->text, &open);
+    }
+    for (size_t i = 0; i < Vec_length(&fields); ++i) {
+        char *field = Str_ref(&expansion->text, *(size_t*) Vec_ref(&fields, i));
+        Vec_set(&expansion->argv, i, &field);
+    }
+    char *terminator = NULL;
+    Vec_set(&expansion->argv, Vec_length(&expansion->argv), &terminator);
+    Str_drop(&output);
+    Vec_drop(&fields);
+    return status;
+}
+
+void Expansion_drop(Expansion *self)
+{
+    Str_drop(&self->text);
+    Vec_drop(&self->argv);
+}
+
+static void drop_expansions(Vec *expansions)
+{
+    for (size_t i = 0; i < Vec_length(expansions); ++i) {
+        Expansion_drop(Vec_ref(expansions, i));
+    }
+    Vec_drop(expansions);
+}
+
+int exit_status(int wstatus)
+{
+    if (WIFEXITED(wstatus)) {
+        return WEXITSTATUS(wstatus);
+    }
+    if (WIFSIGNALED(wstatus)) {
+        return 128 + WTERMSIG(wstatus);
+    }
+    return EXIT_FAILURE;
+}
+
+int execute(const Node *node, int in_fd, int out_fd)
+{
+    return execute_with(node, in_fd, out_fd, NULL);
+}
+
+static bool is_list(const Node *node)
+{
+    return node->type == SEQUENCE_NODE || node->type == AND_NODE || node->type == OR_NODE;
+}
+
+static int run_loop(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings);
+
+int execute_with(const Node *node, int in_fd, int out_fd, JobTable *jobs)
+{
+    if (node->type == ERROR_NODE) {
+        fprintf(stderr, "thsh: %s\n", node->data.error);
+        return EXIT_SYNTAX_ERROR;
+    }
+    return run_list(node, in_fd, out_fd, jobs, NULL);
+}
+
+static int run_item(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings)
+{
+    if (node->type == FOR_NODE || node->type == WHILE_NODE) {
+        return run_loop(node, in_fd, out_fd, jobs, bindings);
+    }
+    return execute_pipeline(node, in_fd, out_fd, jobs, bindings);
+}
+
+static int run_list(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings)
+{
+    /*
+     * Walk a list's right spine in order. A pipeline after '&&' runs
+     * only when the status so far is 0 and one after '||' only when it
+     * is not; a skipped pipeline starts nothing and leaves the status
+     * as it was for the operators after it.
+     */
+    int status = EXIT_SUCCESS;
+    bool run = true;
+    while (is_list(node)) {
+        if (run) {
+            status = run_item(node->data.list.left, in_fd, out_fd, jobs, bindings);
+        }
+        run = node->type == SEQUENCE_NODE || (node->type == AND_NODE) == (status == EXIT_SUCCESS);
+        node = node->data.list.right;
+    }
+    return run ? run_item(node, in_fd, out_fd, jobs, bindings) : status;
+}
+
+/*
+ * Run a loop's body once for each of its words, or for as long as its
+ * condition succeeds. The body's tree is run as it is every time: only
+ * the binding of a for loop's variable changes between iterations.
+ * Returns the status of the last body run, or 0 if none ran.
+ */
+static int run_loop(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings)
+{
+    const LoopValue *loop = &node->data.loop;
+    int status = EXIT_SUCCESS;
+    if (node->type == WHILE_NODE) {
+        while (run_list(loop->head, in_fd, out_fd, jobs, bindings) == EXIT_SUCCESS) {
+            status = run_list(loop->body, in_fd, out_fd, jobs, bindings);
+        }
+        return status;
+    }
+
+    const CommandValue *words = &loop->head->data.command;
+    char *const *argv = Command_argv(words);
+    Expansion expansion;
+    bool expanded = Command_substitution_count(words) > 0;
+    if (expanded) {
+        execute_expand(words, in_fd, bindings, &expansion);
+        argv = expansion.argv.buffer;
+    }
+    /* The name is never expanded, so stays first. */
+    Binding binding = { argv[0], NULL, bindings };
+    for (char *const *word = argv + 1; *word != NULL; ++word) {
+        binding.value = *word;
+        status = run_list(loop->body, in_fd, out_fd, jobs, &binding);
+    }
+    if (expanded) {
+        Expansion_drop(&expansion);
+    }
+    return status;
+}
+
+int execute_pipeline(const Node *node, int in_fd, int out_fd, JobTable *jobs,
+        const Binding *bindings)
+{
+    bool background = false;
+    if (node->type == BACKGROUND_NODE) {
+        node = node->data.background.pipeline;
+        background = jobs != NULL;
+    }
+
+    PROFILE_START(timer);
+    Vec commands = Vec_value(2, sizeof(Node*));
+    flatten(node, &commands);
+    size_t count = Vec_length(&commands);
+
+    /*
+     * Pipe i connects command i to command i + 1. Pipes are close on
+     * exec so that no child, including children spawned concurrently
+     * by other threads, holds an end open by accident.
+     */
+    Vec fds = Vec_value(2 * count, sizeof(int));
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i + 1 < count; ++i) {
+        int ends[2];
+        if (pipe2(ends, O_CLOEXEC) != 0) {
+            perror("thsh: pipe");
+            status = EXIT_FAILURE;
+            count = 0;
+            break;
+        }
+        Vec_splice(&fds, Vec_length(&fds), 0, ends, 2);
+    }
+
+    Vec pids = Vec_value(count, sizeof(pid_t));
+    /* Sized for every stage up front: running threads point into it. */
+    Vec builtin_jobs = Vec_value(count, sizeof(BuiltinJob));
+    Vec opened = Vec_value(2, sizeof(int));
+    /* Expanded argvs, kept until builtin threads using them finish. */
+    Vec expansions = Vec_value(1, sizeof(Expansion));
+    /*
+     * The exported variables and the PATH, shared by every stage
+     * spawned, and the file each runs from.
+     */
+    EnvBlock *env = NULL;
+    Str search;
+    Str program;
+    pid_t last_pid = -1;
+    pid_t pgroup = background ? 0 : -1;
+    for (size_t i = 0; i < count; ++i) {
+        const Node *command = *(Node**) Vec_ref(&commands, i);
+        int stdio[3] = {
+            i == 0 ? in_fd : *(int*) Vec_ref(&fds, 2 * (i - 1)),
+            i + 1 == count ? out_fd : *(int*) Vec_ref(&fds, 2 * i + 1),
+            STDERR_FILENO
+        };
+        close_all(&opened);
+        char *const *argv = Command_argv(&command->data.command);
+        int substituted = EXIT_SUCCESS;
+        if (Command_substitution_count(&command->data.command) > 0) {
+            Expansion expansion;
+            substituted = execute_expand(&command->data.command, in_fd, bindings, &expansion);
+            Vec_set(&expansions, Vec_length(&expansions), &expansion);
+            argv = expansion.argv.buffer;
+        }
+        if (!apply_redirects(&command->data.command, stdio, &opened)) {
+            status = EXIT_FAILURE;
+            continue;
+        }
+        if (argv[0] == NULL) {
+            /* Substitutions that output nothing leave no command to run. */
+            status = substituted;
+            continue;
+        }
+
+        /*
+         * A background job is a group of processes that can be stopped
+         * and continued as one, so its builtins run as the external
+         * commands they stand in for. Job builtins stand in for none,
+         * and need the shell's table besides.
+         */
+        JobBuiltin job_builtin = jobs != NULL && !background
+                ? JobTable_find_builtin(argv) : NULL;
+        if (job_builtin != NULL && count == 1) {
+            status = job_builtin(jobs, argv, stdio[STDOUT_FILENO], stdio[STDERR_FILENO]);
+            continue;
+        }
+        Builtin builtin = background || job_builtin != NULL ? NULL : Builtin_find(argv);
+        if (builtin != NULL && count == 1) {
+            status = builtin(argv, stdio[STDIN_FILENO], stdio[STDOUT_FILENO],
+                    stdio[STDERR_FILENO]);
+            continue;
+        }
+        if (builtin != NULL || job_builtin != NULL) {
+            BuiltinJob job = {
+                builtin, job_builtin, jobs, argv, -1, -1, -1, EXIT_FAILURE, i
+            };
+            Vec_set(&builtin_jobs, Vec_length(&builtin_jobs), &job);
+            BuiltinJob *started = Vec_ref(&builtin_jobs, Vec_length(&builtin_jobs) - 1);
+            if (!start_builtin(started, stdio)) {
+                fprintf(stderr, "thsh: %s: %s\n", argv[0], strerror(errno));
+                Vec_splice(&builtin_jobs, Vec_length(&builtin_jobs) - 1, 1, NULL, 0);
+                status = EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (env == NULL) {
+            env = Env_block(Env_shell());
+            search = Str_value(64);
+            if (!Env_get(Env_shell(), "PATH", 4, &search)) {
+                Str_append(&search, DEFAULT_PATH);
+            }
+            program = Str_value(64);
+        }
+        pid_t pid = -1;
+        if (resolve(argv[0], &search, &program)) {
+            pid = spawn(Str_cstr(&program), argv, stdio, pgroup, EnvBlock_envp(env));
+        }
+        if (pid < 0) {
+            const char *name = argv[0];
+            if (errno == ENOENT) {
+                fprintf(stderr, "thsh: %s: command not found\n", name);
+                status = EXIT_NOT_FOUND;
+            } else {
+                fprintf(stderr, "thsh: %s: %s\n", name, strerror(errno));
+                status = EXIT_FAILURE;
+            }
+            continue;
+        }
+        Vec_set(&pids, Vec_length(&pids), &pid);
+        if (pgroup == 0) {
+            pgroup = pid;
+        }
+        if (i + 1 == count) {
+            last_pid = pid;
+        }
+    }
+    close_all(&opened);
+    close_all(&fds);
+    if (env != NULL) {
+        EnvBlock_drop(env);
+        Str_drop(&search);
+        Str_drop(&program);
+    }
+
+    if (background && Vec_length(&pids) > 0) {
+        Str text = describe(&commands);
+        JobTable_add(jobs, pids.buffer, Vec_length(&pids), Str_cstr(&text));
+        Str_drop(&text);
+        status = EXIT_SUCCESS;
+        Vec_splice(&pids, 0, Vec_length(&pids), NULL, 0);
+    }
+    for (size_t i = 0; i < Vec_length(&pids); ++i) {
+        pid_t pid = *(pid_t*) Vec_ref(&pids, i);
+        int wstatus;
+        while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR) {
+        }
+        if (pid == last_pid) {
+            status = exit_status(wstatus);
+        }
+    }
+    for (size_t i = 0; i < Vec_length(&builtin_jobs); ++i) {
+        BuiltinJob *job = Vec_ref(&builtin_jobs, i);
+        pthread_join(job->thread, NULL);
+        if (job->stage + 1 == count) {
+            status = job->status;
+        }
+    }
+
+    drop_expansions(&expansions);
+    Vec_drop(&opened);
+    Vec_drop(&builtin_jobs);
+    Vec_drop(&pids);
+    Vec_drop(&fds);
+    Vec_drop(&commands);
+    PROFILE_STOP(timer, PHASE_EXEC);
+    return status;
+}
@@ -1,10 +1,51 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-void OOM_GUARD(void *ptr, char *file, int number)
+#include "Guards.h"
+#include "MemStats.h"
+
+const char OUT_OF_MEMORY[] = "Out of Memory";
+const char OUT_OF_BOUNDS[] = "Out of Bounds";
+
+static _Thread_local Recovery *recovery = NULL;
+
+void Recovery_begin(Recovery *self)
+{
+    self->message = NULL;
+    self->file = NULL;
+    self->line = 0;
+    self->previous = recovery;
+    recovery = self;
+}
+
+void Recovery_end(Recovery *self)
+{
+    recovery = self->previous;
+}
+
+void PANIC(const char *message, const char *file, int number)
+{
+    if (recovery != NULL) {
+        recovery->message = message;
+        recovery->file = file;
+        recovery->line = number;
+        longjmp(recovery->env, 1);
+    }
+    fprintf(stderr, "%s:%d - %s", file, number, message);
+    exit(EXIT_FAILURE);
+}
+
+void OOM_GUARD(void *ptr, const char *file, int number)
 {
     if (ptr == NULL) {
-        fprintf(stderr, "%s:%d Out of Memory", file, number);
-        exit(EXIT_FAILURE);
+        PANIC(OUT_OF_MEMORY, file, number);
+    }
+}
+
+void ALLOC_GUARD(void *ptr, void *prev, size_t size, const char *file, int number)
+{
+    OOM_GUARD(ptr, file, number);
+    if (MemStats_enabled()) {
+        MemStats_alloc(ptr, prev, size, file, number);
     }
 }
@@ -0,0 +1,11 @@
+#include "Hash.h"
+
+uint64_t Hash_bytes(const char *bytes, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char) bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
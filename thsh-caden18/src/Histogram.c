@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "Histogram.h"
+
+#define SUB_HALF (1 << (HISTOGRAM_SUB_BITS - 1))
+
+static size_t bucket_of(uint64_t value)
+{
+    if (value < 2 * SUB_HALF) {
+        return value;
+    }
+    unsigned msb = 63 - __builtin_clzll(value);
+    unsigned shift = msb - (HISTOGRAM_SUB_BITS - 1);
+    return shift * SUB_HALF + (value >> shift);
+}
+
+static uint64_t bucket_upper_bound(size_t bucket)
+{
+    if (bucket < 2 * SUB_HALF) {
+        return bucket;
+    }
+    unsigned shift = bucket / SUB_HALF - 1;
+    uint64_t mantissa = bucket - shift * SUB_HALF;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void Histogram_reset(Histogram *self)
+{
+    memset(self, 0, sizeof(Histogram));
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void Histogram_record(Histogram *self, uint64_t value)
+{
+    __atomic_fetch_add(&self->buckets[bucket_of(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&self->count, 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&self->max, __ATOMIC_RELAXED);
+    while (value > max
+            && !__atomic_compare_exchange_n(
+                &self->max, &max, value, 1,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+uint64_t Histogram_count(const Histogram *self)
+{
+    return __atomic_load_n(&self->count, __ATOMIC_RELAXED);
+}
+
+uint64_t Histogram_max(const Histogram *self)
+{
+    return __atomic_load_n(&self->max, __ATOMIC_RELAXED);
+}
+
+uint64_t Histogram_percentile(const Histogram *self, double percentile)
+{
+    uint64_t count = Histogram_count(self);
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t) (percentile / 100.0 * count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += __atomic_load_n(&self->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= target) {
+            uint64_t bound = bucket_upper_bound(i);
+            uint64_t max = Histogram_max(self);
+            return bound < max ? bound : max;
+        }
+    }
+    return Histogram_max(self);
+}
@@ -0,0 +1,172 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Guards.h"
+#include "IoCopy.h"
+
+#define COPY_CHUNK (1 << 20)
+#define BUFFER_SIZE (128 << 10)
+
+typedef enum Strategy {
+    SPLICE,
+    COPY_FILE_RANGE,
+    SENDFILE,
+    READ_WRITE
+} Strategy;
+
+static bool is_pipe(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+static bool is_file(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static Strategy strategy_for(int in, int out)
+{
+    if (is_pipe(in) || is_pipe(out)) {
+        return SPLICE;
+    }
+    if (is_file(in)) {
+        return is_file(out) ? COPY_FILE_RANGE : SENDFILE;
+    }
+    return READ_WRITE;
+}
+
+/* True when a fast path failed in a way the next strategy may not. */
+static bool refused(int error)
+{
+    return error == EINVAL || error == ENOSYS || error == EXDEV
+        || error == EOPNOTSUPP || error == EBADF;
+}
+
+/* Move up to COPY_CHUNK bytes with `strategy`, as the syscall would. */
+static ssize_t transfer(Strategy strategy, int in, int out)
+{
+    switch (strategy) {
+        case SPLICE:
+            return splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE);
+        case COPY_FILE_RANGE:
+            return copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+        case SENDFILE:
+            return sendfile(out, in, NULL, COPY_CHUNK);
+        case READ_WRITE:
+            break;
+    }
+    return -1;
+}
+
+/* Write all `length` bytes of `buffer`. Returns false with errno set. */
+static bool write_all(int fd, const char *buffer, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = write(fd, buffer, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buffer += n;
+        length -= n;
+    }
+    return true;
+}
+
+/* Copy through a userspace buffer, also writing to `copy` unless -1. */
+static ssize_t read_write(int in, int out, int copy, ssize_t total)
+{
+    char *buffer = malloc(BUFFER_SIZE);
+    OOM_GUARD(buffer, __FILE__, __LINE__);
+    while (true) {
+        ssize_t n = read(in, buffer, BUFFER_SIZE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            free(buffer);
+            return n < 0 ? -1 : total;
+        }
+        if (!write_all(out, buffer, n) || (copy >= 0 && !write_all(copy, buffer, n))) {
+            free(buffer);
+            return -1;
+        }
+        total += n;
+    }
+}
+
+ssize_t IoCopy_copy(int in, int out)
+{
+    Strategy strategy = strategy_for(in, out);
+    ssize_t total = 0;
+    while (strategy != READ_WRITE) {
+        ssize_t n = transfer(strategy, in, out);
+        if (n > 0) {
+            total += n;
+        } else if (n == 0) {
+            return total;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (total == 0 && refused(errno)) {
+            strategy = strategy == COPY_FILE_RANGE ? SENDFILE : READ_WRITE;
+        } else {
+            return -1;
+        }
+    }
+    return read_write(in, out, -1, total);
+}
+
+/* Splice exactly `length` bytes from pipe `in` to `out`. */
+static bool splice_all(int in, int out, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = splice(in, NULL, out, NULL, length, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        length -= n;
+    }
+    return true;
+}
+
+ssize_t IoCopy_tee(int in, int out, int copy)
+{
+    ssize_t total = 0;
+    if (is_pipe(in) && is_pipe(out)) {
+        while (true) {
+            /* tee duplicates without consuming; splice then consumes. */
+            ssize_t n = tee(in, out, COPY_CHUNK, 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n == 0) {
+                return total;
+            }
+            if (n < 0) {
+                if (total == 0 && refused(errno)) {
+                    break;
+                }
+                return -1;
+            }
+            if (!splice_all(in, copy, n)) {
+                return -1;
+            }
+            total += n;
+        }
+    }
+    return read_write(in, out, copy, total);
+}
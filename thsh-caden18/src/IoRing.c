@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "IoRing.h"
+
+static IoRing unavailable(void)
+{
+    IoRing ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = -1;
+    return ring;
+}
+
+IoRing IoRing_value(unsigned entries)
+{
+#ifdef __NR_io_uring_setup
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return unavailable();
+    }
+
+    IoRing ring = unavailable();
+    ring.fd = fd;
+    ring.entries = params.sq_entries;
+    ring.sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map && ring.cq_map_size > ring.sq_map_size) {
+        ring.sq_map_size = ring.cq_map_size;
+    }
+    ring.sq_map = mmap(NULL, ring.sq_map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring.cq_map = single_map ? ring.sq_map : mmap(NULL, ring.cq_map_size,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqes = mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring.sq_map == MAP_FAILED || ring.cq_map == MAP_FAILED || ring.sqes == MAP_FAILED) {
+        if (ring.sq_map == MAP_FAILED) {
+            ring.sq_map = NULL;
+        }
+        if (ring.cq_map == MAP_FAILED) {
+            ring.cq_map = NULL;
+        }
+        if (ring.sqes == MAP_FAILED) {
+            ring.sqes = NULL;
+        }
+        IoRing_drop(&ring);
+        return unavailable();
+    }
+
+    char *sq = ring.sq_map;
+    ring.sq_head = (unsigned*) (sq + params.sq_off.head);
+    ring.sq_tail = (unsigned*) (sq + params.sq_off.tail);
+    ring.sq_mask = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned*) (sq + params.sq_off.array);
+    char *cq = ring.cq_map;
+    ring.cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring.cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring.cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return ring;
+#else
+    (void) entries;
+    return unavailable();
+#endif
+}
+
+void IoRing_drop(IoRing *self)
+{
+    if (self->sqes != NULL) {
+        munmap(self->sqes, self->sqes_size);
+    }
+    if (self->cq_map != NULL && self->cq_map != self->sq_map) {
+        munmap(self->cq_map, self->cq_map_size);
+    }
+    if (self->sq_map != NULL) {
+        munmap(self->sq_map, self->sq_map_size);
+    }
+    if (self->fd >= 0) {
+        close(self->fd);
+    }
+    *self = unavailable();
+}
+
+bool IoRing_ready(const IoRing *self)
+{
+    return self->fd >= 0;
+}
+
+bool IoRing_read(IoRing *self, int fd, void *buffer, unsigned length, uint64_t offset, uint64_t tag)
+{
+    /* Only this thread writes the tail; the kernel advances the head. */
+    unsigned tail = *self->sq_tail;
+    unsigned head = __atomic_load_n(self->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head == self->entries) {
+        return false;
+    }
+    unsigned index = tail & *self->sq_mask;
+    struct io_uring_sqe *sqe = &self->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buffer;
+    sqe->len = length;
+    sqe->off = offset;
+    sqe->user_data = tag;
+    self->sq_array[index] = index;
+    __atomic_store_n(self->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++self->queued;
+    return true;
+}
+
+int IoRing_enter(IoRing *self, unsigned wait)
+{
+    unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (true) {
+        ++self->enters;
+        int submitted = syscall(__NR_io_uring_enter, self->fd, self->queued, wait, flags, NULL, 0);
+        if (submitted >= 0) {
+            self->queued -= submitted;
+            return 0;
+        }
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+bool IoRing_complete(IoRing *self, uint64_t *tag, int32_t *result)
+{
+    /* Only this thread writes the head; the kernel advances the tail. */
+    unsigned head = *self->cq_head;
+    if (head == __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    struct io_uring_cqe *cqe = &self->cqes[head & *self->cq_mask];
+    *tag = cqe->user_data;
+    *result = cqe->res;
+    __atomic_store_n(self->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
@@ -0,0 +1,523 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Guards.h"
+#include "JobTable.h"
+
+#define EVENT_BATCH 64
+#define UNWATCHED_POLL_MS 10
+
+typedef struct JobProcess {
+    pid_t pid;   /* 0 once reaped */
+    int pidfd;   /* -1 when unwatched or reaped */
+    Job *job;
+} JobProcess;
+
+struct Job {
+    size_t id;
+    JobState state;
+    pid_t pgid;
+    size_t running; /* processes not yet reaped */
+    int status;     /* of the last process, once it has exited */
+    size_t finished; /* index + 1 within JobTable.finished, or 0 */
+    char *command;
+    size_t count;
+    JobProcess processes[];
+};
+
+JobTable JobTable_value(int terminal)
+{
+    JobTable table = {
+        epoll_create1(EPOLL_CLOEXEC),
+        terminal,
+        Vec_value(8, sizeof(Job*)),
+        Vec_value(8, sizeof(Job*)),
+        0,
+        0
+    };
+    if (table.epoll_fd < 0) {
+        perror("thsh: epoll_create1");
+    }
+    return table;
+}
+
+static Job* job_at(const JobTable *self, size_t index)
+{
+    return *(Job**) Vec_ref(&self->jobs, index);
+}
+
+static void free_job(Job *job)
+{
+    for (size_t i = 0; i < job->count; ++i) {
+        if (job->processes[i].pidfd >= 0) {
+            close(job->processes[i].pidfd);
+        }
+    }
+    Allocator_free(&LIBC_ALLOCATOR, job->command, strlen(job->command) + 1);
+    Allocator_free(&LIBC_ALLOCATOR, job, sizeof(Job) + job->count * sizeof(JobProcess));
+}
+
+void JobTable_drop(JobTable *self)
+{
+    for (size_t i = 0; i < Vec_length(&self->jobs); ++i) {
+        Job *job = job_at(self, i);
+        if (job != NULL) {
+            free_job(job);
+        }
+    }
+    Vec_drop(&self->jobs);
+    Vec_drop(&self->finished);
+    if (self->epoll_fd >= 0) {
+        close(self->epoll_fd);
+    }
+    self->epoll_fd = -1;
+    self->count = 0;
+    self->unwatched = 0;
+}
+
+int JobTable_fd(const JobTable *self)
+{
+    return self->epoll_fd;
+}
+
+size_t JobTable_count(const JobTable *self)
+{
+    return self->count;
+}
+
+/*
+ * The next job id: one past the newest job's. Ids below it are only
+ * reused once every job above them has been removed.
+ */
+static size_t next_id(JobTable *self)
+{
+    Job *none = NULL;
+    if (Vec_length(&self->jobs) == self->jobs.capacity) {
+        Vec_reserve(&self->jobs, self->jobs.capacity * 2);
+    }
+    Vec_set(&self->jobs, Vec_length(&self->jobs), &none);
+    return Vec_length(&self->jobs);
+}
+
+static void remove_job(JobTable *self, Job *job)
+{
+    Job *none = NULL;
+    Vec_set(&self->jobs, job->id - 1, &none);
+    size_t length = Vec_length(&self->jobs);
+    while (length > 0 && job_at(self, length - 1) == NULL) {
+        --length;
+    }
+    Vec_splice(&self->jobs, length, Vec_length(&self->jobs) - length, NULL, 0);
+    if (job->finished != 0) {
+        Vec_set(&self->finished, job->finished - 1, &none);
+    }
+    if (job->state != JOB_DONE) {
+        /* Its processes are no longer ours to reap. */
+        for (size_t i = 0; i < job->count; ++i) {
+            if (job->processes[i].pid != 0 && job->processes[i].pidfd < 0) {
+                --self->unwatched;
+            }
+        }
+    }
+    --self->count;
+    free_job(job);
+}
+
+static void watch(JobTable *self, JobProcess *process)
+{
+#ifdef SYS_pidfd_open
+    process->pidfd = syscall(SYS_pidfd_open, process->pid, 0);
+#else
+    process->pidfd = -1;
+#endif
+    if (process->pidfd >= 0) {
+        struct epoll_event event = { EPOLLIN, { .ptr = process } };
+        if (epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, process->pidfd, &event) == 0) {
+            return;
+        }
+        close(process->pidfd);
+        process->pidfd = -1;
+    }
+    ++self->unwatched;
+}
+
+size_t JobTable_add(JobTable *self, const pid_t pids[], size_t count, const char *command)
+{
+    size_t size = sizeof(Job) + count * sizeof(JobProcess);
+    Job *job = malloc(size);
+    ALLOC_GUARD(job, NULL, size, __FILE__, __LINE__);
+    job->id = next_id(self);
+    job->state = JOB_RUNNING;
+    job->pgid = pids[0];
+    job->running = count;
+    job->status = EXIT_SUCCESS;
+    job->finished = 0;
+    job->command = strdup(command);
+    ALLOC_GUARD(job->command, NULL, strlen(command) + 1, __FILE__, __LINE__);
+    job->count = count;
+    for (size_t i = 0; i < count; ++i) {
+        job->processes[i].pid = pids[i];
+        job->processes[i].job = job;
+        watch(self, &job->processes[i]);
+    }
+    Vec_set(&self->jobs, job->id - 1, &job);
+    ++self->count;
+    if (self->terminal >= 0) {
+        fprintf(stderr, "[%zu] %d\n", job->id, (int) job->pgid);
+    }
+    return job->id;
+}
+
+static void reaped(JobTable *self, JobProcess *process, int wstatus)
+{
+    Job *job = process->job;
+    if (process->pidfd >= 0) {
+        /*
+         * Closing the pidfd would not remove it from the epoll set while
+         * a child spawned meanwhile still holds a copy of it.
+         */
+        epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, process->pidfd, NULL);
+        close(process->pidfd);
+        process->pidfd = -1;
+    } else {
+        --self->unwatched;
+    }
+    process->pid = 0;
+    if (process == &job->processes[job->count - 1]) {
+        job->status = exit_status(wstatus);
+    }
+    if (--job->running == 0) {
+        job->state = JOB_DONE;
+        if (Vec_length(&self->finished) == self->finished.capacity) {
+            Vec_reserve(&self->finished, self->finished.capacity * 2);
+        }
+        Vec_set(&self->finished, Vec_length(&self->finished), &job);
+        job->finished = Vec_length(&self->finished);
+    }
+}
+
+/*
+ * Apply whatever state changes a job's live processes have had, as
+ * waitpid with `options` reports them.
+ */
+static void update(JobTable *self, Job *job, int options)
+{
+    for (size_t i = 0; i < job->count; ++i) {
+        JobProcess *process = &job->processes[i];
+        if (process->pid == 0) {
+            continue;
+        }
+        int wstatus;
+        pid_t pid;
+        while ((pid = waitpid(process->pid, &wstatus, options)) < 0 && errno == EINTR) {
+        }
+        if (pid <= 0) {
+            continue;
+        }
+        if (WIFSTOPPED(wstatus)) {
+            job->state = JOB_STOPPED;
+        } else if (WIFCONTINUED(wstatus)) {
+            job->state = JOB_RUNNING;
+        } else {
+            reaped(self, process, wstatus);
+        }
+    }
+}
+
+size_t JobTable_poll(JobTable *self, int timeout_ms)
+{
+    if (self->unwatched > 0 && (timeout_ms < 0 || timeout_ms > UNWATCHED_POLL_MS)) {
+        timeout_ms = UNWATCHED_POLL_MS;
+    }
+    struct epoll_event events[EVENT_BATCH];
+    int ready = epoll_wait(self->epoll_fd, events, EVENT_BATCH, timeout_ms);
+    size_t count = 0;
+    for (int i = 0; i < ready; ++i) {
+        /*
+         * A pidfd is readable once its process has begun to exit, which
+         * may be a moment before it can be reaped, so this wait blocks
+         * rather than leaving the event to spin.
+         */
+        JobProcess *process = events[i].data.ptr;
+        int wstatus;
+        pid_t pid;
+        while ((pid = waitpid(process->pid, &wstatus, 0)) < 0 && errno == EINTR) {
+        }
+        if (pid != process->pid) {
+            wstatus = 0; /* reaped elsewhere, its status lost */
+        }
+        reaped(self, process, wstatus);
+        ++count;
+    }
+    if (self->unwatched > 0) {
+        for (size_t i = 0; i < Vec_length(&self->jobs); ++i) {
+            Job *job = job_at(self, i);
+            if (job != NULL) {
+                size_t running = job->running;
+                update(self, job, WNOHANG);
+                count += running - job->running;
+            }
+        }
+    }
+    return count;
+}
+
+static const char* state_name(const Job *job)
+{
+    switch (job->state) {
+        case JOB_RUNNING:
+            return "Running";
+        case JOB_STOPPED:
+            return "Stopped";
+        case JOB_DONE:
+            break;
+    }
+    return "Done";
+}
+
+static void describe(const Job *job, int out)
+{
+    if (job->state == JOB_DONE && job->status != EXIT_SUCCESS) {
+        dprintf(out, "[%zu]  Exit %-6d%s\n", job->id, job->status, job->command);
+    } else {
+        dprintf(out, "[%zu]  %-11s%s\n", job->id, state_name(job), job->command);
+    }
+}
+
+/* Orders finished jobs by id, removed ones, which are NULL, last. */
+static int compare_ids(const void *a, const void *b)
+{
+    const Job *left = *(Job* const*) a;
+    const Job *right = *(Job* const*) b;
+    if (left == NULL || right == NULL) {
+        return (left == NULL) - (right == NULL);
+    }
+    return (left->id > right->id) - (left->id < right->id);
+}
+
+void JobTable_notify(JobTable *self, FILE *out)
+{
+    size_t count = Vec_length(&self->finished);
+    if (count == 0) {
+        return;
+    }
+    if (out != NULL) {
+        fflush(out);
+    }
+    /* Only the jobs that finished are visited, reported in job order. */
+    qsort(self->finished.buffer, count, sizeof(Job*), compare_ids);
+    for (size_t i = 0; i < count; ++i) {
+        Job *job = *(Job**) Vec_ref(&self->finished, i);
+        if (job == NULL) {
+            break;
+        }
+        if (out != NULL) {
+            describe(job, fileno(out));
+        }
+        job->finished = 0;
+        remove_job(self, job);
+    }
+    Vec_splice(&self->finished, 0, count, NULL, 0);
+}
+
+/* The most recently started job, or NULL. */
+static Job* current_job(const JobTable *self)
+{
+    size_t length = Vec_length(&self->jobs);
+    return length == 0 ? NULL : job_at(self, length - 1);
+}
+
+/*
+ * The job named by `spec`: "%N" for job N, or a process id. Reports
+ * an error on `err` when there is no such job.
+ */
+static Job* find_job(const JobTable *self, const char *name, const char *spec, int err)
+{
+    char *end;
+    unsigned long number = strtoul(spec[0] == '%' ? spec + 1 : spec, &end, 10);
+    if (*end == '\0' && end != spec) {
+        for (size_t i = 0; i < Vec_length(&self->jobs); ++i) {
+            Job *job = job_at(self, i);
+            if (job == NULL) {
+                continue;
+            }
+            if (spec[0] == '%' && job->id == number) {
+                return job;
+            }
+            for (size_t p = 0; spec[0] != '%' && p < job->count; ++p) {
+                if (job->processes[p].pid == (pid_t) number) {
+                    return job;
+                }
+            }
+        }
+    }
+    dprintf(err, "thsh: %s: %s: no such job\n", name, spec);
+    return NULL;
+}
+
+/* The job named by argv[1], or the current job if there is no argv[1]. */
+static Job* job_argument(const JobTable *self, char *const argv[], int err)
+{
+    if (argv[1] != NULL) {
+        return find_job(self, argv[0], argv[1], err);
+    }
+    Job *job = current_job(self);
+    if (job == NULL) {
+        dprintf(err, "thsh: %s: no current job\n", argv[0]);
+    }
+    return job;
+}
+
+/* `jobs` lists every job; `jobs -p` only their process group ids. */
+static int builtin_jobs(JobTable *self, char *const argv[], int out, int err)
+{
+    bool pids = argv[1] != NULL && strcmp(argv[1], "-p") == 0;
+    if (argv[1] != NULL && (!pids || argv[2] != NULL)) {
+        dprintf(err, "thsh: jobs: usage: jobs [-p]\n");
+        return EXIT_SYNTAX_ERROR;
+    }
+    if (pids) {
+        for (size_t i = 0; i < Vec_length(&self->jobs); ++i) {
+            Job *job = job_at(self, i);
+            if (job != NULL) {
+                dprintf(out, "%d\n", (int) job->pgid);
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+    for (size_t i = 0; i < Vec_length(&self->jobs); ++i) {
+        Job *job = job_at(self, i);
+        if (job == NULL) {
+            continue;
+        }
+        update(self, job, WNOHANG | WUNTRACED | WCONTINUED);
+        describe(job, out);
+        if (job->state == JOB_DONE) {
+            remove_job(self, job);
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/* Block until every process of `job` has exited. */
+static void wait_done(JobTable *self, Job *job)
+{
+    while (job->state != JOB_DONE) {
+        JobTable_poll(self, -1);
+    }
+}
+
+static int builtin_wait(JobTable *self, char *const argv[], int out, int err)
+{
+    (void) out;
+    if (argv[1] == NULL) {
+        for (size_t i = 0; i < Vec_length(&self->jobs); ++i) {
+            Job *job = job_at(self, i);
+            if (job != NULL) {
+                wait_done(self, job);
+                remove_job(self, job);
+            }
+        }
+        return EXIT_SUCCESS;
+    }
+    int status = EXIT_SUCCESS;
+    for (char *const *spec = argv + 1; *spec != NULL; ++spec) {
+        Job *job = find_job(self, argv[0], *spec, err);
+        if (job == NULL) {
+            status = EXIT_NOT_FOUND;
+            continue;
+        }
+        wait_done(self, job);
+        status = job->status;
+        remove_job(self, job);
+    }
+    return status;
+}
+
+/*
+ * Give the terminal to `pgid`. The shell may be in the background
+ * when it takes the terminal back, so SIGTTOU is held off meanwhile.
+ */
+static void give_terminal(const JobTable *self, pid_t pgid)
+{
+    if (self->terminal < 0) {
+        return;
+    }
+    sigset_t ttou, old;
+    sigemptyset(&ttou);
+    sigaddset(&ttou, SIGTTOU);
+    pthread_sigmask(SIG_BLOCK, &ttou, &old);
+    tcsetpgrp(self->terminal, pgid);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+static int builtin_fg(JobTable *self, char *const argv[], int out, int err)
+{
+    Job *job = job_argument(self, argv, err);
+    if (job == NULL) {
+        return EXIT_FAILURE;
+    }
+    dprintf(out, "%s\n", job->command);
+    give_terminal(self, job->pgid);
+    if (job->state == JOB_STOPPED) {
+        kill(-job->pgid, SIGCONT);
+        job->state = JOB_RUNNING;
+    }
+    /* Wait as a foreground pipeline does, returning early if it stops. */
+    while (job->state == JOB_RUNNING) {
+        update(self, job, WUNTRACED);
+    }
+    give_terminal(self, getpgrp());
+
+    if (job->state == JOB_STOPPED) {
+        dprintf(err, "\n[%zu]  Stopped    %s\n", job->id, job->command);
+        return 128 + SIGTSTP;
+    }
+    int status = job->status;
+    remove_job(self, job);
+    return status;
+}
+
+static int builtin_bg(JobTable *self, char *const argv[], int out, int err)
+{
+    Job *job = job_argument(self, argv, err);
+    if (job == NULL) {
+        return EXIT_FAILURE;
+    }
+    update(self, job, WNOHANG | WUNTRACED | WCONTINUED);
+    if (job->state == JOB_STOPPED) {
+        kill(-job->pgid, SIGCONT);
+        job->state = JOB_RUNNING;
+    }
+    dprintf(out, "[%zu] %s &\n", job->id, job->command);
+    return EXIT_SUCCESS;
+}
+
+JobBuiltin JobTable_find_builtin(char *const argv[])
+{
+    static const struct {
+        const char *name;
+        JobBuiltin run;
+    } BUILTINS[] = {
+        { "jobs", builtin_jobs },
+        { "wait", builtin_wait },
+        { "fg", builtin_fg },
+        { "bg", builtin_bg },
+    };
+    for (size_t i = 0; i < sizeof(BUILTINS) / sizeof(BUILTINS[0]); ++i) {
+        if (strcmp(argv[0], BUILTINS[i].name) == 0) {
+            return BUILTINS[i].run;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Guards.h"
+#include "LineReader.h"
+
+#define NO_END UINT64_MAX
+
+LineReader LineReader_value(int fd)
+{
+    LineReader reader;
+    memset(&reader, 0, sizeof(reader));
+    reader.fd = fd;
+    struct stat info;
+    off_t offset = -1;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        offset = lseek(fd, 0, SEEK_CUR);
+    }
+    reader.seekable = offset >= 0;
+    reader.next_offset = reader.consumed = reader.seekable ? offset : 0;
+    reader.end = NO_END;
+    if (reader.seekable) {
+        reader.ring = IoRing_value(LINE_READER_BLOCKS);
+    } else {
+        reader.ring.fd = -1;
+    }
+    char *data = malloc(LINE_READER_BLOCKS * LINE_READER_BLOCK_SIZE);
+    OOM_GUARD(data, __FILE__, __LINE__);
+    for (size_t i = 0; i < LINE_READER_BLOCKS; ++i) {
+        reader.blocks[i].data = data + i * LINE_READER_BLOCK_SIZE;
+    }
+    reader.carry = Str_value(16);
+    return reader;
+}
+
+/* The i-th block in reading order, starting from the head. */
+static ReadBlock* block_at(LineReader *self, size_t i)
+{
+    return &self->blocks[(self->head + i) % LINE_READER_BLOCKS];
+}
+
+static size_t in_flight(LineReader *self)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < LINE_READER_BLOCKS; ++i) {
+        count += self->blocks[i].state == BLOCK_IN_FLIGHT;
+    }
+    return count;
+}
+
+/*
+ * Queue reads of the blocks after the last one filled or in flight,
+ * up to the end of the file. They reach the kernel at the next
+ * IoRing_enter.
+ */
+static void read_ahead(LineReader *self)
+{
+    for (size_t i = 0; i < LINE_READER_BLOCKS && self->next_offset < self->end; ++i) {
+        ReadBlock *block = block_at(self, i);
+        if (block->state != BLOCK_EMPTY) {
+            continue;
+        }
+        uint64_t tag = block - self->blocks;
+        if (!IoRing_read(&self->ring, self->fd, block->data, LINE_READER_BLOCK_SIZE,
+                    self->next_offset, tag)) {
+            return;
+        }
+        block->state = BLOCK_IN_FLIGHT;
+        block->offset = self->next_offset;
+        self->next_offset += LINE_READER_BLOCK_SIZE;
+    }
+}
+
+/*
+ * Take every completion there is. A short read marks the end of the
+ * file. Returns false if any read failed, leaving its block empty.
+ */
+static bool collect(LineReader *self)
+{
+    bool succeeded = true;
+    uint64_t tag;
+    int32_t result;
+    while (IoRing_complete(&self->ring, &tag, &result)) {
+        ReadBlock *block = &self->blocks[tag];
+        if (result < 0) {
+            block->state = BLOCK_EMPTY;
+            succeeded = false;
+            continue;
+        }
+        block->state = BLOCK_FILLED;
+        block->length = result;
+        if (result < LINE_READER_BLOCK_SIZE && block->offset + result < self->end) {
+            self->end = block->offset + result;
+        }
+    }
+    return succeeded;
+}
+
+/* Wait until no read is in flight, so that buffers can be reused. */
+static void settle(LineReader *self)
+{
+    while (IoRing_ready(&self->ring)) {
+        collect(self);
+        if (in_flight(self) == 0 || IoRing_enter(&self->ring, 1) < 0) {
+            return;
+        }
+    }
+}
+
+/*
+ * Stop using the ring, as when the file system does not support
+ * io_uring reads. Blocks filled in order from the head are kept; the
+ * rest are read again with pread(2).
+ */
+static void fall_back(LineReader *self)
+{
+    settle(self);
+    self->syscalls += self->ring.enters;
+    IoRing_drop(&self->ring);
+    self->next_offset = self->consumed;
+    bool kept = true;
+    for (size_t i = 0; i < LINE_READER_BLOCKS; ++i) {
+        ReadBlock *block = block_at(self, i);
+        kept = kept && block->state == BLOCK_FILLED;
+        if (kept) {
+            self->next_offset = block->offset + block->length;
+        } else {
+            block->state = BLOCK_EMPTY;
+        }
+    }
+}
+
+/* Discard every block and read on from `offset`. */
+static void restart(LineReader *self, uint64_t offset)
+{
+    settle(self);
+    for (size_t i = 0; i < LINE_READER_BLOCKS; ++i) {
+        self->blocks[i].state = BLOCK_EMPTY;
+    }
+    self->position = 0;
+    self->next_offset = self->consumed = offset;
+    self->end = NO_END;
+}
+
+/* Read the head block with a blocking system call. */
+static bool read_block(LineReader *self, ReadBlock *block)
+{
+    ssize_t n;
+    do {
+        ++self->syscalls;
+        if (self->seekable) {
+            n = pread(self->fd, block->data, LINE_READER_BLOCK_SIZE, self->next_offset);
+        } else {
+            n = read(self->fd, block->data, LINE_READER_BLOCK_SIZE);
+        }
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return false;
+    }
+    block->state = BLOCK_FILLED;
+    block->length = n;
+    block->offset = self->next_offset;
+    self->next_offset += n;
+    if (n == 0 || (self->seekable && n < LINE_READER_BLOCK_SIZE)) {
+        self->end = self->next_offset;
+    }
+    return true;
+}
+
+/*
+ * Make the head block hold unread bytes, moving on from a block that
+ * has been read through. Returns false at the end of the input or on
+ * a read error.
+ */
+static bool fill(LineReader *self)
+{
+    ReadBlock *head = block_at(self, 0);
+    if (head->state == BLOCK_FILLED && self->position < head->length) {
+        return true;
+    }
+    if (head->state == BLOCK_FILLED && head->length > 0) {
+        head->state = BLOCK_EMPTY;
+        self->head = (self->head + 1) % LINE_READER_BLOCKS;
+        self->position = 0;
+        head = block_at(self, 0);
+    }
+    if (IoRing_ready(&self->ring)) {
+        read_ahead(self);
+        /* One system call both submits the queued reads and waits. */
+        while (head->state == BLOCK_IN_FLIGHT) {
+            if (!collect(self)) {
+                fall_back(self);
+            } else if (head->state == BLOCK_IN_FLIGHT && IoRing_enter(&self->ring, 1) < 0) {
+                fall_back(self);
+            }
+        }
+    }
+    if (head->state == BLOCK_EMPTY) {
+        if (self->next_offset >= self->end || !read_block(self, head)) {
+            return false;
+        }
+    }
+    return self->position < head->length;
+}
+
+static void carry(LineReader *self, const char *start, size_t length)
+{
+    size_t carried = Str_length(&self->carry);
+    if (carried + length + 1 > self->carry.capacity) {
+        Vec_reserve(&self->carry, (carried + length + 1) * 2);
+    }
+    Str_splice(&self->carry, carried, 0, start, length);
+}
+
+const char* LineReader_next(LineReader *self, size_t *length)
+{
+    if (self->synced) {
+        self->synced = false;
+        ++self->syscalls;
+        off_t offset = lseek(self->fd, 0, SEEK_CUR);
+        if (offset >= 0 && (uint64_t) offset != self->consumed) {
+            restart(self, offset);
+        }
+    }
+    if (Str_length(&self->carry) > 0) {
+        Str_splice(&self->carry, 0, Str_length(&self->carry), NULL, 0);
+    }
+    while (fill(self)) {
+        ReadBlock *head = block_at(self, 0);
+        const char *start = head->data + self->position;
+        size_t available = head->length - self->position;
+        const char *newline = memchr(start, '\n', available);
+        size_t taken = newline != NULL ? (size_t) (newline - start) + 1 : available;
+        self->position += taken;
+        self->consumed += taken;
+        if (newline != NULL && Str_length(&self->carry) == 0) {
+            *length = taken;
+            return start;
+        }
+        carry(self, start, taken);
+        if (newline != NULL) {
+            break;
+        }
+    }
+    if (Str_length(&self->carry) == 0) {
+        return NULL;
+    }
+    *length = Str_length(&self->carry);
+    return Str_cstr(&self->carry);
+}
+
+bool LineReader_buffered(const LineReader *self)
+{
+    if (self->seekable) {
+        /* Reading a regular file never waits for input. */
+        return true;
+    }
+    const ReadBlock *head = &self->blocks[self->head];
+    if (head->state != BLOCK_FILLED) {
+        return false;
+    }
+    size_t available = head->length - self->position;
+    return head->length == 0 || memchr(head->data + self->position, '\n', available) != NULL;
+}
+
+void LineReader_sync(LineReader *self)
+{
+    if (self->seekable) {
+        ++self->syscalls;
+        lseek(self->fd, self->consumed, SEEK_SET);
+        self->synced = true;
+    }
+}
+
+size_t LineReader_syscalls(const LineReader *self)
+{
+    return self->syscalls + self->ring.enters;
+}
+
+void LineReader_drop(LineReader *self)
+{
+    settle(self);
+    IoRing_drop(&self->ring);
+    free(self->blocks[0].data);
+    Str_drop(&self->carry);
+}
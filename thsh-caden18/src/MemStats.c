@@ -0,0 +1,277 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Guards.h"
+#include "MemStats.h"
+
+#define MAX_SITES 256
+
+/* A live block and the index of the callsite that owns it. */
+typedef struct Block {
+    const void *ptr;
+    size_t size;
+    size_t site;
+} Block;
+
+#define TOMBSTONE ((const void*) 1)
+
+static atomic_bool enabled = false;
+static atomic_flag lock = ATOMIC_FLAG_INIT;
+
+static MemSite sites[MAX_SITES];
+static size_t site_count = 0;
+static size_t total_live = 0;
+static size_t total_peak = 0;
+
+/* Open addressed table of live blocks, keyed by pointer. */
+static Block *blocks = NULL;
+static size_t block_capacity = 0;
+static size_t block_used = 0;  /* live entries plus tombstones */
+static size_t block_live = 0;
+
+static void acquire(void)
+{
+    while (atomic_flag_test_and_set_explicit(&lock, memory_order_acquire)) {
+    }
+}
+
+static void release(void)
+{
+    atomic_flag_clear_explicit(&lock, memory_order_release);
+}
+
+static size_t hash_ptr(const void *ptr)
+{
+    uintptr_t h = (uintptr_t) ptr;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t) h;
+}
+
+static Block* find_block(const void *ptr)
+{
+    if (block_capacity == 0) {
+        return NULL;
+    }
+    size_t mask = block_capacity - 1;
+    for (size_t i = hash_ptr(ptr) & mask; blocks[i].ptr != NULL; i = (i + 1) & mask) {
+        if (blocks[i].ptr == ptr) {
+            return &blocks[i];
+        }
+    }
+    return NULL;
+}
+
+static void insert_block(const void *ptr, size_t size, size_t site);
+
+static void grow_blocks(void)
+{
+    Block *old = blocks;
+    size_t old_capacity = block_capacity;
+    if (old_capacity == 0) {
+        block_capacity = 1024;
+    } else if (block_live * 2 >= old_capacity) {
+        block_capacity = old_capacity * 2;
+    }
+    blocks = calloc(block_capacity, sizeof(Block));
+    if (blocks == NULL) {
+        blocks = old;
+        block_capacity = old_capacity;
+        release();
+        PANIC(OUT_OF_MEMORY, __FILE__, __LINE__);
+    }
+    block_used = 0;
+    block_live = 0;
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old[i].ptr != NULL && old[i].ptr != TOMBSTONE) {
+            insert_block(old[i].ptr, old[i].size, old[i].site);
+        }
+    }
+    free(old);
+}
+
+static void insert_block(const void *ptr, size_t size, size_t site)
+{
+    if ((block_used + 1) * 4 >= block_capacity * 3) {
+        grow_blocks();
+    }
+    size_t mask = block_capacity - 1;
+    size_t i = hash_ptr(ptr) & mask;
+    while (blocks[i].ptr != NULL && blocks[i].ptr != TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (blocks[i].ptr == NULL) {
+        ++block_used;
+    }
+    ++block_live;
+    blocks[i].ptr = ptr;
+    blocks[i].size = size;
+    blocks[i].site = site;
+}
+
+static size_t find_site(const char *file, int line)
+{
+    for (size_t i = 0; i < site_count; ++i) {
+        if (sites[i].line == line
+                && (sites[i].file == file || strcmp(sites[i].file, file) == 0)) {
+            return i;
+        }
+    }
+    if (site_count == MAX_SITES) {
+        /* Fold any overflow into the final slot. */
+        return MAX_SITES - 1;
+    }
+    MemSite site = { file, line, 0, 0, 0, 0 };
+    sites[site_count] = site;
+    return site_count++;
+}
+
+static void credit(size_t site, size_t size)
+{
+    sites[site].live -= size;
+    total_live -= size;
+}
+
+static void debit(size_t site, size_t size)
+{
+    sites[site].live += size;
+    if (sites[site].live > sites[site].peak) {
+        sites[site].peak = sites[site].live;
+    }
+    total_live += size;
+    if (total_live > total_peak) {
+        total_peak = total_live;
+    }
+}
+
+void MemStats_enable(void)
+{
+    atomic_store_explicit(&enabled, true, memory_order_release);
+}
+
+void MemStats_disable(void)
+{
+    atomic_store_explicit(&enabled, false, memory_order_release);
+}
+
+bool MemStats_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_acquire);
+}
+
+void MemStats_alloc(const void *ptr, const void *prev, size_t size, const char *file, int line)
+{
+    if (!MemStats_enabled() || ptr == NULL) {
+        return;
+    }
+    acquire();
+    size_t site = find_site(file, line);
+    Block *old = prev == NULL ? NULL : find_block(prev);
+    if (prev != NULL) {
+        ++sites[site].reallocs;
+    } else {
+        ++sites[site].allocs;
+    }
+    if (old != NULL) {
+        /* The resized block stays attributed to its original callsite. */
+        site = old->site;
+        credit(site, old->size);
+        old->ptr = TOMBSTONE;
+        --block_live;
+    }
+    debit(site, size);
+    insert_block(ptr, size, site);
+    release();
+}
+
+void MemStats_free(const void *ptr)
+{
+    if (!MemStats_enabled() || ptr == NULL) {
+        return;
+    }
+    acquire();
+    Block *block = find_block(ptr);
+    if (block != NULL) {
+        credit(block->site, block->size);
+        block->ptr = TOMBSTONE;
+        --block_live;
+    }
+    release();
+}
+
+size_t MemStats_live(void)
+{
+    return total_live;
+}
+
+size_t MemStats_peak(void)
+{
+    return total_peak;
+}
+
+static int by_peak_desc(const void *a, const void *b)
+{
+    const MemSite *x = a;
+    const MemSite *y = b;
+    return (x->peak < y->peak) - (x->peak > y->peak);
+}
+
+size_t MemStats_sites(MemSite *out, size_t capacity)
+{
+    acquire();
+    MemSite sorted[MAX_SITES];
+    memcpy(sorted, sites, site_count * sizeof(MemSite));
+    size_t count = site_count;
+    release();
+    qsort(sorted, count, sizeof(MemSite), by_peak_desc);
+    if (count > capacity) {
+        count = capacity;
+    }
+    memcpy(out, sorted, count * sizeof(MemSite));
+    return count;
+}
+
+void MemStats_report(FILE *out)
+{
+    MemSite sorted[MAX_SITES];
+    size_t count = MemStats_sites(sorted, MAX_SITES);
+    fprintf(out, "=== MEMORY STATS ===\n");
+    fprintf(out, "live: %zu bytes, peak: %zu bytes\n", total_live, total_peak);
+    fprintf(out, "%-24s %10s %10s %12s %12s\n",
+            "callsite", "allocs", "reallocs", "live", "peak");
+    for (size_t i = 0; i < count; ++i) {
+        char where[256];
+        snprintf(where, sizeof(where), "%s:%d", sorted[i].file, sorted[i].line);
+        fprintf(out, "%-24s %10zu %10zu %12zu %12zu\n",
+                where, sorted[i].allocs, sorted[i].reallocs,
+                sorted[i].live, sorted[i].peak);
+    }
+}
+
+void MemStats_dump(FILE *out)
+{
+    MemSite sorted[MAX_SITES];
+    size_t count = MemStats_sites(sorted, MAX_SITES);
+    fprintf(out, "file\tline\tallocs\treallocs\tlive\tpeak\n");
+    for (size_t i = 0; i < count; ++i) {
+        fprintf(out, "%s\t%d\t%zu\t%zu\t%zu\t%zu\n",
+                sorted[i].file, sorted[i].line, sorted[i].allocs,
+                sorted[i].reallocs, sorted[i].live, sorted[i].peak);
+    }
+}
+
+void MemStats_reset(void)
+{
+    acquire();
+    site_count = 0;
+    total_live = 0;
+    total_peak = 0;
+    free(blocks);
+    blocks = NULL;
+    block_capacity = 0;
+    block_used = 0;
+    block_live = 0;
+    release();
+}
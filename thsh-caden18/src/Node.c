@@ -1,36 +1,315 @@
+#include <string.h>
+
 #include "Node.h"
 #include "Guards.h"
 
+_Static_assert(sizeof(Node) <= 64, "Node should fit in a cache line");
+
+static char** argv_of(CommandValue *self)
+{
+    if (self->length > COMMAND_INLINE_WORDS) {
+        return self->argv.heap_argv;
+    }
+    return self->argv.inline_argv;
+}
+
+static size_t argv_size_of(size_t count)
+{
+    return count > COMMAND_INLINE_WORDS ? (count + 1) * sizeof(char*) : 0;
+}
+
+/*
+ * The heap block holding a command's text, Redirects, Substitutions
+ * and, if long, argv.
+ */
+static char* command_block(const CommandValue *self)
+{
+    if (self->length > COMMAND_INLINE_WORDS) {
+        return (char*) self->argv.heap_argv;
+    }
+    /* The first word directly follows the arrays at the block's start. */
+    return self->argv.inline_argv[0] - self->redirect_count * sizeof(Redirect)
+            - self->substitution_count * sizeof(Substitution);
+}
+
+static Node* Node_alloc(NodeType type, const Allocator *allocator)
+{
+    Node *node = Allocator_alloc(allocator, sizeof(Node));
+    ALLOC_GUARD(node, NULL, sizeof(Node), __FILE__, __LINE__);
+    node->type = type;
+    node->allocator = allocator;
+    node->refs = 1;
+    return node;
+}
+
 Node* ErrorNode_new(const char *msg)
 {
-    Node *node = malloc(sizeof(Node));
-    OOM_GUARD(node, __FILE__, __LINE__);
-    node->type = ERROR_NODE;
+    return ErrorNode_new_with(msg, &LIBC_ALLOCATOR);
+}
+
+Node* CommandNode_new(
+        const CharSpan words[],
+        size_t count,
+        const RedirectSpan redirects[],
+        size_t redirect_count,
+        const Substitution substitutions[],
+        size_t substitution_count
+    )
+{
+    return CommandNode_new_with(words, count, redirects, redirect_count,
+            substitutions, substitution_count, &LIBC_ALLOCATOR);
+}
+
+Node* PipeNode_new(Node *left, Node *right)
+{
+    return PipeNode_new_with(left, right, &LIBC_ALLOCATOR);
+}
+
+Node* BackgroundNode_new(Node *pipeline)
+{
+    return BackgroundNode_new_with(pipeline, &LIBC_ALLOCATOR);
+}
+
+Node* ListNode_new(NodeType type, Node *left, Node *right)
+{
+    return ListNode_new_with(type, left, right, &LIBC_ALLOCATOR);
+}
+
+Node* LoopNode_new(NodeType type, Node *head, Node *body)
+{
+    return LoopNode_new_with(type, head, body, &LIBC_ALLOCATOR);
+}
+
+Node* ErrorNode_new_with(const char *msg, const Allocator *allocator)
+{
+    Node *node = Node_alloc(ERROR_NODE, allocator);
     node->data.error = msg;
     return node;
 }
 
-Node* CommandNode_new(StrVec words)
+Node* CommandNode_new_with(
+        const CharSpan words[],
+        size_t count,
+        const RedirectSpan redirects[],
+        size_t redirect_count,
+        const Substitution substitutions[],
+        size_t substitution_count,
+        const Allocator *allocator
+    )
 {
-    Node *node = malloc(sizeof(Node));
-    OOM_GUARD(node, __FILE__, __LINE__);
-    node->type = COMMAND_NODE;
-    node->data.command = words;
+    if (count == 0) {
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
+    }
+    /* Short commands keep argv inline; long ones put it first. */
+    size_t argv_size = argv_size_of(count);
+    size_t redirects_size = redirect_count * sizeof(Redirect);
+    size_t substitutions_size = substitution_count * sizeof(Substitution);
+    size_t block_size = argv_size + redirects_size + substitutions_size;
+    for (size_t i = 0; i < count; ++i) {
+        block_size += words[i].length + 1;
+    }
+    for (size_t i = 0; i < redirect_count; ++i) {
+        if (redirects[i].type != REDIRECT_ERR_TO_OUT) {
+            block_size += redirects[i].target.length + 1;
+        }
+    }
+    if (block_size > UINT32_MAX || redirect_count > UINT32_MAX
+            || substitution_count > UINT32_MAX) {
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
+    }
+    char *block = Allocator_alloc(allocator, block_size);
+    ALLOC_GUARD(block, NULL, block_size, __FILE__, __LINE__);
+
+    Node *node = Node_alloc(COMMAND_NODE, allocator);
+    CommandValue *command = &node->data.command;
+    command->length = count;
+    command->redirect_count = redirect_count;
+    command->substitution_count = substitution_count;
+    command->block_size = block_size;
+    if (argv_size != 0) {
+        command->argv.heap_argv = (char**) block;
+    }
+    char **argv = argv_of(command);
+    Redirect *list = (Redirect*) (block + argv_size);
+    if (substitution_count > 0) {
+        memcpy(block + argv_size + redirects_size, substitutions, substitutions_size);
+    }
+    char *text = block + argv_size + redirects_size + substitutions_size;
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(text, words[i].start, words[i].length);
+        text[words[i].length] = '\0';
+        argv[i] = text;
+        text += words[i].length + 1;
+    }
+    argv[count] = NULL;
+    for (size_t i = 0; i < redirect_count; ++i) {
+        list[i].type = redirects[i].type;
+        list[i].target = NULL;
+        if (redirects[i].type != REDIRECT_ERR_TO_OUT) {
+            memcpy(text, redirects[i].target.start, redirects[i].target.length);
+            text[redirects[i].target.length] = '\0';
+            list[i].target = text;
+            text += redirects[i].target.length + 1;
+        }
+    }
     return node;
 }
 
-Node* PipeNode_new(Node *left, Node *right)
+size_t Command_length(const CommandValue *self)
 {
-    Node *node = malloc(sizeof(Node));
-    OOM_GUARD(node, __FILE__, __LINE__);
-    node->type = PIPE_NODE;
+    return self->length;
+}
+
+const char* Command_word(const CommandValue *self, size_t index)
+{
+    if (index >= self->length) {
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
+    }
+    return Command_argv(self)[index];
+}
+
+char* const* Command_argv(const CommandValue *self)
+{
+    return argv_of((CommandValue*) self);
+}
+
+size_t Command_redirect_count(const CommandValue *self)
+{
+    return self->redirect_count;
+}
+
+const Redirect* Command_redirects(const CommandValue *self)
+{
+    return (const Redirect*) (command_block(self) + argv_size_of(self->length));
+}
+
+size_t Command_substitution_count(const CommandValue *self)
+{
+    return self->substitution_count;
+}
+
+const Substitution* Command_substitutions(const CommandValue *self)
+{
+    return (const Substitution*) ((const char*) Command_redirects(self)
+            + self->redirect_count * sizeof(Redirect));
+}
+
+Node* PipeNode_new_with(Node *left, Node *right, const Allocator *allocator)
+{
+    Node *node = Node_alloc(PIPE_NODE, allocator);
     node->data.pipe.left = left;
     node->data.pipe.right = right;
     return node;
 }
 
+Node* BackgroundNode_new_with(Node *pipeline, const Allocator *allocator)
+{
+    Node *node = Node_alloc(BACKGROUND_NODE, allocator);
+    node->data.background.pipeline = pipeline;
+    return node;
+}
+
+Node* ListNode_new_with(NodeType type, Node *left, Node *right, const Allocator *allocator)
+{
+    Node *node = Node_alloc(type, allocator);
+    node->data.list.left = left;
+    node->data.list.right = right;
+    return node;
+}
+
+Node* LoopNode_new_with(NodeType type, Node *head, Node *body, const Allocator *allocator)
+{
+    Node *node = Node_alloc(type, allocator);
+    node->data.loop.head = head;
+    node->data.loop.body = body;
+    return node;
+}
+
 void* Node_drop(Node *self)
 {
-    // TODO
+    /* Walk down the right spine iteratively so long pipelines and
+     * lists do not recurse once per stage. */
+    while (self != NULL) {
+        if (__atomic_sub_fetch(&self->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+            return NULL;
+        }
+        Node *next = NULL;
+        switch (self->type) {
+            case ERROR_NODE:
+                break;
+            case COMMAND_NODE:
+                for (size_t i = 0; i < self->data.command.substitution_count; ++i) {
+                    Node_drop(Command_substitutions(&self->data.command)[i].tree);
+                }
+                Allocator_free(self->allocator, command_block(&self->data.command),
+                        self->data.command.block_size);
+                break;
+            case PIPE_NODE:
+                Node_drop(self->data.pipe.left);
+                next = self->data.pipe.right;
+                break;
+            case SEQUENCE_NODE:
+            case AND_NODE:
+            case OR_NODE:
+                Node_drop(self->data.list.left);
+                next = self->data.list.right;
+                break;
+            case FOR_NODE:
+            case WHILE_NODE:
+                Node_drop(self->data.loop.head);
+                next = self->data.loop.body;
+                break;
+            case BACKGROUND_NODE:
+                next = self->data.background.pipeline;
+                break;
+        }
+        Allocator_free(self->allocator, self, sizeof(Node));
+        self = next;
+    }
     return NULL;
 }
+
+Node* Node_retain(Node *self)
+{
+    __atomic_add_fetch(&self->refs, 1, __ATOMIC_RELAXED);
+    return self;
+}
+
+size_t Node_footprint(const Node *self)
+{
+    size_t bytes = 0;
+    while (self != NULL) {
+        const Node *next = NULL;
+        bytes += sizeof(Node);
+        switch (self->type) {
+            case ERROR_NODE:
+                break;
+            case COMMAND_NODE:
+                bytes += self->data.command.block_size;
+                for (size_t i = 0; i < self->data.command.substitution_count; ++i) {
+                    bytes += Node_footprint(Command_substitutions(&self->data.command)[i].tree);
+                }
+                break;
+            case PIPE_NODE:
+                bytes += Node_footprint(self->data.pipe.left);
+                next = self->data.pipe.right;
+                break;
+            case SEQUENCE_NODE:
+            case AND_NODE:
+            case OR_NODE:
+                bytes += Node_footprint(self->data.list.left);
+                next = self->data.list.right;
+                break;
+            case FOR_NODE:
+            case WHILE_NODE:
+                bytes += Node_footprint(self->data.loop.head);
+                next = self->data.loop.body;
+                break;
+            case BACKGROUND_NODE:
+                next = self->data.background.pipeline;
+                break;
+        }
+        self = next;
+    }
+    return bytes;
+}
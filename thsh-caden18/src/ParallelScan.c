@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <string.h>
+
+#include "Guards.h"
+#include "ParallelScan.h"
+
+typedef struct Chunk {
+    size_t from;
+    size_t to;
+    TokenSpans spans;
+} Chunk;
+
+typedef struct ScanJob {
+    const char *input;
+    Vec chunks;       /* Chunk values in input order */
+    size_t next;      /* index of the next unclaimed chunk */
+} ScanJob;
+
+static void* scan_worker(void *arg)
+{
+    ScanJob *job = arg;
+    size_t count = Vec_length(&job->chunks);
+    while (true) {
+        size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= count) {
+            return NULL;
+        }
+        Chunk *chunk = Vec_ref(&job->chunks, i);
+        chunk->spans = TokenSpans_scan_range(job->input, chunk->from, chunk->to);
+    }
+}
+
+/* Cut input into chunks which each end just past a newline. */
+static Vec split_chunks(const char *input, size_t length, size_t chunk_size)
+{
+    Vec chunks = Vec_value(length / chunk_size + 1, sizeof(Chunk));
+    size_t from = 0;
+    while (from < length) {
+        size_t to = length;
+        if (length - from > chunk_size) {
+            const char *newline = memchr(input + from + chunk_size, '\n',
+                    length - from - chunk_size);
+            if (newline != NULL) {
+                to = newline - input + 1;
+            }
+        }
+        Chunk chunk = { from, to, { 0 } };
+        Vec_set(&chunks, Vec_length(&chunks), &chunk);
+        from = to;
+    }
+    return chunks;
+}
+
+/* The offset just past the last of `spans`, or 0 if there are none. */
+static size_t spans_end(const TokenSpans *spans)
+{
+    size_t count = Vec_length(spans);
+    if (count == 0) {
+        return 0;
+    }
+    const Token *last = Vec_ref(spans, count - 1);
+    return last->offset + last->length;
+}
+
+/*
+ * Lexes the input in sequence from `restart`, the end of the last
+ * token in `spans` or 0, appending tokens until one starts in a chunk
+ * from `next` on which the lexer entered between tokens. Returns the
+ * index of that chunk, whose own tokens follow from there, or the
+ * number of chunks if the input ends first.
+ */
+static size_t relex(TokenSpans *spans, const char *input, size_t length,
+        const Vec *chunks, size_t next, size_t restart)
+{
+    size_t count = Vec_length(chunks);
+    CharItr char_itr = CharItr_value(input + restart, length - restart);
+    size_t end = restart;
+    while (true) {
+        Token token = Scanner_lex(&char_itr, input);
+        if (token.type == END_TOKEN) {
+            return count;
+        }
+        while (next + 1 < count
+                && ((const Chunk*) Vec_ref(chunks, next + 1))->from <= token.offset) {
+            ++next;
+        }
+        size_t from = ((const Chunk*) Vec_ref(chunks, next))->from;
+        if (from <= token.offset && end <= from) {
+            return next;
+        }
+        TokenSpans_push(spans, token);
+        end = token.offset + token.length;
+    }
+}
+
+TokenSpans TokenSpans_scan_parallel(
+        const char *input,
+        size_t length,
+        size_t threads,
+        size_t chunk_size)
+{
+    if (chunk_size == 0) {
+        chunk_size = 1;
+    }
+    ScanJob job = { input, split_chunks(input, length, chunk_size), 0 };
+    size_t count = Vec_length(&job.chunks);
+    if (threads > count) {
+        threads = count;
+    }
+
+    /* The calling thread works too, so spawn one fewer. */
+    Vec workers = Vec_value(threads, sizeof(pthread_t));
+    for (size_t i = 1; i < threads; ++i) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, scan_worker, &job) != 0) {
+            break;
+        }
+        Vec_set(&workers, Vec_length(&workers), &worker);
+    }
+    scan_worker(&job);
+    for (size_t i = 0; i < Vec_length(&workers); ++i) {
+        pthread_join(*(pthread_t*) Vec_ref(&workers, i), NULL);
+    }
+    Vec_drop(&workers);
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += Vec_length(&((Chunk*) Vec_ref(&job.chunks, i))->spans);
+    }
+    TokenSpans spans = Vec_value(total + 1, sizeof(Token));
+    size_t i = 0;
+    while (i < count) {
+        Chunk *chunk = Vec_ref(&job.chunks, i);
+        Vec_splice(&spans, Vec_length(&spans), 0,
+                chunk->spans.buffer, Vec_length(&chunk->spans));
+        ++i;
+        /*
+         * Only a word with a substitution left open can hold a newline,
+         * so a chunk whose last token runs right up to its end was cut
+         * inside one, and the chunks after it may have been lexed from
+         * within the substitution. The input is lexed in sequence from
+         * before that token until the lexer is between tokens at the
+         * start of a chunk again.
+         */
+        if (i < count && Vec_length(&chunk->spans) > 0 && spans_end(&spans) == chunk->to) {
+            Vec_splice(&spans, Vec_length(&spans) - 1, 1, NULL, 0);
+            i = relex(&spans, input, length, &job.chunks, i, spans_end(&spans));
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        Vec_drop(&((Chunk*) Vec_ref(&job.chunks, i))->spans);
+    }
+    Vec_drop(&job.chunks);
+    return spans;
+}
@@ -0,0 +1,192 @@
+#include <string.h>
+
+#include "Guards.h"
+#include "Hash.h"
+#include "ParseCache.h"
+#include "Parser.h"
+
+#define INITIAL_BUCKETS 64
+
+struct CacheEntry {
+    uint64_t hash;
+    Str key;
+    Node *tree;
+    size_t bytes;
+    CacheEntry *chain; /* next entry in the same bucket */
+    CacheEntry *newer; /* LRU neighbours */
+    CacheEntry *older;
+};
+
+static CacheEntry** bucket_of(const ParseCache *self, uint64_t hash)
+{
+    size_t count = Vec_length(&self->buckets);
+    return Vec_ref(&self->buckets, hash & (count - 1));
+}
+
+static void set_buckets(Vec *buckets, size_t count)
+{
+    CacheEntry *empty = NULL;
+    for (size_t i = 0; i < count; ++i) {
+        Vec_set(buckets, i, &empty);
+    }
+}
+
+ParseCache ParseCache_value(size_t budget)
+{
+    ParseCache cache = {
+        Vec_value(INITIAL_BUCKETS, sizeof(CacheEntry*)),
+        NULL,
+        NULL,
+        0,
+        0,
+        budget,
+        0,
+        0,
+        0
+    };
+    set_buckets(&cache.buckets, INITIAL_BUCKETS);
+    return cache;
+}
+
+static void unlink_lru(ParseCache *self, CacheEntry *entry)
+{
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        self->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        self->oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void push_newest(ParseCache *self, CacheEntry *entry)
+{
+    entry->older = self->newest;
+    entry->newer = NULL;
+    if (self->newest != NULL) {
+        self->newest->newer = entry;
+    }
+    self->newest = entry;
+    if (self->oldest == NULL) {
+        self->oldest = entry;
+    }
+}
+
+static void entry_drop(CacheEntry *entry)
+{
+    Str_drop(&entry->key);
+    Node_drop(entry->tree);
+    Allocator_free(&LIBC_ALLOCATOR, entry, sizeof(CacheEntry));
+}
+
+static void evict_oldest(ParseCache *self)
+{
+    CacheEntry *victim = self->oldest;
+    unlink_lru(self, victim);
+    CacheEntry **link = bucket_of(self, victim->hash);
+    while (*link != victim) {
+        link = &(*link)->chain;
+    }
+    *link = victim->chain;
+    self->entries -= 1;
+    self->bytes -= victim->bytes;
+    self->evictions += 1;
+    entry_drop(victim);
+}
+
+static void grow_buckets(ParseCache *self)
+{
+    size_t count = Vec_length(&self->buckets) * 2;
+    Vec buckets = Vec_value(count, sizeof(CacheEntry*));
+    set_buckets(&buckets, count);
+    for (CacheEntry *e = self->newest; e != NULL; e = e->older) {
+        CacheEntry **head = Vec_ref(&buckets, e->hash & (count - 1));
+        e->chain = *head;
+        *head = e;
+    }
+    Vec_drop(&self->buckets);
+    self->buckets = buckets;
+}
+
+static Node* parse_line(const char *line, size_t length)
+{
+    CharItr char_itr = CharItr_value(line, length);
+    Scanner scanner = Scanner_value(char_itr);
+    Node *tree = parse(&scanner);
+    return tree;
+}
+
+Node* ParseCache_parse(ParseCache *self, const char *line, size_t length)
+{
+    uint64_t hash = Hash_bytes(line, length);
+    CacheEntry **head = bucket_of(self, hash);
+    for (CacheEntry *e = *head; e != NULL; e = e->chain) {
+        if (e->hash == hash
+                && Str_length(&e->key) == length
+                && memcmp(Str_cstr(&e->key), line, length) == 0) {
+            self->hits += 1;
+            unlink_lru(self, e);
+            push_newest(self, e);
+            return Node_retain(e->tree);
+        }
+    }
+
+    self->misses += 1;
+    Node *tree = parse_line(line, length);
+
+    CacheEntry *entry = Allocator_alloc(&LIBC_ALLOCATOR, sizeof(CacheEntry));
+    ALLOC_GUARD(entry, NULL, sizeof(CacheEntry), __FILE__, __LINE__);
+    entry->hash = hash;
+    entry->key = Str_value(length);
+    Str_splice(&entry->key, 0, 0, line, length);
+    entry->tree = Node_retain(tree);
+    entry->bytes = sizeof(CacheEntry) + entry->key.capacity + Node_footprint(tree);
+    if (entry->bytes > self->budget) {
+        /* Never worth caching; hand back the only reference. */
+        entry_drop(entry);
+        return tree;
+    }
+
+    entry->chain = *head;
+    *head = entry;
+    push_newest(self, entry);
+    self->entries += 1;
+    self->bytes += entry->bytes;
+
+    while (self->bytes > self->budget) {
+        evict_oldest(self);
+    }
+    if (self->entries > Vec_length(&self->buckets)) {
+        grow_buckets(self);
+    }
+    return tree;
+}
+
+void ParseCache_drop(ParseCache *self)
+{
+    CacheEntry *e = self->newest;
+    while (e != NULL) {
+        CacheEntry *older = e->older;
+        entry_drop(e);
+        e = older;
+    }
+    Vec_drop(&self->buckets);
+    self->newest = NULL;
+    self->oldest = NULL;
+    self->entries = 0;
+    self->bytes = 0;
+}
+
+void ParseCache_report(const ParseCache *self, FILE *out)
+{
+    fprintf(out, "=== PARSE CACHE ===\n");
+    fprintf(out, "hits: %zu, misses: %zu, evictions: %zu\n",
+            self->hits, self->misses, self->evictions);
+    fprintf(out, "entries: %zu, bytes: %zu of %zu\n",
+            self->entries, self->bytes, self->budget);
+}
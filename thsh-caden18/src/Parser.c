@@ -1,9 +1,779 @@
+#include <string.h>
+
 #include "Parser.h"
 #include "Node.h"
+#include "Profile.h"
+
+/*
+ * Grammar:
+ *
+ *   list      := and_or (separator and_or)* separator?
+ *   and_or    := pipeline (('&&' | '||') NEWLINE* pipeline)*
+ *   separator := ';' | NEWLINE | '&' (NEWLINE | end of input)
+ *   pipeline  := loop | command ('|' NEWLINE* pipeline)?
+ *   loop      := 'for' NAME 'in' WORD* (';' | NEWLINE) 'do' list 'done'
+ *              | 'while' list 'do' list 'done'
+ *   command   := (WORD | redirect)+, with at least one WORD
+ *   redirect  := ('<' | '>' | '>>' | '2>') WORD | '2>&1'
+ *
+ * NEWLINE is not a token but the TOKEN_LINE_START flag of the token
+ * after it. A '&' runs the pipeline before it in the background; an
+ * and_or of several pipelines cannot be, nor can a loop. The keywords
+ * 'for', 'while', 'do' and 'done' are WORDs recognised only where a
+ * command would begin; a list within a loop ends at the keyword after
+ * it. A WORD may contain variables, `$name` or `${name}`, and command
+ * substitutions, `$(list)` or `list` in backquotes, whose lists are
+ * parsed recursively.
+ */
+
+const char PARSE_EMPTY_INPUT[] = "Expected a command, found end of input";
+const char PARSE_INCOMPLETE[] = "Expected a command after |";
+const char PARSE_INCOMPLETE_LIST[] = "Expected a command after && or ||";
+static const char PARSE_TRAILING[] = "Expected the end of the line after &";
+static const char PARSE_BACKGROUND_LIST[] = "Expected a pipeline without && or || before &";
+const char PARSE_INCOMPLETE_LOOP[] = "Expected done to close a loop";
+static const char PARSE_KEYWORD[] = "Expected a command, found a keyword";
+static const char PARSE_LOOP_NAME[] = "Expected a variable name after for";
+static const char PARSE_LOOP_IN[] = "Expected in after the name of a for loop";
+static const char PARSE_LOOP_WORDS[] = "Expected ; or a new line after the words of a for loop";
+static const char PARSE_LOOP_DO[] = "Expected do after the head of a loop";
+static const char PARSE_AFTER_LOOP[] = "Expected ;, &&, || or a new line after done";
+static const char PARSE_OPEN_SUBSTITUTION[] = "Expected ) or ` to close a command substitution";
+static const char PARSE_EMPTY_SUBSTITUTION[] = "Expected a command in a command substitution";
+static const char PARSE_TARGET_SUBSTITUTION[] =
+    "Expected a file name without a command substitution or variable";
+
+/* Scratch space for the parts of the command being parsed. */
+typedef struct CommandParts {
+    Vec *words;         /* CharSpan */
+    Vec *redirects;     /* RedirectSpan */
+    Vec *substitutions; /* Substitution */
+} CommandParts;
+
+/* A pipeline of a list and the operator joining it to the rest. */
+typedef struct ListItem {
+    Node *pipeline;
+    NodeType join; /* SEQUENCE_NODE, AND_NODE or OR_NODE */
+} ListItem;
+
+static Node* parse_list(Scanner *scanner);
+static Node* continue_list(Scanner *scanner, Vec *items, Vec *commands, CommandParts parts,
+        const char *terminator);
+static Node* continue_pipeline(Scanner *scanner, Vec *commands, CommandParts parts);
+static Node* parse_loop(Scanner *scanner, CommandParts parts);
+static Node* parse_command(Scanner *scanner, CommandParts parts);
+static Node* gather(Scanner *scanner, CommandParts parts);
+static void drop_items(Vec *items);
+static void drop_commands(Vec *commands);
+static void drop_substitutions(Vec *substitutions);
+static void grow(Vec *vec);
 
 Node* parse(Scanner *scanner)
 {
-    const char *error = "Error!";
-    Node *node = ErrorNode_new(error);
+    PROFILE_START(timer);
+    Node *node = parse_list(scanner);
+    PROFILE_STOP(timer, PHASE_PARSE);
     return node;
 }
+
+static bool starts_line(Token token)
+{
+    return (token.flags & TOKEN_LINE_START) != 0;
+}
+
+static bool spells(Token token, const char *source, const char *keyword)
+{
+    size_t length = strlen(keyword);
+    return token.type == WORD_TOKEN && token.length == length
+            && memcmp(Token_lexeme(token, source), keyword, length) == 0;
+}
+
+static bool is_keyword(const Scanner *scanner, Token token, const char *keyword)
+{
+    return spells(token, scanner->source, keyword);
+}
+
+static bool is_loop_start(const Scanner *scanner, Token token)
+{
+    return is_keyword(scanner, token, "for") || is_keyword(scanner, token, "while");
+}
+
+static Node* parse_list(Scanner *scanner)
+{
+    Vec items = Vec_value_with(1, sizeof(ListItem), scanner->allocator);
+    Vec commands = Vec_value_with(2, sizeof(Node*), scanner->allocator);
+    Vec words = Vec_value_with(4, sizeof(CharSpan), scanner->allocator);
+    Vec redirects = Vec_value_with(1, sizeof(RedirectSpan), scanner->allocator);
+    Vec substitutions = Vec_value_with(1, sizeof(Substitution), scanner->allocator);
+    CommandParts parts = { &words, &redirects, &substitutions };
+    Node *tree = continue_list(scanner, &items, &commands, parts, NULL);
+    if (tree == NULL) {
+        const char *error = Scanner_has_next(scanner) ? PARSE_INCOMPLETE_LOOP
+                : Vec_length(&commands) > 0 ? PARSE_INCOMPLETE : PARSE_INCOMPLETE_LIST;
+        drop_commands(&commands);
+        drop_items(&items);
+        tree = ErrorNode_new_with(error, scanner->allocator);
+    }
+    Vec_drop(&substitutions);
+    Vec_drop(&redirects);
+    Vec_drop(&words);
+    Vec_drop(&commands);
+    Vec_drop(&items);
+    return tree;
+}
+
+/* Whether the last item of `items` is joined to the next by && or ||. */
+static bool chained(const Vec *items)
+{
+    size_t count = Vec_length(items);
+    return count > 0 && ((const ListItem*) Vec_ref(items, count - 1))->join != SEQUENCE_NODE;
+}
+
+/*
+ * Lists are parsed like pipelines: their pipelines are collected left
+ * to right onto `items` and then folded into a right-leaning tree, so
+ * that a chain of thousands of '&&' costs no stack. `items` may hold
+ * the pipelines of a list begun by earlier input. Returns NULL,
+ * keeping `items` and `commands`, when the tokens run out right after
+ * a '|', '&&' or '||', or within a loop; the Scanner is then left at
+ * the start of the unfinished loop, if any. Otherwise both are left
+ * empty.
+ *
+ * The list of a loop ends before the `terminator` keyword, and must
+ * have one: running out of tokens first returns NULL.
+ */
+static Node* continue_list(Scanner *scanner, Vec *items, Vec *commands, CommandParts parts,
+        const char *terminator)
+{
+    while (true) {
+        if (!Scanner_has_next(scanner) && (Vec_length(items) > 0 || terminator != NULL)) {
+            return NULL;
+        }
+        Token start = Scanner_peek(scanner);
+        if (terminator != NULL && is_keyword(scanner, start, terminator)
+                && Vec_length(items) > 0 && !chained(items)) {
+            break;
+        }
+        Node *pipeline;
+        if (Vec_length(commands) == 0 && is_loop_start(scanner, start)) {
+            ScannerMark mark = Scanner_mark(scanner);
+            pipeline = parse_loop(scanner, parts);
+            if (pipeline == NULL) {
+                if (terminator == NULL) {
+                    Scanner_reset(scanner, mark);
+                }
+                return NULL;
+            }
+            Token after = Scanner_peek(scanner);
+            if (pipeline->type != ERROR_NODE && after.type != END_TOKEN && !starts_line(after)
+                    && after.type != SEMI_TOKEN && after.type != AND_IF_TOKEN
+                    && after.type != OR_IF_TOKEN) {
+                Node_drop(pipeline);
+                pipeline = ErrorNode_new_with(PARSE_AFTER_LOOP, scanner->allocator);
+            }
+        } else {
+            pipeline = continue_pipeline(scanner, commands, parts);
+            if (pipeline == NULL) {
+                return NULL;
+            }
+        }
+        if (pipeline->type == ERROR_NODE) {
+            drop_items(items);
+            return pipeline;
+        }
+        ListItem item = { pipeline, SEQUENCE_NODE };
+        Token token = Scanner_peek(scanner);
+        if (token.type != END_TOKEN && !starts_line(token)) {
+            /* One of ';', '&', '&&' or '||', which end a command. */
+            Scanner_next(scanner);
+            if (token.type == AND_IF_TOKEN) {
+                item.join = AND_NODE;
+            } else if (token.type == OR_IF_TOKEN) {
+                item.join = OR_NODE;
+            } else if (token.type == AMP_TOKEN) {
+                const char *error = NULL;
+                Token after = Scanner_peek(scanner);
+                if (chained(items)) {
+                    /* Backgrounding a whole && or || chain needs a subshell. */
+                    error = PARSE_BACKGROUND_LIST;
+                } else if (after.type != END_TOKEN && !starts_line(after)
+                        && !(terminator != NULL && is_keyword(scanner, after, terminator))) {
+                    error = PARSE_TRAILING;
+                }
+                if (error != NULL) {
+                    Node_drop(pipeline);
+                    drop_items(items);
+                    return ErrorNode_new_with(error, scanner->allocator);
+                }
+                item.pipeline = BackgroundNode_new_with(pipeline, scanner->allocator);
+            }
+        }
+        grow(items);
+        Vec_set(items, Vec_length(items), &item);
+        if (!Scanner_has_next(scanner)) {
+            if (item.join != SEQUENCE_NODE || terminator != NULL) {
+                return NULL;
+            }
+            break;
+        }
+    }
+
+    size_t count = Vec_length(items);
+    Node *tree = ((ListItem*) Vec_ref(items, count - 1))->pipeline;
+    for (size_t i = count - 1; i > 0; --i) {
+        ListItem *item = Vec_ref(items, i - 1);
+        tree = ListNode_new_with(item->join, item->pipeline, tree, scanner->allocator);
+    }
+    Vec_splice(items, 0, count, NULL, 0);
+    return tree;
+}
+
+static void drop_items(Vec *items)
+{
+    for (size_t i = 0; i < Vec_length(items); ++i) {
+        Node_drop(((ListItem*) Vec_ref(items, i))->pipeline);
+    }
+    Vec_splice(items, 0, Vec_length(items), NULL, 0);
+}
+
+/*
+ * Pipelines are parsed iteratively, collecting commands left to
+ * right onto `commands` and then folding them into a right-recursive
+ * tree, so that stack use does not grow with the length of the
+ * pipeline. `commands` may hold the commands of a pipeline begun by
+ * earlier input. Returns NULL, keeping `commands`, when the tokens
+ * run out right after a '|'. Otherwise `commands` is left empty.
+ */
+static Node* continue_pipeline(Scanner *scanner, Vec *commands, CommandParts parts)
+{
+    while (true) {
+        if (!Scanner_has_next(scanner) && Vec_length(commands) > 0) {
+            return NULL;
+        }
+        Node *command = parse_command(scanner, parts);
+        if (command->type == ERROR_NODE) {
+            drop_commands(commands);
+            return command;
+        }
+        grow(commands);
+        Vec_set(commands, Vec_length(commands), &command);
+        Token token = Scanner_peek(scanner);
+        if (token.type != PIPE_TOKEN || starts_line(token)) {
+            break;
+        }
+        Scanner_next(scanner);
+    }
+
+    size_t count = Vec_length(commands);
+    Node *tree = *(Node**) Vec_ref(commands, count - 1);
+    for (size_t i = count - 1; i > 0; --i) {
+        Node *left = *(Node**) Vec_ref(commands, i - 1);
+        tree = PipeNode_new_with(left, tree, scanner->allocator);
+    }
+    Vec_splice(commands, 0, count, NULL, 0);
+    return tree;
+}
+
+static void drop_commands(Vec *commands)
+{
+    for (size_t i = 0; i < Vec_length(commands); ++i) {
+        Node_drop(*(Node**) Vec_ref(commands, i));
+    }
+    Vec_splice(commands, 0, Vec_length(commands), NULL, 0);
+}
+
+bool parse_incomplete(const Node *tree)
+{
+    return tree->type == ERROR_NODE && (tree->data.error == PARSE_INCOMPLETE
+            || tree->data.error == PARSE_INCOMPLETE_LIST
+            || tree->data.error == PARSE_INCOMPLETE_LOOP);
+}
+
+/*
+ * What the next token of an unfinished loop's text may be, as far as
+ * counting its loops goes: only a 'for' or 'while' where a pipeline
+ * begins opens a loop, and only a 'done' there closes one.
+ */
+typedef enum LoopState {
+    LOOP_PIPELINE = 0, /* the first word of a pipeline */
+    LOOP_COMMAND = 1,  /* the first word of a command after '|' */
+    LOOP_WORD = 2,     /* any other word of a command */
+    LOOP_NAME = 3,     /* the variable name after 'for' */
+    LOOP_IN = 4,       /* the 'in' after it */
+    LOOP_WORDS = 5     /* the words of a for loop */
+} LoopState;
+
+PushParser PushParser_value(void)
+{
+    PushParser parser = {
+        Vec_value(1, sizeof(ListItem)),
+        Vec_value(2, sizeof(Node*)),
+        Vec_value(4, sizeof(CharSpan)),
+        Vec_value(1, sizeof(RedirectSpan)),
+        Vec_value(1, sizeof(Substitution)),
+        Str_value(0),
+        0,
+        0,
+        LOOP_PIPELINE
+    };
+    return parser;
+}
+
+void PushParser_drop(PushParser *self)
+{
+    drop_items(&self->items);
+    drop_commands(&self->commands);
+    Vec_drop(&self->items);
+    Vec_drop(&self->commands);
+    Vec_drop(&self->words);
+    Vec_drop(&self->redirects);
+    Vec_drop(&self->substitutions);
+    Str_drop(&self->loop);
+}
+
+bool PushParser_pending(const PushParser *self)
+{
+    return Vec_length(&self->commands) > 0 || Vec_length(&self->items) > 0
+            || Str_length(&self->loop) > 0;
+}
+
+/* Whether `word` ends in a command substitution left open. */
+static bool open_substitution(const char *word, size_t length)
+{
+    CharItr char_itr = CharItr_value(word, length);
+    while (true) {
+        CharItr_take_until(&char_itr, CHAR_DOLLAR);
+        if (!CharItr_has_next(&char_itr)) {
+            return false;
+        }
+        const char *start = CharItr_cursor(&char_itr);
+        bool closed;
+        size_t substitution = Scanner_substitution(start, char_itr.sentinel - start, &closed);
+        if (substitution > 0 && !closed) {
+            return true;
+        }
+        CharItr_advance(&char_itr, substitution > 0 ? substitution : 1);
+    }
+}
+
+/* Count `token` of the unfinished loop. Returns true if it is a 'done' closing the outermost loop. */
+static bool count_loop_token(PushParser *self, Token token, const char *source)
+{
+    if (starts_line(token) && (self->loop_state == LOOP_WORD || self->loop_state == LOOP_WORDS)) {
+        self->loop_state = LOOP_PIPELINE;
+    }
+    if (token.type != WORD_TOKEN) {
+        if (self->loop_state == LOOP_NAME || self->loop_state == LOOP_IN) {
+            self->loop_state = LOOP_WORDS;
+        } else if (token.type == PIPE_TOKEN) {
+            self->loop_state = LOOP_COMMAND;
+        } else if (token.type == SEMI_TOKEN || token.type == AMP_TOKEN
+                || token.type == AND_IF_TOKEN || token.type == OR_IF_TOKEN) {
+            self->loop_state = LOOP_PIPELINE;
+        } else if (self->loop_state != LOOP_WORDS) {
+            /* A redirection, after which no keyword is recognised. */
+            self->loop_state = LOOP_WORD;
+        }
+        return false;
+    }
+    switch (self->loop_state) {
+        case LOOP_NAME:
+            self->loop_state = LOOP_IN;
+            return false;
+        case LOOP_IN:
+            self->loop_state = LOOP_WORDS;
+            return false;
+        case LOOP_WORDS:
+            return false;
+        case LOOP_PIPELINE:
+            if (spells(token, source, "for")) {
+                self->loop_depth += 1;
+                self->loop_state = LOOP_NAME;
+            } else if (spells(token, source, "while")) {
+                self->loop_depth += 1;
+            } else if (spells(token, source, "done") && self->loop_depth > 0) {
+                self->loop_depth -= 1;
+                self->loop_state = LOOP_WORD;
+                return self->loop_depth == 0;
+            } else if (!spells(token, source, "do")) {
+                self->loop_state = LOOP_WORD;
+            }
+            return false;
+        default:
+            self->loop_state = LOOP_WORD;
+            return false;
+    }
+}
+
+/*
+ * Count the loops opened and closed by the tokens of `loop` not yet
+ * counted. A word left open within a command substitution at the end
+ * is counted once more lines close it. Returns whether the outermost
+ * loop may be closed, so that the text is worth parsing.
+ */
+static bool count_loops(PushParser *self)
+{
+    const char *source = Str_cstr(&self->loop);
+    size_t length = Str_length(&self->loop);
+    CharItr char_itr = CharItr_value(source + self->loop_counted, length - self->loop_counted);
+    bool closed = false;
+    while (true) {
+        Token token = Scanner_lex(&char_itr, source);
+        if (token.type == END_TOKEN || (token.type == WORD_TOKEN
+                && token.offset + token.length == length
+                && open_substitution(Token_lexeme(token, source), token.length))) {
+            break;
+        }
+        closed = count_loop_token(self, token, source) || closed;
+        self->loop_counted = token.offset + token.length;
+    }
+    return closed || self->loop_depth == 0;
+}
+
+Node* PushParser_push(PushParser *self, const char *text, size_t length)
+{
+    PROFILE_START(timer);
+    bool resumed = Str_length(&self->loop) > 0;
+    if (resumed) {
+        Str_splice(&self->loop, Str_length(&self->loop), 0, text, length);
+        if (!count_loops(self)) {
+            PROFILE_STOP(timer, PHASE_PARSE);
+            return NULL;
+        }
+        text = Str_cstr(&self->loop);
+        length = Str_length(&self->loop);
+    }
+    Scanner scanner = Scanner_value(CharItr_value(text, length));
+    CommandParts parts = { &self->words, &self->redirects, &self->substitutions };
+    Node *tree = continue_list(&scanner, &self->items, &self->commands, parts, NULL);
+    if (tree == NULL && Scanner_has_next(&scanner)) {
+        /*
+         * An unfinished loop is kept as text, and its loops counted
+         * so that later lines are only scanned until they close it.
+         */
+        size_t start = Scanner_peek(&scanner).offset;
+        if (resumed) {
+            Str_splice(&self->loop, 0, start, NULL, 0);
+        } else {
+            Str_splice(&self->loop, 0, 0, text + start, length - start);
+        }
+        self->loop_counted = 0;
+        self->loop_depth = 0;
+        self->loop_state = LOOP_PIPELINE;
+        count_loops(self);
+    } else if (resumed) {
+        Str_splice(&self->loop, 0, Str_length(&self->loop), NULL, 0);
+    }
+    PROFILE_STOP(timer, PHASE_PARSE);
+    return tree;
+}
+
+Node* PushParser_finish(PushParser *self)
+{
+    if (!PushParser_pending(self)) {
+        return NULL;
+    }
+    const char *error = Str_length(&self->loop) > 0 ? PARSE_INCOMPLETE_LOOP
+            : Vec_length(&self->commands) > 0 ? PARSE_INCOMPLETE : PARSE_INCOMPLETE_LIST;
+    drop_commands(&self->commands);
+    drop_items(&self->items);
+    Str_splice(&self->loop, 0, Str_length(&self->loop), NULL, 0);
+    return ErrorNode_new(error);
+}
+
+static bool redirect_type(TokenType token, RedirectType *type)
+{
+    switch (token) {
+        case LESS_TOKEN:       *type = REDIRECT_IN; return true;
+        case GREAT_TOKEN:      *type = REDIRECT_OUT; return true;
+        case DGREAT_TOKEN:     *type = REDIRECT_APPEND; return true;
+        case ERR_GREAT_TOKEN:  *type = REDIRECT_ERR; return true;
+        case ERR_TO_OUT_TOKEN: *type = REDIRECT_ERR_TO_OUT; return true;
+        default:               return false;
+    }
+}
+
+static CharSpan lexeme(const Scanner *scanner, Token token)
+{
+    CharSpan span = { Token_lexeme(token, scanner->source), token.length };
+    return span;
+}
+
+/*
+ * Parse the command substitutions and variables within `word`, the
+ * command's word `index`, onto `substitutions`. Returns an ERROR_NODE
+ * if a substitution is left open or does not parse, and NULL
+ * otherwise.
+ */
+static Node* parse_substitutions(
+        const Scanner *scanner, CharSpan word, size_t index, Vec *substitutions)
+{
+    CharItr char_itr = CharItr_value(word.start, word.length);
+    while (true) {
+        CharItr_take_until(&char_itr, CHAR_DOLLAR);
+        if (!CharItr_has_next(&char_itr)) {
+            return NULL;
+        }
+        const char *start = CharItr_cursor(&char_itr);
+        bool closed;
+        size_t length = Scanner_substitution(start, char_itr.sentinel - start, &closed);
+        if (length == 0) {
+            size_t name, name_length;
+            length = Scanner_variable(start, char_itr.sentinel - start, &name, &name_length);
+            if (length > 0) {
+                Substitution variable = { index, start - word.start, length, NULL };
+                grow(substitutions);
+                Vec_set(substitutions, Vec_length(substitutions), &variable);
+            }
+            CharItr_advance(&char_itr, length > 0 ? length : 1);
+            continue;
+        }
+        if (!closed) {
+            return ErrorNode_new_with(PARSE_OPEN_SUBSTITUTION, scanner->allocator);
+        }
+        size_t opening = start[0] == '`' ? 1 : 2;
+        CharItr body = CharItr_value(start + opening, length - opening - 1);
+        Scanner inner = Scanner_value_with(body, scanner->allocator);
+        Node *tree = parse_list(&inner);
+        if (tree->type == ERROR_NODE) {
+            if (tree->data.error != PARSE_EMPTY_INPUT && tree->data.error != PARSE_INCOMPLETE
+                    && tree->data.error != PARSE_INCOMPLETE_LIST) {
+                return tree;
+            }
+            Node_drop(tree);
+            return ErrorNode_new_with(PARSE_EMPTY_SUBSTITUTION, scanner->allocator);
+        }
+        Substitution substitution = { index, start - word.start, length, tree };
+        grow(substitutions);
+        Vec_set(substitutions, Vec_length(substitutions), &substitution);
+        CharItr_advance(&char_itr, length);
+    }
+}
+
+/* Whether `word` holds a command substitution or a variable. */
+static bool has_substitution(CharSpan word)
+{
+    for (size_t i = 0; i < word.length; ++i) {
+        bool closed;
+        size_t name, name_length;
+        if (Scanner_substitution(word.start + i, word.length - i, &closed) > 0
+                || Scanner_variable(word.start + i, word.length - i, &name, &name_length) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * The command's words, redirections and substitutions are gathered
+ * into `parts` first so the CommandNode can be sized exactly.
+ */
+static Node* parse_command(Scanner *scanner, CommandParts parts)
+{
+    Token token = Scanner_peek(scanner);
+    if (token.type == END_TOKEN) {
+        return ErrorNode_new_with(PARSE_EMPTY_INPUT, scanner->allocator);
+    }
+    if (is_loop_start(scanner, token) || is_keyword(scanner, token, "do")
+            || is_keyword(scanner, token, "done")) {
+        return ErrorNode_new_with(PARSE_KEYWORD, scanner->allocator);
+    }
+
+    Vec_splice(parts.words, 0, Vec_length(parts.words), NULL, 0);
+    Vec_splice(parts.redirects, 0, Vec_length(parts.redirects), NULL, 0);
+    Vec_splice(parts.substitutions, 0, Vec_length(parts.substitutions), NULL, 0);
+    Node *error = gather(scanner, parts);
+    if (error != NULL) {
+        return error;
+    }
+    if (Vec_length(parts.words) == 0) {
+        return ErrorNode_new_with("Expected a command", scanner->allocator);
+    }
+
+    return CommandNode_new_with(
+            parts.words->buffer, Vec_length(parts.words),
+            parts.redirects->buffer, Vec_length(parts.redirects),
+            parts.substitutions->buffer, Vec_length(parts.substitutions),
+            scanner->allocator);
+}
+
+/*
+ * Add the words and redirections up to the end of the command to
+ * `parts`. Returns an ERROR_NODE, having dropped the substitutions
+ * gathered, if one does not parse, and NULL otherwise.
+ */
+static Node* gather(Scanner *scanner, CommandParts parts)
+{
+    while (true) {
+        Token token = Scanner_peek(scanner);
+        RedirectSpan redirect = { REDIRECT_IN, { NULL, 0 } };
+        bool first = Vec_length(parts.words) == 0 && Vec_length(parts.redirects) == 0;
+        if (!first && starts_line(token)) {
+            /* A new line begins the next command of a list. */
+            return NULL;
+        }
+        if (token.type == WORD_TOKEN) {
+            Scanner_next(scanner);
+            CharSpan word = lexeme(scanner, token);
+            Node *error = parse_substitutions(
+                    scanner, word, Vec_length(parts.words), parts.substitutions);
+            if (error != NULL) {
+                drop_substitutions(parts.substitutions);
+                return error;
+            }
+            grow(parts.words);
+            Vec_set(parts.words, Vec_length(parts.words), &word);
+        } else if (redirect_type(token.type, &redirect.type)) {
+            Scanner_next(scanner);
+            if (redirect.type != REDIRECT_ERR_TO_OUT) {
+                Token target = Scanner_peek(scanner);
+                if (target.type != WORD_TOKEN || starts_line(target)) {
+                    drop_substitutions(parts.substitutions);
+                    return ErrorNode_new_with(
+                            "Expected a file name after a redirection", scanner->allocator);
+                }
+                redirect.target = lexeme(scanner, Scanner_next(scanner));
+                if (has_substitution(redirect.target)) {
+                    drop_substitutions(parts.substitutions);
+                    return ErrorNode_new_with(PARSE_TARGET_SUBSTITUTION, scanner->allocator);
+                }
+            }
+            grow(parts.redirects);
+            Vec_set(parts.redirects, Vec_length(parts.redirects), &redirect);
+        } else {
+            return NULL;
+        }
+    }
+}
+
+/* Whether `word` may name a variable: letters, digits and '_', not led by a digit. */
+static bool is_name(CharSpan word)
+{
+    for (size_t i = 0; i < word.length; ++i) {
+        char c = word.start[i];
+        bool letter = c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        if (!letter && (i == 0 || c < '0' || c > '9')) {
+            return false;
+        }
+    }
+    return word.length > 0;
+}
+
+/*
+ * A loop's condition or body: a list ending before `terminator`,
+ * which is left for the caller to take. Returns NULL if the tokens
+ * run out first.
+ */
+static Node* parse_nested(Scanner *scanner, CommandParts parts, const char *terminator)
+{
+    Vec items = Vec_value_with(1, sizeof(ListItem), scanner->allocator);
+    Vec commands = Vec_value_with(2, sizeof(Node*), scanner->allocator);
+    Node *tree = continue_list(scanner, &items, &commands, parts, terminator);
+    if (tree == NULL) {
+        drop_commands(&commands);
+        drop_items(&items);
+    }
+    Vec_drop(&commands);
+    Vec_drop(&items);
+    return tree;
+}
+
+/*
+ * The head of a for loop: its variable's name and words as one
+ * COMMAND_NODE, and the ';' after them. Returns NULL if the tokens
+ * run out first.
+ */
+static Node* parse_for_head(Scanner *scanner, CommandParts parts)
+{
+    if (!Scanner_has_next(scanner)) {
+        return NULL;
+    }
+    Token name = Scanner_next(scanner);
+    if (name.type != WORD_TOKEN || !is_name(lexeme(scanner, name))) {
+        return ErrorNode_new_with(PARSE_LOOP_NAME, scanner->allocator);
+    }
+    if (!Scanner_has_next(scanner)) {
+        return NULL;
+    }
+    if (!is_keyword(scanner, Scanner_next(scanner), "in")) {
+        return ErrorNode_new_with(PARSE_LOOP_IN, scanner->allocator);
+    }
+
+    Vec_splice(parts.words, 0, Vec_length(parts.words), NULL, 0);
+    Vec_splice(parts.redirects, 0, Vec_length(parts.redirects), NULL, 0);
+    Vec_splice(parts.substitutions, 0, Vec_length(parts.substitutions), NULL, 0);
+    CharSpan word = lexeme(scanner, name);
+    grow(parts.words);
+    Vec_set(parts.words, 0, &word);
+    Node *error = gather(scanner, parts);
+    if (error != NULL) {
+        return error;
+    }
+    Token token = Scanner_peek(scanner);
+    if (token.type == END_TOKEN) {
+        drop_substitutions(parts.substitutions);
+        return NULL;
+    }
+    if (Vec_length(parts.redirects) > 0 || (token.type != SEMI_TOKEN && !starts_line(token))) {
+        drop_substitutions(parts.substitutions);
+        return ErrorNode_new_with(PARSE_LOOP_WORDS, scanner->allocator);
+    }
+    if (!starts_line(token)) {
+        Scanner_next(scanner);
+    }
+    return CommandNode_new_with(
+            parts.words->buffer, Vec_length(parts.words),
+            NULL, 0,
+            parts.substitutions->buffer, Vec_length(parts.substitutions),
+            scanner->allocator);
+}
+
+/*
+ * A loop, from its first keyword through 'done'. Its lists are parsed
+ * recursively, so stack use grows with the nesting of loops but not
+ * with their length. Returns NULL if the tokens run out first.
+ */
+static Node* parse_loop(Scanner *scanner, CommandParts parts)
+{
+    NodeType type = is_keyword(scanner, Scanner_next(scanner), "for") ? FOR_NODE : WHILE_NODE;
+    Node *head = type == FOR_NODE ? parse_for_head(scanner, parts)
+            : parse_nested(scanner, parts, "do");
+    if (head == NULL || head->type == ERROR_NODE) {
+        return head;
+    }
+    if (!Scanner_has_next(scanner)) {
+        Node_drop(head);
+        return NULL;
+    }
+    if (!is_keyword(scanner, Scanner_next(scanner), "do")) {
+        Node_drop(head);
+        return ErrorNode_new_with(PARSE_LOOP_DO, scanner->allocator);
+    }
+    Node *body = parse_nested(scanner, parts, "done");
+    if (body == NULL || body->type == ERROR_NODE) {
+        Node_drop(head);
+        return body;
+    }
+    Scanner_next(scanner);
+    return LoopNode_new_with(type, head, body, scanner->allocator);
+}
+
+static void drop_substitutions(Vec *substitutions)
+{
+    for (size_t i = 0; i < Vec_length(substitutions); ++i) {
+        Node_drop(((Substitution*) Vec_ref(substitutions, i))->tree);
+    }
+    Vec_splice(substitutions, 0, Vec_length(substitutions), NULL, 0);
+}
+
+/*
+ * Double a full Vec before pushing. Arena memory is not reclaimed
+ * until reset, so growing one item at a time would cost quadratic
+ * bytes in the number of items.
+ */
+static void grow(Vec *vec)
+{
+    if (vec->length == vec->capacity) {
+        Vec_reserve(vec, vec->capacity * 2);
+    }
+}
@@ -0,0 +1,74 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <time.h>
+
+#include "Profile.h"
+
+static atomic_bool enabled = false;
+static Histogram histograms[PHASE_COUNT];
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {
+    "read",
+    "scan",
+    "parse",
+    "exec"
+};
+
+void Profile_enable(void)
+{
+    atomic_store_explicit(&enabled, true, memory_order_release);
+}
+
+void Profile_disable(void)
+{
+    atomic_store_explicit(&enabled, false, memory_order_release);
+}
+
+bool Profile_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_acquire);
+}
+
+uint64_t Profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void Profile_record(Phase phase, uint64_t nanos)
+{
+    Histogram_record(&histograms[phase], nanos);
+}
+
+const Histogram* Profile_histogram(Phase phase)
+{
+    return &histograms[phase];
+}
+
+void Profile_report(FILE *out)
+{
+    fprintf(out, "=== PROFILE ===\n");
+    fprintf(out, "%-8s %10s %12s %12s %12s\n",
+            "phase", "count", "p50 (us)", "p99 (us)", "max (us)");
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        const Histogram *h = &histograms[i];
+        if (Histogram_count(h) == 0) {
+            continue;
+        }
+        fprintf(out, "%-8s %10llu %12.3f %12.3f %12.3f\n",
+                PHASE_NAMES[i],
+                (unsigned long long) Histogram_count(h),
+                Histogram_percentile(h, 50.0) / 1000.0,
+                Histogram_percentile(h, 99.0) / 1000.0,
+                Histogram_max(h) / 1000.0);
+    }
+}
+
+void Profile_reset(void)
+{
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        Histogram_reset(&histograms[i]);
+    }
+}
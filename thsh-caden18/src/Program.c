@@ -0,0 +1,336 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Guards.h"
+#include "Profile.h"
+#include "Program.h"
+
+/* Loops nested this deep or less keep their frames on the stack. */
+#define LOCAL_FRAMES 8
+
+static size_t emit(Program *self, Opcode opcode, size_t operand)
+{
+    Instruction instruction = { opcode, operand };
+    size_t at = Vec_length(&self->code);
+    Vec_set(&self->code, at, &instruction);
+    return at;
+}
+
+/* Point the jump at `at` to the next instruction to be emitted. */
+static void patch(Program *self, size_t at)
+{
+    Instruction *instruction = Vec_ref(&self->code, at);
+    instruction->operand = Vec_length(&self->code);
+}
+
+static size_t add_node(Program *self, const Node *node)
+{
+    size_t at = Vec_length(&self->nodes);
+    Vec_set(&self->nodes, at, &node);
+    return at;
+}
+
+static bool is_list(const Node *node)
+{
+    return node->type == SEQUENCE_NODE || node->type == AND_NODE || node->type == OR_NODE;
+}
+
+/*
+ * The builtin a pipeline always calls, if it is a lone builtin command
+ * with no substitution or redirect, and not a job builtin, whose table
+ * is only known when running.
+ */
+static Builtin resolve(const Node *node)
+{
+    if (node->type != COMMAND_NODE) {
+        return NULL;
+    }
+    const CommandValue *command = &node->data.command;
+    if (Command_substitution_count(command) > 0 || Command_redirect_count(command) > 0) {
+        return NULL;
+    }
+    char *const *argv = Command_argv(command);
+    return JobTable_find_builtin(argv) == NULL ? Builtin_find(argv) : NULL;
+}
+
+static void compile_list(Program *self, const Node *node, size_t depth);
+
+static void compile_item(Program *self, const Node *node, size_t depth)
+{
+    if (depth + 1 > self->depth && (node->type == FOR_NODE || node->type == WHILE_NODE)) {
+        self->depth = depth + 1;
+    }
+    if (node->type == FOR_NODE) {
+        emit(self, OP_FOR, add_node(self, node->data.loop.head));
+        size_t next = emit(self, OP_NEXT, 0);
+        compile_list(self, node->data.loop.body, depth + 1);
+        emit(self, OP_REPEAT, next);
+        patch(self, next);
+    } else if (node->type == WHILE_NODE) {
+        emit(self, OP_WHILE, 0);
+        size_t condition = Vec_length(&self->code);
+        compile_list(self, node->data.loop.head, depth + 1);
+        size_t test = emit(self, OP_TEST, 0);
+        compile_list(self, node->data.loop.body, depth + 1);
+        emit(self, OP_REPEAT, condition);
+        patch(self, test);
+    } else {
+        Builtin builtin = resolve(node);
+        if (builtin != NULL) {
+            BuiltinCall call = { builtin, Command_argv(&node->data.command) };
+            size_t at = Vec_length(&self->calls);
+            Vec_set(&self->calls, at, &call);
+            emit(self, OP_BUILTIN, at);
+        } else {
+            emit(self, OP_RUN, add_node(self, node));
+        }
+    }
+}
+
+/*
+ * A list's items in order. The branch after an item skips the next
+ * one, landing on the branch after that, which then tests the same
+ * status: in "a && b || c", c runs when a fails.
+ */
+static void compile_list(Program *self, const Node *node, size_t depth)
+{
+    bool pending = false;
+    size_t branch = 0;
+    while (true) {
+        const Node *item = is_list(node) ? node->data.list.left : node;
+        compile_item(self, item, depth);
+        if (pending) {
+            patch(self, branch);
+            pending = false;
+        }
+        if (!is_list(node)) {
+            return;
+        }
+        if (node->type != SEQUENCE_NODE) {
+            branch = emit(self, node->type == AND_NODE ? OP_JUMP_IF_FAILED : OP_JUMP_IF_SUCCEEDED,
+                    0);
+            pending = true;
+        }
+        node = node->data.list.right;
+    }
+}
+
+Program Program_compile(const Node *tree)
+{
+    Program program = {
+        Vec_value(16, sizeof(Instruction)),
+        Vec_value(8, sizeof(Node*)),
+        Vec_value(4, sizeof(BuiltinCall)),
+        0
+    };
+    if (tree->type == ERROR_NODE) {
+        emit(&program, OP_ERROR, add_node(&program, tree));
+    } else {
+        compile_list(&program, tree, 0);
+    }
+    emit(&program, OP_HALT, 0);
+    return program;
+}
+
+void Program_drop(Program *self)
+{
+    Vec_drop(&self->code);
+    Vec_drop(&self->nodes);
+    Vec_drop(&self->calls);
+}
+
+/*
+ * A loop being run. A for loop's binding is the innermost of the
+ * bindings in scope until it ends; frames never move, so inner
+ * bindings may point to it.
+ */
+typedef struct Frame {
+    Binding binding;
+    char *const *word;  /* the next word to bind */
+    Expansion expansion;
+    bool expanded;
+    int status;         /* of the last body run */
+} Frame;
+
+/*
+ * Threaded dispatch: with GCC's labels as values each instruction
+ * jumps straight to the next one's handler, which predicts better than
+ * the single indirect branch of a switch. Build with
+ * -DTHSH_SWITCH_DISPATCH for the switch, as other compilers must.
+ */
+#if defined(__GNUC__) && !defined(THSH_SWITCH_DISPATCH)
+#define COMPUTED_GOTO
+#endif
+
+int Program_run(const Program *self, int in_fd, int out_fd, JobTable *jobs)
+{
+    Frame local[LOCAL_FRAMES];
+    Frame *frames = self->depth <= LOCAL_FRAMES ? local : malloc(self->depth * sizeof(Frame));
+    OOM_GUARD(frames, __FILE__, __LINE__);
+    size_t top = 0;
+    Frame *frame = NULL;
+    const Binding *bindings = NULL;
+    const Instruction *code = self->code.buffer;
+    const Instruction *pc = code;
+    const Node *const *nodes = self->nodes.buffer;
+    const BuiltinCall *calls = self->calls.buffer;
+    int status = EXIT_SUCCESS;
+
+#ifdef COMPUTED_GOTO
+    static const void *const LABELS[OPCODE_COUNT] = {
+        [OP_RUN] = &&L_OP_RUN,
+        [OP_BUILTIN] = &&L_OP_BUILTIN,
+        [OP_JUMP_IF_FAILED] = &&L_OP_JUMP_IF_FAILED,
+        [OP_JUMP_IF_SUCCEEDED] = &&L_OP_JUMP_IF_SUCCEEDED,
+        [OP_WHILE] = &&L_OP_WHILE,
+        [OP_TEST] = &&L_OP_TEST,
+        [OP_FOR] = &&L_OP_FOR,
+        [OP_NEXT] = &&L_OP_NEXT,
+        [OP_REPEAT] = &&L_OP_REPEAT,
+        [OP_ERROR] = &&L_OP_ERROR,
+        [OP_HALT] = &&L_OP_HALT,
+    };
+#define TARGET(op) L_##op
+#define DISPATCH() goto *LABELS[pc->opcode]
+    DISPATCH();
+#else
+#define TARGET(op) case op
+#define DISPATCH() continue
+    for (;;) switch (pc->opcode) {
+#endif
+
+    TARGET(OP_RUN): {
+        status = execute_pipeline(nodes[pc->operand], in_fd, out_fd, jobs, bindings);
+        ++pc;
+        DISPATCH();
+    }
+    TARGET(OP_BUILTIN): {
+        PROFILE_START(timer);
+        const BuiltinCall *call = calls + pc->operand;
+        status = call->builtin(call->argv, in_fd, out_fd, STDERR_FILENO);
+        PROFILE_STOP(timer, PHASE_EXEC);
+        ++pc;
+        DISPATCH();
+    }
+    TARGET(OP_JUMP_IF_FAILED): {
+        pc = status != EXIT_SUCCESS ? code + pc->operand : pc + 1;
+        DISPATCH();
+    }
+    TARGET(OP_JUMP_IF_SUCCEEDED): {
+        pc = status == EXIT_SUCCESS ? code + pc->operand : pc + 1;
+        DISPATCH();
+    }
+    TARGET(OP_WHILE): {
+        frame = &frames[top++];
+        frame->expanded = false;
+        frame->status = EXIT_SUCCESS;
+        ++pc;
+        DISPATCH();
+    }
+    TARGET(OP_TEST): {
+        if (status == EXIT_SUCCESS) {
+            ++pc;
+        } else {
+            status = frame->status;
+            frame = --top > 0 ? &frames[top - 1] : NULL;
+            pc = code + pc->operand;
+        }
+        DISPATCH();
+    }
+    TARGET(OP_FOR): {
+        frame = &frames[top++];
+        const CommandValue *words = &nodes[pc->operand]->data.command;
+        char *const *argv = Command_argv(words);
+        frame->expanded = Command_substitution_count(words) > 0;
+        if (frame->expanded) {
+            execute_expand(words, in_fd, bindings, &frame->expansion);
+            argv = frame->expansion.argv.buffer;
+        }
+        /* The name is never expanded, so stays first. */
+        frame->binding = (Binding) { argv[0], NULL, bindings };
+        frame->word = argv + 1;
+        frame->status = EXIT_SUCCESS;
+        bindings = &frame->binding;
+        ++pc;
+        DISPATCH();
+    }
+    TARGET(OP_NEXT): {
+        if (*frame->word != NULL) {
+            frame->binding.value = *frame->word++;
+            ++pc;
+        } else {
+            if (frame->expanded) {
+                Expansion_drop(&frame->expansion);
+            }
+            bindings = frame->binding.outer;
+            status = frame->status;
+            frame = --top > 0 ? &frames[top - 1] : NULL;
+            pc = code + pc->operand;
+        }
+        DISPATCH();
+    }
+    TARGET(OP_REPEAT): {
+        frame->status = status;
+        pc = code + pc->operand;
+        DISPATCH();
+    }
+    TARGET(OP_ERROR): {
+        fprintf(stderr, "thsh: %s\n", nodes[pc->operand]->data.error);
+        status = EXIT_SYNTAX_ERROR;
+        ++pc;
+        DISPATCH();
+    }
+    TARGET(OP_HALT): {
+        goto halt;
+    }
+
+#ifndef COMPUTED_GOTO
+    }
+#endif
+#undef TARGET
+#undef DISPATCH
+
+halt:
+    if (frames != local) {
+        free(frames);
+    }
+    return status;
+}
+
+static const char *OPCODE_NAMES[OPCODE_COUNT] = {
+    "run", "builtin", "jump_if_failed", "jump_if_succeeded",
+    "while", "test", "for", "next", "repeat", "error", "halt"
+};
+
+void Program_print(const Program *self, FILE *out)
+{
+    for (size_t i = 0; i < Vec_length(&self->code); ++i) {
+        const Instruction *instruction = Vec_ref(&self->code, i);
+        fprintf(out, "%4zu  %-18s", i, OPCODE_NAMES[instruction->opcode]);
+        switch (instruction->opcode) {
+            case OP_BUILTIN: {
+                const BuiltinCall *call = Vec_ref(&self->calls, instruction->operand);
+                fprintf(out, "%s", call->argv[0]);
+                break;
+            }
+            case OP_RUN:
+            case OP_FOR:
+                fprintf(out, "node %u", instruction->operand);
+                break;
+            case OP_JUMP_IF_FAILED:
+            case OP_JUMP_IF_SUCCEEDED:
+            case OP_TEST:
+            case OP_NEXT:
+            case OP_REPEAT:
+                fprintf(out, "-> %u", instruction->operand);
+                break;
+            default:
+                break;
+        }
+        fputc('\n', out);
+    }
+}
@@ -0,0 +1,103 @@
+#include "Rescan.h"
+
+void TokenSpans_push(TokenSpans *self, Token token)
+{
+    size_t length = Vec_length(self);
+    if (length == self->capacity) {
+        Vec_reserve(self, length * 2 + 1);
+    }
+    Vec_set(self, length, &token);
+}
+
+static size_t token_end(const Token *token)
+{
+    return token->offset + token->length;
+}
+
+TokenSpans TokenSpans_scan(const char *input, size_t length)
+{
+    return TokenSpans_scan_range(input, 0, length);
+}
+
+TokenSpans TokenSpans_scan_range(const char *input, size_t from, size_t to)
+{
+    TokenSpans spans = Vec_value((to - from) / 8 + 1, sizeof(Token));
+    CharItr char_itr = CharItr_value(input + from, to - from);
+    Token token;
+    while ((token = Scanner_lex(&char_itr, input)).type != END_TOKEN) {
+        TokenSpans_push(&spans, token);
+    }
+    return spans;
+}
+
+size_t TokenSpans_rescan(TokenSpans *spans, const char *input, size_t length, Edit edit)
+{
+    size_t count = Vec_length(spans);
+    size_t edit_end = edit.offset + edit.deleted; /* in old offsets */
+
+    /*
+     * The first token that could be affected is the first one ending
+     * at or after the edit: a token ending exactly at the edit may be
+     * extended by inserted chars. So may a "2>" before that, which can
+     * join what follows into "2>&1". Lexing restarts at the end of the
+     * token before those, which the edit cannot have touched.
+     */
+    size_t first = 0;
+    size_t last = count;
+    while (first < last) {
+        size_t mid = first + (last - first) / 2;
+        if (token_end(Vec_ref(spans, mid)) < edit.offset) {
+            first = mid + 1;
+        } else {
+            last = mid;
+        }
+    }
+    if (first > 0 && ((Token*) Vec_ref(spans, first - 1))->type == ERR_GREAT_TOKEN) {
+        --first;
+    }
+    size_t restart = first == 0 ? 0 : token_end(Vec_ref(spans, first - 1));
+
+    /*
+     * Re-lex until a token starts exactly where an old token that lay
+     * wholly after the edit starts, shifted by the edit's size, with
+     * the same flags. From there on the text, and so the tokens, are
+     * unchanged.
+     */
+    Vec relexed = Vec_value(4, sizeof(Token));
+    CharItr char_itr = CharItr_value(input + restart, length - restart);
+    size_t resync = first;
+    while (true) {
+        Token token = Scanner_lex(&char_itr, input);
+        size_t offset = token.offset;
+
+        while (resync < count) {
+            Token *old = Vec_ref(spans, resync);
+            if (old->offset >= edit_end && old->offset + edit.inserted - edit.deleted >= offset) {
+                break;
+            }
+            ++resync;
+        }
+        if (resync < count) {
+            Token *old = Vec_ref(spans, resync);
+            if (old->offset + edit.inserted - edit.deleted == offset && old->flags == token.flags) {
+                break;
+            }
+        }
+        if (token.type == END_TOKEN) {
+            resync = count;
+            break;
+        }
+
+        TokenSpans_push(&relexed, token);
+    }
+
+    for (size_t i = resync; i < count; ++i) {
+        Token *old = Vec_ref(spans, i);
+        old->offset += edit.inserted - edit.deleted;
+    }
+    Vec_splice(spans, first, resync - first, relexed.buffer, Vec_length(&relexed));
+
+    size_t relexed_count = Vec_length(&relexed);
+    Vec_drop(&relexed);
+    return relexed_count;
+}
@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Exec.h"
+#include "Guards.h"
+#include "LineReader.h"
+#include "Parser.h"
+#include "Runner.h"
+#include "ScriptCache.h"
+
+#define ARENA_CHUNK (64 << 10)
+#define COPY_BUFFER (64 << 10)
+
+typedef struct Script {
+    const char *path;
+    FILE *capture; /* the script's stdout */
+    int status;
+    bool done;     /* guarded by Runner.lock */
+} Script;
+
+typedef struct Runner {
+    Vec scripts;   /* Script values, in the caller's order */
+    Vec deques;    /* one uint64_t per worker, see take_front */
+    size_t workers;
+    int null_fd;
+    const char *cache_dir; /* NULL to parse every script */
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+} Runner;
+
+typedef struct Worker {
+    Runner *runner;
+    size_t index;
+} Worker;
+
+/*
+ * A worker's deque is the half open range of script indices
+ * [front, back) packed into one 64-bit word, front in the high half,
+ * so that the owner and thieves can both claim work with one CAS.
+ */
+static uint64_t pack(uint64_t front, uint64_t back)
+{
+    return front << 32 | back;
+}
+
+/* The owner takes from the front, keeping its scripts in order. */
+static bool take_front(uint64_t *deque, size_t *index)
+{
+    uint64_t range = __atomic_load_n(deque, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint64_t front = range >> 32;
+        uint64_t back = range & UINT32_MAX;
+        if (front >= back) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(deque, &range, pack(front + 1, back), false,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *index = front;
+            return true;
+        }
+    }
+}
+
+/* Thieves take from the back, furthest from the owner. */
+static bool take_back(uint64_t *deque, size_t *index)
+{
+    uint64_t range = __atomic_load_n(deque, __ATOMIC_ACQUIRE);
+    while (true) {
+        uint64_t front = range >> 32;
+        uint64_t back = range & UINT32_MAX;
+        if (front >= back) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(deque, &range, pack(front, back - 1), false,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *index = back - 1;
+            return true;
+        }
+    }
+}
+
+static bool claim(Runner *runner, size_t self, size_t *index)
+{
+    if (take_front(Vec_ref(&runner->deques, self), index)) {
+        return true;
+    }
+    for (size_t k = 1; k < runner->workers; ++k) {
+        size_t victim = (self + k) % runner->workers;
+        if (take_back(Vec_ref(&runner->deques, victim), index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Run the trees of a script read back from the cache, up to the first
+ * syntax error.
+ */
+static void run_cached(Script *script, CachedScript *cached, Arena *arena, int null_fd,
+        int out_fd)
+{
+    Node *tree;
+    while ((tree = CachedScript_next(cached, Arena_allocator(arena))) != NULL) {
+        bool failed = tree->type == ERROR_NODE;
+        script->status = execute(tree, null_fd, out_fd);
+        Node_drop(tree);
+        Arena_reset(arena);
+        if (failed) {
+            return;
+        }
+    }
+}
+
+/*
+ * The tree that `line` completes, or NULL if it only continues a list
+ * or loop begun on the lines before it, which `continuation` keeps. A
+ * line that is whole by itself is parsed into `arena`. At the end of
+ * the script, when `line` is NULL, a list still pending is a syntax
+ * error.
+ */
+static Node* parse_line(PushParser *continuation, const char *line, size_t length,
+        Arena *arena)
+{
+    if (line == NULL) {
+        return PushParser_finish(continuation);
+    }
+    if (PushParser_pending(continuation)) {
+        return PushParser_push(continuation, line, length);
+    }
+    Scanner scanner = Scanner_value_with(CharItr_value(line, length), Arena_allocator(arena));
+    Node *tree = parse(&scanner);
+    if (parse_incomplete(tree)) {
+        Node_drop(tree);
+        tree = PushParser_push(continuation, line, length);
+    }
+    return tree;
+}
+
+static void run_script(Script *script, Arena *arena, int null_fd, const char *cache_dir)
+{
+    script->capture = tmpfile();
+    OOM_GUARD(script->capture, __FILE__, __LINE__);
+    int out_fd = fileno(script->capture);
+    fcntl(out_fd, F_SETFD, FD_CLOEXEC);
+
+    int input_fd = open(script->path, O_RDONLY | O_CLOEXEC);
+    if (input_fd < 0) {
+        fprintf(stderr, "thsh: %s: %s\n", script->path, strerror(errno));
+        script->status = EXIT_NOT_FOUND;
+        return;
+    }
+
+    script->status = EXIT_SUCCESS;
+    ScriptKey key;
+    bool cacheable = cache_dir != NULL && ScriptKey_of(input_fd, &key);
+    CachedScript cached;
+    if (cacheable && CachedScript_open(&cached, cache_dir, script->path, &key)) {
+        run_cached(script, &cached, arena, null_fd, out_fd);
+        CachedScript_drop(&cached);
+        close(input_fd);
+        return;
+    }
+
+    /*
+     * Lines ending in '|', '&&' or '||', or within a loop, continue on
+     * the lines after them, as they do on standard input. A syntax
+     * error ends the script with its status. A script not in the cache
+     * is saved to it once it has run.
+     */
+    ScriptEncoder encoder = ScriptEncoder_value();
+    LineReader input = LineReader_value(input_fd);
+    PushParser continuation = PushParser_value();
+    bool failed = false;
+    while (!failed) {
+        size_t length;
+        const char *line = LineReader_next(&input, &length);
+        Node *tree = parse_line(&continuation, line, length, arena);
+        if (tree != NULL && (tree->type != ERROR_NODE || tree->data.error != PARSE_EMPTY_INPUT)) {
+            if (cacheable) {
+                ScriptEncoder_add(&encoder, tree);
+            }
+            failed = tree->type == ERROR_NODE;
+            script->status = execute(tree, null_fd, out_fd);
+        }
+        if (tree != NULL) {
+            Node_drop(tree);
+        }
+        Arena_reset(arena);
+        if (line == NULL) {
+            break;
+        }
+    }
+    if (cacheable) {
+        ScriptEncoder_save(&encoder, cache_dir, script->path, &key);
+    }
+    PushParser_drop(&continuation);
+    ScriptEncoder_drop(&encoder);
+    LineReader_drop(&input);
+    close(input_fd);
+}
+
+static void* work(void *arg)
+{
+    Worker *worker = arg;
+    Runner *runner = worker->runner;
+    Arena arena = Arena_value(ARENA_CHUNK);
+    size_t index;
+    while (claim(runner, worker->index, &index)) {
+        Script *script = Vec_ref(&runner->scripts, index);
+        run_script(script, &arena, runner->null_fd, runner->cache_dir);
+
+        pthread_mutex_lock(&runner->lock);
+        script->done = true;
+        pthread_cond_broadcast(&runner->finished);
+        pthread_mutex_unlock(&runner->lock);
+    }
+    Arena_drop(&arena);
+    return NULL;
+}
+
+static void copy_out(FILE *capture, int out_fd)
+{
+    char *buffer = malloc(COPY_BUFFER);
+    OOM_GUARD(buffer, __FILE__, __LINE__);
+    int fd = fileno(capture);
+    lseek(fd, 0, SEEK_SET);
+    ssize_t n;
+    while ((n = read(fd, buffer, COPY_BUFFER)) > 0) {
+        ssize_t written = 0;
+        while (written < n) {
+            ssize_t w = write(out_fd, buffer + written, n - written);
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                free(buffer);
+                return;
+            }
+            written += w;
+        }
+    }
+    free(buffer);
+}
+
+int Runner_run(const char **scripts, size_t count, size_t workers, int out_fd, int *statuses,
+        const char *cache_dir)
+{
+    if (workers == 0) {
+        workers = 1;
+    }
+    if (workers > count && count > 0) {
+        workers = count;
+    }
+
+    Runner runner = {
+        Vec_value(count, sizeof(Script)),
+        Vec_value(workers, sizeof(uint64_t)),
+        workers,
+        open("/dev/null", O_RDONLY | O_CLOEXEC),
+        cache_dir,
+        PTHREAD_MUTEX_INITIALIZER,
+        PTHREAD_COND_INITIALIZER
+    };
+    for (size_t i = 0; i < count; ++i) {
+        Script script = { scripts[i], NULL, EXIT_SUCCESS, false };
+        Vec_set(&runner.scripts, i, &script);
+    }
+    for (size_t w = 0; w < workers; ++w) {
+        uint64_t deque = pack(w * count / workers, (w + 1) * count / workers);
+        Vec_set(&runner.deques, w, &deque);
+    }
+    if (runner.null_fd < 0) {
+        runner.null_fd = STDIN_FILENO;
+    }
+
+    Vec threads = Vec_value(workers, sizeof(pthread_t));
+    Vec args = Vec_value(workers, sizeof(Worker));
+    for (size_t w = 0; w < workers; ++w) {
+        Worker worker = { &runner, w };
+        Vec_set(&args, w, &worker);
+    }
+    for (size_t w = 0; w < workers; ++w) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, work, Vec_ref(&args, w)) != 0) {
+            OOM_GUARD(NULL, __FILE__, __LINE__);
+        }
+        Vec_set(&threads, w, &thread);
+    }
+
+    int status = EXIT_SUCCESS;
+    for (size_t i = 0; i < count; ++i) {
+        Script *script = Vec_ref(&runner.scripts, i);
+        pthread_mutex_lock(&runner.lock);
+        while (!script->done) {
+            pthread_cond_wait(&runner.finished, &runner.lock);
+        }
+        pthread_mutex_unlock(&runner.lock);
+
+        copy_out(script->capture, out_fd);
+        fclose(script->capture);
+        statuses[i] = script->status;
+        if (script->status != EXIT_SUCCESS) {
+            status = script->status;
+        }
+    }
+
+    for (size_t w = 0; w < workers; ++w) {
+        pthread_join(*(pthread_t*) Vec_ref(&threads, w), NULL);
+    }
+    Vec_drop(&threads);
+    Vec_drop(&args);
+    Vec_drop(&runner.deques);
+    Vec_drop(&runner.scripts);
+    if (runner.null_fd != STDIN_FILENO) {
+        close(runner.null_fd);
+    }
+    pthread_mutex_destroy(&runner.lock);
+    pthread_cond_destroy(&runner.finished);
+    return status;
+}
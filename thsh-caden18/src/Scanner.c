@@ -1,19 +1,31 @@
-#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "CharItr.h"
+#include "Guards.h"
+#include "Profile.h"
 
 #include "Scanner.h"
 
-Token get_token(CharItr *char_itr);
+_Static_assert(sizeof(Token) <= 16, "Token should stay compact");
 
 Scanner Scanner_value(CharItr char_itr)
 {
-    Token next = get_token(&char_itr);
+    return Scanner_value_with(char_itr, &LIBC_ALLOCATOR);
+}
+
+Scanner Scanner_value_with(CharItr char_itr, const Allocator *allocator)
+{
+    const char *source = CharItr_cursor(&char_itr);
+    PROFILE_START(timer);
+    Token next = Scanner_lex(&char_itr, source);
+    PROFILE_STOP(timer, PHASE_SCAN);
 
     Scanner itr = {
         char_itr,
-        next
+        source,
+        next,
+        allocator
     };
 
     return itr;
@@ -21,108 +33,203 @@ Scanner Scanner_value(CharItr char_itr)
 
 bool Scanner_has_next(const Scanner *self)
 {
-    
-    if (self->next.type != END_TOKEN) {
-        return true;
-    }
-    CharItr temp = self->char_itr;
-    int k = 0;
-    while (CharItr_has_next(&temp)) {
-        char tok = CharItr_has_next(&temp);
-        if (tok == EOF) {
-            return true;
-        }
-        if (tok == '|') {
-            return true;
-        }
-        if (tok == ' ' || tok == '\t' || tok == '\n' || tok == '\0') {
-            if (k == 0) {
-                continue;
-            }
-            return true;
-        }
-        k++;
-        if (!CharItr_has_next(&temp)) {
-            return true;
-        }
-    }
-    return false;
+    return self->next.type != END_TOKEN;
 }
 
 Token Scanner_peek(const Scanner *self)
 {
-    if (Scanner_has_next(self)) {
-        return self->next;
-    } else {
-        Token next = {
-            END_TOKEN, 
-            Str_from("")
-        };
-        return next;
-    }
+    return self->next;
 }
 
 Token Scanner_next(Scanner *self)
 {
     if (Scanner_has_next(self)) {
         Token next = self->next;
-        Token second = get_token(&self->char_itr);
-        self->next = second;
+        PROFILE_START(timer);
+        self->next = Scanner_lex(&self->char_itr, self->source);
+        PROFILE_STOP(timer, PHASE_SCAN);
         return next;
     } else {
-        fprintf(stderr, "%s:%d - Out of Bounds", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
+    }
+}
+
+ScannerMark Scanner_mark(const Scanner *self)
+{
+    ScannerMark mark = {
+        self->char_itr,
+        self->next
+    };
+    return mark;
+}
+
+void Scanner_reset(Scanner *self, ScannerMark mark)
+{
+    self->char_itr = mark.char_itr;
+    self->next = mark.next;
+}
+
+const char* Token_lexeme(Token token, const char *source)
+{
+    return source + token.offset;
+}
+
+TokenType Scanner_operator(const char *text, size_t available, size_t *length)
+{
+    if (available == 0) {
+        return WORD_TOKEN;
+    }
+    switch (text[0]) {
+        case '|':
+            if (available >= 2 && text[1] == '|') {
+                *length = 2;
+                return OR_IF_TOKEN;
+            }
+            *length = 1;
+            return PIPE_TOKEN;
+        case '<':
+            *length = 1;
+            return LESS_TOKEN;
+        case '&':
+            if (available >= 2 && text[1] == '&') {
+                *length = 2;
+                return AND_IF_TOKEN;
+            }
+            *length = 1;
+            return AMP_TOKEN;
+        case ';':
+            *length = 1;
+            return SEMI_TOKEN;
+        case '>':
+            if (available >= 2 && text[1] == '>') {
+                *length = 2;
+                return DGREAT_TOKEN;
+            }
+            *length = 1;
+            return GREAT_TOKEN;
+        case '2':
+            /* Only a lone 2 directly before '>' redirects standard error. */
+            if (available < 2 || text[1] != '>') {
+                return WORD_TOKEN;
+            }
+            if (available >= 4 && text[2] == '&' && text[3] == '1') {
+                *length = 4;
+                return ERR_TO_OUT_TOKEN;
+            }
+            *length = 2;
+            return ERR_GREAT_TOKEN;
     }
+    return WORD_TOKEN;
 }
 
-Token get_token(CharItr *char_itr)
+size_t Scanner_substitution(const char *text, size_t available, bool *closed)
 {
-    char *token = malloc(2000 * sizeof(char));
-    int k = 0;
-    while (CharItr_has_next(char_itr)) {
-        char tok = CharItr_next(char_itr);
-        if (tok == EOF) {
-            Token pipe = {
-                PIPE_TOKEN,
-                Str_from("")
-            };
-            free(token);
-            return pipe;
+    *closed = true;
+    if (available >= 1 && text[0] == '`') {
+        const char *end = memchr(text + 1, '`', available - 1);
+        if (end != NULL) {
+            return end - text + 1;
         }
-        if (tok == '|') {
-            Token pipe = {
-                PIPE_TOKEN,
-                Str_from("|")
-            };
-            free(token);
-            return pipe;
+        *closed = false;
+        return available;
+    }
+    if (available < 2 || text[0] != '$' || text[1] != '(') {
+        return 0;
+    }
+    size_t depth = 1;
+    for (size_t i = 2; i < available; ++i) {
+        if (text[i] == '(') {
+            ++depth;
+        } else if (text[i] == ')' && --depth == 0) {
+            return i + 1;
         }
-        if (tok == ' ' || tok == '\t' || tok == '\n' || tok == '\0') {
-            if (k == 0) {
-                continue;
-            }
-            Token pipe = { 
-                WORD_TOKEN,
-                Str_from(token)
-            };
-            free(token);
-            return pipe;
+    }
+    *closed = false;
+    return available;
+}
+
+static bool is_name_start(char c)
+{
+    return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool is_name_char(char c)
+{
+    return is_name_start(c) || (c >= '0' && c <= '9');
+}
+
+size_t Scanner_variable(const char *text, size_t available, size_t *name, size_t *name_length)
+{
+    if (available < 2 || text[0] != '$') {
+        return 0;
+    }
+    bool braced = text[1] == '{';
+    size_t start = braced ? 2 : 1;
+    if (start >= available || !is_name_start(text[start])) {
+        return 0;
+    }
+    size_t end = start + 1;
+    while (end < available && is_name_char(text[end])) {
+        ++end;
+    }
+    if (braced && (end >= available || text[end] != '}')) {
+        return 0;
+    }
+    *name = start;
+    *name_length = end - start;
+    return braced ? end + 1 : end;
+}
+
+/* Advance past a word, and any command substitutions within it. */
+static void skip_word(CharItr *char_itr)
+{
+    while (true) {
+        CharItr_take_until(char_itr, CHAR_SPACE | CHAR_OPERATOR | CHAR_DOLLAR);
+        if (!CharItr_has_next(char_itr) || !(CharItr_class(CharItr_peek(char_itr)) & CHAR_DOLLAR)) {
+            return;
+        }
+        bool closed;
+        const char *cursor = CharItr_cursor(char_itr);
+        size_t length = Scanner_substitution(cursor, char_itr->sentinel - cursor, &closed);
+        CharItr_advance(char_itr, length > 0 ? length : 1);
+    }
+}
+
+Token Scanner_lex(CharItr *char_itr, const char *source)
+{
+    const char *cursor = CharItr_cursor(char_itr);
+    uint8_t flags = 0;
+    if (cursor == source || (CharItr_class(cursor[-1]) & CHAR_SPACE)) {
+        flags |= TOKEN_SPACE_BEFORE;
+    }
+    if (cursor == source || cursor[-1] == '\n') {
+        flags |= TOKEN_LINE_START;
+    }
+    size_t skipped = CharItr_skip_while(char_itr, CHAR_SPACE);
+    if (skipped != 0) {
+        flags |= TOKEN_SPACE_BEFORE;
+        if (memchr(cursor, '\n', skipped) != NULL) {
+            flags |= TOKEN_LINE_START;
         }
-        token[k] = tok;
-        k++;
-        if (!CharItr_has_next(char_itr)) {
-            Token pipe = {
-                WORD_TOKEN,
-                Str_from(token)
-            };
-            free(token);
-            return pipe;
+    }
+
+    const char *start = CharItr_cursor(char_itr);
+    TokenType type = END_TOKEN;
+    if (CharItr_has_next(char_itr)) {
+        size_t length;
+        type = Scanner_operator(start, char_itr->sentinel - start, &length);
+        if (type == WORD_TOKEN) {
+            skip_word(char_itr);
+        } else {
+            CharItr_advance(char_itr, length);
         }
     }
-    free(token);
-    Token pipe = {
-        END_TOKEN,
-        Str_from("")
-    };
-    return pipe;
+
+    size_t offset = start - source;
+    size_t length = CharItr_cursor(char_itr) - start;
+    if (offset + length > UINT32_MAX) {
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
+    }
+    Token token = { type, flags, offset, length };
+    return token;
 }
@@ -0,0 +1,525 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Guards.h"
+#include "Hash.h"
+#include "Scanner.h"
+#include "ScriptCache.h"
+#include "Vec.h"
+
+/* Bumped whenever the encoding of trees changes. */
+#define SCRIPT_CACHE_VERSION 1
+
+/* Deepest nesting of trees decoded, so damage cannot exhaust the stack. */
+#define MAX_DEPTH (1 << 12)
+
+/* Marks the length of a missing redirect target, as of 2>&1. */
+#define NO_TARGET UINT32_MAX
+
+const char *SCRIPT_CACHE_CORRUPT = "The script cache file is damaged";
+
+static const char MAGIC[8] = "THSHSC\0";
+
+/*
+ * The start of every cache file. The lines follow it, each the record
+ * of its tree, which is its type followed by:
+ *
+ *   COMMAND     counts of words, redirects and substitutions, each
+ *               word's length and bytes, each redirect's type, target
+ *               length and bytes, and each substitution's word, start,
+ *               length and whether a tree's record follows it
+ *   PIPE, lists the record of the left subtree, then the right's
+ *   BACKGROUND  the record of the pipeline
+ *   FOR, WHILE  the record of the head, then the body's
+ *   ERROR       the message's length and bytes, null terminated
+ *
+ * Types, counts and lengths are all uint32_t, unaligned.
+ */
+typedef struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t lines;
+    uint64_t length; /* of the lines, which end the file */
+    ScriptKey key;
+} FileHeader;
+
+bool ScriptKey_of(int fd, ScriptKey *key)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    key->size = st.st_size;
+    key->mtime_sec = st.st_mtim.tv_sec;
+    key->mtime_nsec = st.st_mtim.tv_nsec;
+    if (st.st_size == 0) {
+        key->hash = Hash_bytes(NULL, 0);
+        return true;
+    }
+    char *bytes = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (bytes == MAP_FAILED) {
+        return false;
+    }
+    key->hash = Hash_bytes(bytes, st.st_size);
+    munmap(bytes, st.st_size);
+    return true;
+}
+
+/*
+ * Sets `path` to the cache file in `dir` for the script at `source`:
+ * its canonical path hashed, in hex, so that a script keeps one file
+ * however often it changes. Returns false, setting nothing, if
+ * `source` cannot be resolved.
+ */
+static bool file_path(const char *dir, const char *source, Str *path)
+{
+    char *canonical = realpath(source, NULL);
+    if (canonical == NULL) {
+        return false;
+    }
+    char name[32];
+    uint64_t hash = Hash_bytes(canonical, strlen(canonical));
+    snprintf(name, sizeof(name), "/%016" PRIx64 ".thc", hash);
+    free(canonical);
+    *path = Str_from(dir);
+    Str_append(path, name);
+    return true;
+}
+
+/** ENCODING **/
+
+ScriptEncoder ScriptEncoder_value(void)
+{
+    return (ScriptEncoder) { Str_value(1 << 12), 0 };
+}
+
+void ScriptEncoder_drop(ScriptEncoder *self)
+{
+    Str_drop(&self->bytes);
+}
+
+static void put(Str *out, uint32_t value)
+{
+    Str_splice(out, Str_length(out), 0, (const char*) &value, sizeof(value));
+}
+
+static void put_bytes(Str *out, const char *bytes, size_t length)
+{
+    put(out, length);
+    Str_splice(out, Str_length(out), 0, bytes, length);
+}
+
+static void encode(Str *out, const Node *node);
+
+static void encode_command(Str *out, const CommandValue *command)
+{
+    put(out, Command_length(command));
+    put(out, Command_redirect_count(command));
+    put(out, Command_substitution_count(command));
+    for (size_t i = 0; i < Command_length(command); ++i) {
+        const char *word = Command_word(command, i);
+        put_bytes(out, word, strlen(word));
+    }
+    const Redirect *redirects = Command_redirects(command);
+    for (size_t i = 0; i < Command_redirect_count(command); ++i) {
+        put(out, redirects[i].type);
+        if (redirects[i].target == NULL) {
+            put(out, NO_TARGET);
+        } else {
+            put_bytes(out, redirects[i].target, strlen(redirects[i].target));
+        }
+    }
+    const Substitution *substitutions = Command_substitutions(command);
+    for (size_t i = 0; i < Command_substitution_count(command); ++i) {
+        put(out, substitutions[i].word);
+        put(out, substitutions[i].start);
+        put(out, substitutions[i].length);
+        put(out, substitutions[i].tree != NULL);
+        if (substitutions[i].tree != NULL) {
+            encode(out, substitutions[i].tree);
+        }
+    }
+}
+
+static bool is_binary(NodeType type)
+{
+    return type == PIPE_NODE || type == SEQUENCE_NODE || type == AND_NODE || type == OR_NODE;
+}
+
+static void encode(Str *out, const Node *node)
+{
+    /* Right spines may be long, so are walked rather than recursed. */
+    while (is_binary(node->type)) {
+        put(out, node->type);
+        encode(out, node->data.pipe.left);
+        node = node->type == PIPE_NODE ? node->data.pipe.right : node->data.list.right;
+    }
+    put(out, node->type);
+    switch (node->type) {
+        case COMMAND_NODE:
+            encode_command(out, &node->data.command);
+            break;
+        case BACKGROUND_NODE:
+            encode(out, node->data.background.pipeline);
+            break;
+        case FOR_NODE:
+        case WHILE_NODE:
+            encode(out, node->data.loop.head);
+            encode(out, node->data.loop.body);
+            break;
+        case ERROR_NODE:
+            put_bytes(out, node->data.error, strlen(node->data.error) + 1);
+            break;
+        default:
+            break;
+    }
+}
+
+void ScriptEncoder_add(ScriptEncoder *self, const Node *tree)
+{
+    encode(&self->bytes, tree);
+    ++self->lines;
+}
+
+static bool write_all(int fd, const char *bytes, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = write(fd, bytes, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+/* Create `dir` and any of its parents that are missing. */
+static void make_dirs(const char *dir)
+{
+    Str path = Str_from(dir);
+    for (size_t i = 1; i < Str_length(&path); ++i) {
+        if (Str_get(&path, i) == '/') {
+            *Str_ref(&path, i) = '\0';
+            mkdir(Str_cstr(&path), 0700);
+            *Str_ref(&path, i) = '/';
+        }
+    }
+    mkdir(dir, 0700);
+    Str_drop(&path);
+}
+
+bool ScriptEncoder_save(const ScriptEncoder *self, const char *dir, const char *source,
+        const ScriptKey *key)
+{
+    Str path;
+    if (!file_path(dir, source, &path)) {
+        return false;
+    }
+    make_dirs(dir);
+    Str temporary = Str_from(dir);
+    Str_append(&temporary, "/.thc-XXXXXX");
+    int fd = mkstemp(Str_ref(&temporary, 0));
+    if (fd < 0) {
+        Str_drop(&temporary);
+        Str_drop(&path);
+        return false;
+    }
+    FileHeader header = {
+        { 0 }, SCRIPT_CACHE_VERSION, self->lines, Str_length(&self->bytes), *key
+    };
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    bool saved = write_all(fd, (const char*) &header, sizeof(header))
+            && write_all(fd, Str_cstr(&self->bytes), Str_length(&self->bytes));
+    saved = close(fd) == 0 && saved;
+    saved = saved && rename(Str_cstr(&temporary), Str_cstr(&path)) == 0;
+    if (!saved) {
+        unlink(Str_cstr(&temporary));
+    }
+    Str_drop(&path);
+    Str_drop(&temporary);
+    return saved;
+}
+
+/** DECODING **/
+
+bool CachedScript_open(CachedScript *self, const char *dir, const char *source,
+        const ScriptKey *key)
+{
+    Str path;
+    if (!file_path(dir, source, &path)) {
+        return false;
+    }
+    int fd = open(Str_cstr(&path), O_RDONLY | O_CLOEXEC);
+    Str_drop(&path);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    self->map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(FileHeader)) {
+        self->size = st.st_size;
+        self->map = mmap(NULL, self->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (self->map == MAP_FAILED) {
+        return false;
+    }
+    FileHeader header;
+    memcpy(&header, self->map, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.version != SCRIPT_CACHE_VERSION
+            || header.length != self->size - sizeof(header)
+            || memcmp(&header.key, key, sizeof(*key)) != 0) {
+        munmap(self->map, self->size);
+        return false;
+    }
+    madvise(self->map, self->size, MADV_SEQUENTIAL);
+    self->cursor = sizeof(header);
+    self->remaining = header.lines;
+    return true;
+}
+
+void CachedScript_drop(CachedScript *self)
+{
+    munmap(self->map, self->size);
+}
+
+/* Reads from a mapping, failing rather than reading past its end. */
+typedef struct Reader {
+    const char *map;
+    size_t size;
+    size_t cursor;
+    bool ok;
+    size_t depth; /* of the tree being decoded */
+    const Allocator *allocator;
+} Reader;
+
+static uint32_t get(Reader *reader)
+{
+    uint32_t value = 0;
+    if (reader->ok && reader->size - reader->cursor >= sizeof(value)) {
+        memcpy(&value, reader->map + reader->cursor, sizeof(value));
+        reader->cursor += sizeof(value);
+    } else {
+        reader->ok = false;
+    }
+    return value;
+}
+
+/* The next `length` bytes, in place. */
+static CharSpan get_bytes(Reader *reader, uint32_t length)
+{
+    CharSpan span = { reader->map + reader->cursor, 0 };
+    if (reader->ok && reader->size - reader->cursor >= length) {
+        span.length = length;
+        reader->cursor += length;
+    } else {
+        reader->ok = false;
+    }
+    return span;
+}
+
+static Node* decode(Reader *reader);
+
+static Node* decode_command(Reader *reader)
+{
+    uint32_t count = get(reader);
+    uint32_t redirect_count = get(reader);
+    uint32_t substitution_count = get(reader);
+    /* Every word, redirect and substitution takes at least 4 bytes. */
+    if (!reader->ok || count == 0 || (uint64_t) count + redirect_count + substitution_count
+            > (reader->size - reader->cursor) / sizeof(uint32_t)) {
+        reader->ok = false;
+        return NULL;
+    }
+    /* The constructor copies what it needs, so one scratch block holds all three. */
+    size_t scratch_size = count * sizeof(CharSpan) + redirect_count * sizeof(RedirectSpan)
+            + substitution_count * sizeof(Substitution);
+    char *scratch = Allocator_alloc(reader->allocator, scratch_size);
+    ALLOC_GUARD(scratch, NULL, scratch_size, __FILE__, __LINE__);
+    Substitution *substitutions = (Substitution*) scratch;
+    CharSpan *words = (CharSpan*) (substitutions + substitution_count);
+    RedirectSpan *redirects = (RedirectSpan*) (words + count);
+    for (uint32_t i = 0; i < count; ++i) {
+        words[i] = get_bytes(reader, get(reader));
+    }
+    for (uint32_t i = 0; i < redirect_count; ++i) {
+        RedirectSpan *redirect = &redirects[i];
+        redirect->type = get(reader);
+        uint32_t length = get(reader);
+        if (length != NO_TARGET) {
+            redirect->target = get_bytes(reader, length);
+        }
+        if (redirect->type > REDIRECT_ERR_TO_OUT
+                || (length == NO_TARGET) != (redirect->type == REDIRECT_ERR_TO_OUT)) {
+            reader->ok = false;
+        }
+    }
+    uint32_t decoded = 0;
+    /* Where the substitution before ends, as the parser orders them. */
+    uint64_t after = 0;
+    for (; decoded < substitution_count && reader->ok; ++decoded) {
+        Substitution *substitution = &substitutions[decoded];
+        substitution->word = get(reader);
+        substitution->start = get(reader);
+        substitution->length = get(reader);
+        substitution->tree = NULL;
+        bool has_tree = get(reader) != 0;
+        uint64_t at = (uint64_t) substitution->word << 32 | substitution->start;
+        /*
+         * Exec reads a substitution's text within its word, and takes
+         * one without a tree to be exactly a variable.
+         */
+        if (substitution->word >= count || at < after || substitution->length == 0
+                || (uint64_t) substitution->start + substitution->length
+                    > words[substitution->word].length) {
+            reader->ok = false;
+        } else if (!has_tree) {
+            size_t name, name_length;
+            const char *text = words[substitution->word].start + substitution->start;
+            if (Scanner_variable(text, substitution->length, &name, &name_length)
+                    != substitution->length) {
+                reader->ok = false;
+            }
+        }
+        after = at + substitution->length;
+        if (has_tree && reader->ok) {
+            substitution->tree = decode(reader);
+        }
+    }
+    Node *node = NULL;
+    if (reader->ok) {
+        node = CommandNode_new_with(words, count, redirects, redirect_count,
+                substitutions, substitution_count, reader->allocator);
+    } else {
+        for (uint32_t i = 0; i < decoded; ++i) {
+            if (substitutions[i].tree != NULL) {
+                Node_drop(substitutions[i].tree);
+            }
+        }
+    }
+    Allocator_free(reader->allocator, scratch, scratch_size);
+    return node;
+}
+
+/* A node of a right spine whose right subtree is not yet decoded. */
+typedef struct SpineNode {
+    NodeType type;
+    Node *left;
+} SpineNode;
+
+/* Decode a leaf, or anything but a spine of binary nodes. */
+static Node* decode_leaf(Reader *reader, NodeType type)
+{
+    switch (type) {
+        case COMMAND_NODE:
+            return decode_command(reader);
+        case BACKGROUND_NODE: {
+            Node *pipeline = decode(reader);
+            return pipeline != NULL ? BackgroundNode_new_with(pipeline, reader->allocator) : NULL;
+        }
+        case FOR_NODE:
+        case WHILE_NODE: {
+            Node *head = decode(reader);
+            Node *body = head != NULL ? decode(reader) : NULL;
+            if (body == NULL) {
+                if (head != NULL) {
+                    Node_drop(head);
+                }
+                return NULL;
+            }
+            return LoopNode_new_with(type, head, body, reader->allocator);
+        }
+        case ERROR_NODE: {
+            CharSpan message = get_bytes(reader, get(reader));
+            if (!reader->ok || message.length == 0 || message.start[message.length - 1] != '\0') {
+                reader->ok = false;
+                return NULL;
+            }
+            return ErrorNode_new_with(message.start, reader->allocator);
+        }
+        default:
+            reader->ok = false;
+            return NULL;
+    }
+}
+
+/* The next tree, or NULL with `ok` cleared if the bytes are damaged. */
+static Node* decode(Reader *reader)
+{
+    if (++reader->depth > MAX_DEPTH) {
+        reader->ok = false;
+    }
+    Vec spine = Vec_value_with(4, sizeof(SpineNode), reader->allocator);
+    NodeType type = (int32_t) get(reader);
+    while (reader->ok && is_binary(type)) {
+        SpineNode node = { type, decode(reader) };
+        if (node.left == NULL) {
+            break;
+        }
+        Vec_set(&spine, Vec_length(&spine), &node);
+        type = (int32_t) get(reader);
+    }
+    Node *node = reader->ok ? decode_leaf(reader, type) : NULL;
+    for (size_t i = Vec_length(&spine); i-- > 0;) {
+        SpineNode *item = Vec_ref(&spine, i);
+        if (node == NULL) {
+            Node_drop(item->left);
+        } else if (item->type == PIPE_NODE) {
+            node = PipeNode_new_with(item->left, node, reader->allocator);
+        } else {
+            node = ListNode_new_with(item->type, item->left, node, reader->allocator);
+        }
+    }
+    Vec_drop(&spine);
+    --reader->depth;
+    return node;
+}
+
+Node* CachedScript_next(CachedScript *self, const Allocator *allocator)
+{
+    if (self->remaining == 0) {
+        return NULL;
+    }
+    Reader reader = { self->map, self->size, self->cursor, true, 0, allocator };
+    Node *tree = decode(&reader);
+    if (tree == NULL) {
+        self->remaining = 0;
+        return ErrorNode_new_with(SCRIPT_CACHE_CORRUPT, allocator);
+    }
+    self->cursor = reader.cursor;
+    --self->remaining;
+    return tree;
+}
+
+Str ScriptCache_dir(void)
+{
+    const char *dir = getenv("THSH_CACHE_DIR");
+    if (dir != NULL && dir[0] != '\0') {
+        return Str_from(dir);
+    }
+    Str path = Str_value(0);
+    if ((dir = getenv("XDG_CACHE_HOME")) != NULL && dir[0] != '\0') {
+        Str_append(&path, dir);
+    } else if ((dir = getenv("HOME")) != NULL && dir[0] != '\0') {
+        Str_append(&path, dir);
+        Str_append(&path, "/.cache");
+    } else {
+        return path;
+    }
+    Str_append(&path, "/thsh");
+    return path;
+}
@@ -3,14 +3,14 @@
 #include "Str.h"
 #include "Vec.h"
 
-static char NULL_CHAR = '\0';
+static const char NULL_CHAR = '\0';
 
-Str Str_value(size_t capacity)
+Str Str_value_at(size_t capacity, const Allocator *allocator, const char *file, int line)
 {
-    Str s = Vec_value(capacity + 1, sizeof(char));
+    Str s = Vec_value_at(capacity + 1, sizeof(char), allocator, file, line);
     // TODO: Replace the below lines with a call below to Vec_set
     // once you have Vec_set correctly implemented
-    Vec_set(&s, 0, &NULL_CHAR);
+    Vec_set_at(&s, 0, &NULL_CHAR, file, line);
     return s;
 }
 
@@ -34,9 +34,8 @@ char* Str_ref(const Str *self, const size_t index)
     return (char*) Vec_ref(self, index);
 }
 
-Str Str_from(const char *cstr) 
+Str Str_from_at(const char *cstr, const Allocator *allocator, const char *file, int line)
 {
-
     size_t i = 0;
     size_t capacity = 0;
     while (cstr[i] != NULL_CHAR)
@@ -44,23 +43,34 @@ Str Str_from(const char *cstr)
         ++capacity;
         ++i;
     }
-    Str s = Str_value(capacity);
+    Str s = Str_value_at(capacity, allocator, file, line);
     s.length = i + 1;
     memcpy(s.buffer, cstr, sizeof(char) * s.capacity);
     return s;
 }
 
-void Str_splice(
+void Str_splice_at(
         Str *self, 
         size_t index,
         size_t delete_count, 
         const char* cstr, 
-        size_t insert_count)
+        size_t insert_count,
+        const char *file,
+        int line)
 {
-    Vec_splice(self, index, delete_count, (void*) cstr, insert_count);
+    /*
+     * Grow geometrically so that building a Str by repeated appends
+     * copies each char a constant number of times on average.
+     */
+    size_t needed = self->length + insert_count - delete_count;
+    if (needed > self->capacity) {
+        Vec_reserve_at(self, needed > self->capacity * 2 ? needed : self->capacity * 2,
+                file, line);
+    }
+    Vec_splice_at(self, index, delete_count, (void*) cstr, insert_count, file, line);
 }
 
-void Str_append(Str *self, const char *cstr)
+void Str_append_at(Str *self, const char *cstr, const char *file, int line)
 {
     size_t capacity = 0;
     size_t i = 0;
@@ -68,7 +78,7 @@ void Str_append(Str *self, const char *cstr)
         ++capacity;
         ++i;
     }
-    Str_splice(self, Str_length(self), (size_t)0, cstr, capacity);
+    Str_splice_at(self, Str_length(self), (size_t)0, cstr, capacity, file, line);
 }
 
 char Str_get(const Str *self, size_t index)
@@ -83,8 +93,8 @@ char Str_get(const Str *self, size_t index)
     
 }
 
-void Str_set(Str *self, size_t index, const char value) 
+void Str_set_at(Str *self, size_t index, const char value, const char *file, int line)
 {
     const void *out = &value;
-    Vec_set(self, index, out);
+    Vec_set_at(self, index, out, file, line);
 }
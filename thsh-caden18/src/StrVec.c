@@ -3,7 +3,12 @@
 
 StrVec StrVec_value(size_t capacity)
 {
-    return Vec_value(capacity, sizeof(Str));
+    return StrVec_value_with(capacity, &LIBC_ALLOCATOR);
+}
+
+StrVec StrVec_value_with(size_t capacity, const Allocator *allocator)
+{
+    return Vec_value_with(capacity, sizeof(Str), allocator);
 }
 
 size_t StrVec_length(const StrVec *self)
@@ -6,23 +6,27 @@
 
 #include "Vec.h"
 
+static void ensure_capacity(Vec *self, size_t n, const char *file, int line);
+
 /* Constructor / Destructor */
 
-Vec Vec_value(size_t capacity, size_t item_size)
+Vec Vec_value_at(size_t capacity, size_t item_size, const Allocator *allocator,
+        const char *file, int line)
 {
     Vec vec = {
         item_size,
         0,
         capacity,
-        calloc(capacity, item_size)
+        Allocator_alloc(allocator, capacity * item_size),
+        allocator
     };
-    OOM_GUARD(vec.buffer, __FILE__, __LINE__);
+    ALLOC_GUARD(vec.buffer, NULL, capacity * item_size, file, line);
     return vec;
 }
 
 void Vec_drop(Vec *self)
 {
-    free(self->buffer);
+    Allocator_free(self->allocator, self->buffer, self->capacity * self->item_size);
     self->buffer = NULL;
     self->capacity = 0;
     self->length = 0;
@@ -40,8 +44,7 @@ void* Vec_ref(const Vec *self, size_t index)
     if (index < self->length) {
         return self->buffer + (index * self->item_size);
     } else {
-        fprintf(stderr, "%s:%d - Out of Bounds", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
     }
 }
 
@@ -50,18 +53,16 @@ void Vec_get(const Vec *self, size_t index, void *out)
     memcpy(out, Vec_ref(self, index), self->item_size);
 }
 
-void Vec_set(Vec *self, size_t index, const void *value)
+void Vec_set_at(Vec *self, size_t index, const void *value, const char *file, int line)
 {
-    ensure_capacity(self, index + 1);
     if (index > self->length) {
-        fprintf(stderr, "%s:%d - Out of Bounds", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        PANIC(OUT_OF_BOUNDS, __FILE__, __LINE__);
     }
     if (index == self->length) {
-        Vec_splice(self, index, 0, value, 1);
+        Vec_splice_at(self, index, 0, value, 1, file, line);
         return;
     }
-    Vec_splice(self, index, 1, value, 1);
+    Vec_splice_at(self, index, 1, value, 1, file, line);
 }
 
 bool Vec_equals(const Vec *self, const Vec *other)
@@ -77,18 +78,31 @@ bool Vec_equals(const Vec *self, const Vec *other)
     return true;
 }
 
-void Vec_splice(Vec *self, size_t index, size_t delete_count, const void *items, size_t insert_count)
+void Vec_splice_at(Vec *self, size_t index, size_t delete_count, const void *items,
+        size_t insert_count, const char *file, int line)
 {
-    ensure_capacity(self, self->length + (insert_count - delete_count));
-    memcpy(self->buffer + (index + insert_count) * self->item_size, self->buffer + (index + delete_count) * self->item_size, self->item_size * (self->length - index - delete_count));
+    ensure_capacity(self, self->length + (insert_count - delete_count), file, line);
+    memmove(self->buffer + (index + insert_count) * self->item_size, self->buffer + (index + delete_count) * self->item_size, self->item_size * (self->length - index - delete_count));
     memcpy(self->buffer + (index * self->item_size), items, self->item_size * insert_count);
     self->length += insert_count - delete_count;
 }
 
-static void ensure_capacity(Vec *self, size_t n)
+void Vec_reserve_at(Vec *self, size_t capacity, const char *file, int line)
+{
+    ensure_capacity(self, capacity, file, line);
+}
+
+static void ensure_capacity(Vec *self, size_t n, const char *file, int line)
 {
     if (n > self->capacity) {
-        self->buffer = realloc(self->buffer, n * self->item_size);
+        void *prev = self->buffer;
+        self->buffer = Allocator_realloc(
+                self->allocator,
+                prev,
+                self->capacity * self->item_size,
+                n * self->item_size
+            );
+        ALLOC_GUARD(self->buffer, prev, n * self->item_size, file, line);
+        self->capacity = n;
     }
-
 }
@@ -1,28 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Batch.h"
+#include "Exec.h"
+#include "Guards.h"
+#include "JobTable.h"
+#include "LineReader.h"
+#include "MemStats.h"
+#include "ParseCache.h"
+#include "Parser.h"
+#include "Profile.h"
+#include "Program.h"
+#include "Runner.h"
+#include "ScriptCache.h"
+
+#define PARSE_CACHE_BUDGET (1 << 20)
+#define BATCH_PARSERS 2
+#define BATCH_DEPTH 64
+#define MAX_JOBS 256
+
+static const char *USAGE =
+    "usage: thsh [--batch] [--mem-stats] [--mem-stats-dump=FILE] [--profile]\n"
+    "            [--tree-walk] [--no-script-cache] [-j N] [script ...]\n";
 
-#include "Vec.h"
-#include "Str.h"
+static const char *PROMPT = "thsh$ ";
+static const char *CONTINUATION_PROMPT = "> ";
 
-#define MAX_AMT_OF_LINES 600000
-#define MAXIMUM_LINE_LENGTH 8000
-int main()
+/* Settings controlled by command line flags. */
+typedef struct Options {
+    bool mem_stats;             /* print MemStats report to stderr at exit */
+    const char *mem_stats_dump; /* write MemStats TSV dump to this path */
+    bool profile;               /* print phase latencies to stderr at exit */
+    bool batch;                 /* pipeline reading, parsing and executing */
+    bool tree_walk;             /* execute trees directly, not compiled Programs */
+    bool script_cache;          /* keep scripts' parsed lines in ScriptCache_dir */
+    size_t jobs;                /* scripts run at once by the Runner */
+    const char **scripts;       /* script paths; stdin when there are none */
+    size_t script_count;
+} Options;
+
+static Options parse_options(int argc, char *argv[])
 {
-    Str s = Str_value(MAX_AMT_OF_LINES);
-    char *line;
-    char *copy = malloc(MAXIMUM_LINE_LENGTH);
-    if (copy == NULL) {
-        fprintf(stderr, "Out of memory\n");
-        exit(EXIT_FAILURE);
+    Options options = { false, NULL, false, false, false, true, 1, NULL, 0 };
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--mem-stats") == 0) {
+            options.mem_stats = true;
+        } else if (strncmp(argv[i], "--mem-stats-dump=", 17) == 0) {
+            options.mem_stats_dump = argv[i] + 17;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options.profile = true;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            options.batch = true;
+        } else if (strcmp(argv[i], "--tree-walk") == 0) {
+            options.tree_walk = true;
+        } else if (strcmp(argv[i], "--no-script-cache") == 0) {
+            options.script_cache = false;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            const char *value = argv[++i];
+            char *end;
+            options.jobs = strtoul(value, &end, 10);
+            if (value[0] < '0' || value[0] > '9' || *end != '\0'
+                    || options.jobs < 1 || options.jobs > MAX_JOBS) {
+                fprintf(stderr, "thsh: -j expects a number from 1 to %d, not %s\n%s",
+                        MAX_JOBS, value, USAGE);
+                exit(EXIT_FAILURE);
+            }
+        } else if (argv[i][0] != '-') {
+            options.scripts = (const char**) argv + i;
+            options.script_count = argc - i;
+            break;
+        } else {
+            fprintf(stderr, "thsh: unknown option %s\n%s", argv[i], USAGE);
+            exit(EXIT_FAILURE);
+        }
     }
-    while ((line = fgets(copy, MAXIMUM_LINE_LENGTH, stdin)) != NULL) {
-        Str_append(&s, line);
+    return options;
+}
+
+static void report_profile(const Options *options, const ParseCache *cache)
+{
+    if (options->profile) {
+        Profile_report(stderr);
+        if (!options->batch) {
+            ParseCache_report(cache, stderr);
+        }
     }
-    for (size_t i = 0; i < Str_length(&s); ++i) {
-        printf("%c", Str_get(&s, i));
+}
+
+static void report_memory(const Options *options)
+{
+    if (options->mem_stats) {
+        MemStats_report(stderr);
+    }
+    if (options->mem_stats_dump != NULL) {
+        FILE *out = fopen(options->mem_stats_dump, "w");
+        if (out == NULL) {
+            perror(options->mem_stats_dump);
+            return;
+        }
+        MemStats_dump(out);
+        fclose(out);
+    }
+}
+
+/*
+ * Prompt, then wait until a line can be read from `input`. Background
+ * jobs that finish meanwhile wake the wait, are reported and the prompt
+ * is shown again.
+ */
+static void prompt(const LineReader *input, const char *text, JobTable *jobs)
+{
+    struct pollfd fds[] = {
+        { input->fd, POLLIN, 0 },
+        { JobTable_fd(jobs), POLLIN, 0 }
+    };
+    while (true) {
+        JobTable_poll(jobs, 0);
+        JobTable_notify(jobs, stderr);
+        fputs(text, stdout);
+        fflush(stdout);
+        if (LineReader_buffered(input)) {
+            return;
+        }
+        while (poll(fds, 2, -1) < 0) {
+        }
+        if (fds[0].revents != 0) {
+            return;
+        }
+        fputs("\n", stdout);
+    }
+}
+
+/*
+ * Read, parse and execute one line at a time, prompting first when
+ * input is a terminal. A line ending in '|', '&&' or '||', or within
+ * a loop, is continued on the lines after it. Each tree is compiled to
+ * a Program and run, unless `tree_walk` is set. Returns the status of
+ * the last command.
+ */
+static int run(int input_fd, ParseCache *cache, bool tree_walk)
+{
+    bool interactive = isatty(input_fd);
+    JobTable jobs = JobTable_value(interactive ? input_fd : -1);
+    LineReader input = LineReader_value(input_fd);
+    int status = EXIT_SUCCESS;
+    PushParser continuation = PushParser_value();
+    while (true) {
+        if (interactive) {
+            prompt(&input, PushParser_pending(&continuation) ? CONTINUATION_PROMPT : PROMPT,
+                    &jobs);
+        } else {
+            /* Nobody is told of a script's finished jobs, so they are only removed. */
+            JobTable_poll(&jobs, 0);
+            JobTable_notify(&jobs, NULL);
+        }
+        PROFILE_START(read_timer);
+        size_t length;
+        const char *line = LineReader_next(&input, &length);
+        PROFILE_STOP(read_timer, PHASE_READ);
+
+        Node *ast;
+        if (line == NULL) {
+            ast = PushParser_finish(&continuation);
+        } else if (PushParser_pending(&continuation)) {
+            ast = PushParser_push(&continuation, line, length);
+        } else {
+            ast = ParseCache_parse(cache, line, length);
+            if (parse_incomplete(ast)) {
+                Node_drop(ast);
+                ast = PushParser_push(&continuation, line, length);
+            }
+        }
+
+        if (ast != NULL) {
+            if (ast->type != ERROR_NODE || ast->data.error != PARSE_EMPTY_INPUT) {
+                /* Commands reading the script's input start after this line. */
+                LineReader_sync(&input);
+                if (tree_walk) {
+                    status = execute_with(ast, input_fd, STDOUT_FILENO, &jobs);
+                } else {
+                    Program program = Program_compile(ast);
+                    status = Program_run(&program, input_fd, STDOUT_FILENO, &jobs);
+                    Program_drop(&program);
+                }
+            }
+            Node_drop(ast);
+        }
+        if (line == NULL) {
+            break;
+        }
+    }
+    LineReader_drop(&input);
+    PushParser_drop(&continuation);
+    JobTable_drop(&jobs);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    Options options = parse_options(argc, argv);
+    if (options.mem_stats || options.mem_stats_dump != NULL) {
+        MemStats_enable();
+    }
+    if (options.profile) {
+        Profile_enable();
+    }
+
+    ParseCache cache = ParseCache_value(PARSE_CACHE_BUDGET);
+    int status;
+    if (options.script_count > 0) {
+        int *statuses = calloc(options.script_count, sizeof(int));
+        OOM_GUARD(statuses, __FILE__, __LINE__);
+        Str cache_dir = options.script_cache ? ScriptCache_dir() : Str_value(0);
+        status = Runner_run(options.scripts, options.script_count, options.jobs,
+                STDOUT_FILENO, statuses,
+                Str_length(&cache_dir) > 0 ? Str_cstr(&cache_dir) : NULL);
+        Str_drop(&cache_dir);
+        free(statuses);
+    } else if (options.batch) {
+        BatchOptions batch = { BATCH_PARSERS, BATCH_DEPTH };
+        status = Batch_run(stdin, STDOUT_FILENO, batch);
+    } else {
+        status = run(STDIN_FILENO, &cache, options.tree_walk);
     }
-    printf("\n");
-    
 
-    return EXIT_SUCCESS;
+    report_profile(&options, &cache);
+    ParseCache_drop(&cache);
+    report_memory(&options);
+    return status;
 }
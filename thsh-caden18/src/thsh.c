@@ -0,0 +1,75 @@
+#include "Guards.h"
+#include "Parser.h"
+#include "thsh.h"
+
+static const char *STATUS_MESSAGES[] = {
+    "ok",
+    "empty input",
+    "syntax error",
+    "input too large",
+    "out of memory",
+    "internal error"
+};
+
+const char* thsh_status_message(thsh_status status)
+{
+    return STATUS_MESSAGES[status];
+}
+
+static thsh_status fail(thsh_result *result, thsh_status status, const char *error)
+{
+    result->status = status;
+    result->tree = NULL;
+    result->error = error;
+    return status;
+}
+
+thsh_status thsh_parse(
+        const char *input,
+        size_t length,
+        const thsh_options *options,
+        Arena *arena,
+        thsh_result *result)
+{
+    thsh_options none = { 0, 0 };
+    if (options == NULL) {
+        options = &none;
+    }
+    if (options->max_input != 0 && length > options->max_input) {
+        return fail(result, THSH_TOO_LARGE, thsh_status_message(THSH_TOO_LARGE));
+    }
+
+    /* Bound this call's allocations on top of what the Arena holds. */
+    size_t limit = arena->limit;
+    if (options->max_memory != 0) {
+        Arena_set_limit(arena, arena->allocated + options->max_memory);
+    }
+
+    Recovery recovery;
+    Recovery_begin(&recovery);
+    if (setjmp(recovery.env) != 0) {
+        Recovery_end(&recovery);
+        Arena_set_limit(arena, limit);
+        if (recovery.message == OUT_OF_MEMORY) {
+            return fail(result, THSH_NO_MEMORY, thsh_status_message(THSH_NO_MEMORY));
+        }
+        return fail(result, THSH_INTERNAL_ERROR, recovery.message);
+    }
+
+    Scanner scanner = Scanner_value_with(CharItr_value(input, length), Arena_allocator(arena));
+    Node *tree = parse(&scanner);
+
+    Recovery_end(&recovery);
+    Arena_set_limit(arena, limit);
+
+    if (tree->type == ERROR_NODE) {
+        if (tree->data.error == PARSE_EMPTY_INPUT) {
+            return fail(result, THSH_EMPTY, thsh_status_message(THSH_EMPTY));
+        }
+        return fail(result, THSH_SYNTAX_ERROR, tree->data.error);
+    }
+    result->status = THSH_OK;
+    result->tree = tree;
+    result->error = NULL;
+    return THSH_OK;
+}
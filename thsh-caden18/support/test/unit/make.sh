@@ -57,7 +57,7 @@ init() {
 # run it when there's a new test file entirely.
 sync_cmake() {
     test_makefile="${build_dir}/Makefile"
-    tests=$(ls $unit_tests_dir)
+    tests=$(cd "${unit_tests_dir}" && ls *.cpp)
 
     if [ -f "${test_makefile}" ]; then
         rebuild="false"
@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "Allocator.h"
+#include "Str.h"
+#include "StrVec.h"
+#include "Parser.h"
+}
+
+/**
+ * A libc-backed Allocator that counts the bytes it has outstanding.
+ */
+static void* counting_alloc(void *ctx, size_t size)
+{
+    *(size_t*) ctx += size;
+    return calloc(1, size);
+}
+
+static void* counting_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    *(size_t*) ctx += new_size - old_size;
+    return realloc(ptr, new_size);
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size)
+{
+    *(size_t*) ctx -= size;
+    free(ptr);
+}
+
+static Allocator counting_allocator(size_t *live)
+{
+    Allocator a = { counting_alloc, counting_realloc, counting_free, live };
+    return a;
+}
+
+TEST(AllocatorSpec, vec_uses_allocator)
+{
+    size_t live = 0;
+    Allocator a = counting_allocator(&live);
+    Vec v = Vec_value_with(2, sizeof(int), &a);
+    ASSERT_EQ(2 * sizeof(int), live);
+    int x = 7;
+    Vec_set(&v, 0, &x);
+    Vec_set(&v, 1, &x);
+    Vec_set(&v, 2, &x);
+    ASSERT_EQ(3 * sizeof(int), live);
+    Vec_drop(&v);
+    ASSERT_EQ(0, live);
+}
+
+TEST(AllocatorSpec, str_and_strvec_use_allocator)
+{
+    size_t live = 0;
+    Allocator a = counting_allocator(&live);
+    StrVec words = StrVec_value_with(1, &a);
+    StrVec_push(&words, Str_from_with("hello", &a));
+    StrVec_push(&words, Str_from_with("world", &a));
+    ASSERT_STREQ("world", Str_cstr(StrVec_ref(&words, 1)));
+    ASSERT_LT(0, live);
+    StrVec_drop(&words);
+    ASSERT_EQ(0, live);
+}
+
+TEST(AllocatorSpec, parse_tree_uses_scanner_allocator)
+{
+    size_t live = 0;
+    Allocator a = counting_allocator(&live);
+    Str input = Str_from("ls -lah | grep foo | wc -l");
+    Scanner scanner = Scanner_value_with(CharItr_of_Str(&input), &a);
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(PIPE_NODE, ast->type);
+    Node_drop(ast);
+    ASSERT_EQ(0, live);
+    Str_drop(&input);
+}
+
+TEST(AllocatorSpec, arena_backs_parse)
+{
+    Arena arena = Arena_value(256);
+    Str input = Str_from("cat a b c d e f | sort");
+    Scanner scanner = Scanner_value_with(CharItr_of_Str(&input), Arena_allocator(&arena));
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(PIPE_NODE, ast->type);
+    Node *lhs = ast->data.pipe.left;
+    ASSERT_STREQ("f", Command_word(&lhs->data.command, 6));
+    Arena_drop(&arena);
+    ASSERT_EQ(nullptr, arena.head);
+    Str_drop(&input);
+}
+
+TEST(AllocatorSpec, arena_realloc_in_place)
+{
+    Arena arena = Arena_value(1024);
+    const Allocator *a = Arena_allocator(&arena);
+    void *p = Allocator_alloc(a, 16);
+    void *q = Allocator_realloc(a, p, 16, 64);
+    ASSERT_EQ(p, q);
+    Allocator_alloc(a, 16);
+    void *r = Allocator_realloc(a, q, 64, 128);
+    ASSERT_NE(q, r);
+    Arena_drop(&arena);
+}
@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "CharItr.h"
+}
+
+static CharItr fixture(const char *cstr)
+{
+    return CharItr_value(cstr, strlen(cstr));
+}
+
+TEST(CharItrSpec, skip_while)
+{
+    CharItr itr = fixture(" \t\n ls");
+    ASSERT_EQ(4, CharItr_skip_while(&itr, CHAR_SPACE));
+    ASSERT_EQ('l', CharItr_peek(&itr));
+    ASSERT_EQ(0, CharItr_skip_while(&itr, CHAR_SPACE));
+    ASSERT_EQ(2, CharItr_take_until(&itr, CHAR_SPACE).length);
+    ASSERT_FALSE(CharItr_has_next(&itr));
+    ASSERT_EQ(0, CharItr_skip_while(&itr, CHAR_SPACE));
+}
+
+TEST(CharItrSpec, take_until)
+{
+    CharItr itr = fixture("grep|wc -l");
+    CharSpan word = CharItr_take_until(&itr, CHAR_SPACE | CHAR_OPERATOR);
+    ASSERT_EQ(std::string("grep"), std::string(word.start, word.length));
+    ASSERT_EQ('|', CharItr_peek(&itr));
+    ASSERT_EQ(0, CharItr_take_until(&itr, CHAR_OPERATOR).length);
+    CharItr_advance(&itr, 1);
+    word = CharItr_take_until(&itr, CHAR_OPERATOR);
+    ASSERT_EQ(std::string("wc -l"), std::string(word.start, word.length));
+    ASSERT_FALSE(CharItr_has_next(&itr));
+}
+
+TEST(CharItrSpec, find)
+{
+    CharItr itr = fixture("a\nb\n");
+    ASSERT_TRUE(CharItr_find(&itr, '\n'));
+    ASSERT_EQ('\n', CharItr_next(&itr));
+    ASSERT_TRUE(CharItr_find(&itr, '\n'));
+    CharItr_advance(&itr, 1);
+    ASSERT_FALSE(CharItr_find(&itr, '\n'));
+    ASSERT_FALSE(CharItr_has_next(&itr));
+}
+
+TEST(CharItrSpec, classes_include_nul)
+{
+    const char input[] = { 'a', '\0', 'b' };
+    CharItr itr = CharItr_value(input, 3);
+    ASSERT_EQ(1, CharItr_take_until(&itr, CHAR_SPACE).length);
+    ASSERT_EQ(1, CharItr_skip_while(&itr, CHAR_SPACE));
+    ASSERT_EQ(CHAR_OPERATOR, CharItr_class('|'));
+    ASSERT_EQ(0, CharItr_class('\xff'));
+}
+
+TEST(CharItrSpec, advance_death)
+{
+    CharItr itr = fixture("ab");
+    CharItr_advance(&itr, 2);
+    ASSERT_DEATH({
+            CharItr_advance(&itr, 1);
+            }, ".* - Out of Bounds");
+}
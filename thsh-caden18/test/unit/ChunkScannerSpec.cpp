@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "ChunkScanner.h"
+#include "Rescan.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+/*
+ * Scan `input` with a ChunkScanner reading `chunk_size` bytes at a
+ * time and check every token against the contiguous scanner.
+ */
+static void ASSERT_MATCHES_CONTIGUOUS(const std::string &input, size_t chunk_size)
+{
+    TokenSpans expect = TokenSpans_scan(input.data(), input.size());
+    /* fmemopen may refuse an empty buffer. */
+    FILE *stream = input.empty()
+        ? fopen("/dev/null", "r")
+        : fmemopen((void*) input.data(), input.size(), "r");
+    ChunkScanner scanner = ChunkScanner_value(stream, chunk_size);
+    for (size_t i = 0; i < Vec_length(&expect); ++i) {
+        Token *e = (Token*) Vec_ref(&expect, i);
+        ChunkToken a = ChunkScanner_next(&scanner);
+        ASSERT_EQ(e->type, a.type) << "token " << i << " chunk " << chunk_size;
+        ASSERT_EQ(e->flags, a.flags) << "token " << i << " chunk " << chunk_size;
+        ASSERT_EQ(e->offset, a.offset) << "token " << i << " chunk " << chunk_size;
+        ASSERT_EQ(std::string(Token_lexeme(*e, input.data()), e->length),
+                std::string(a.lexeme.start, a.lexeme.length));
+    }
+    ASSERT_EQ(END_TOKEN, ChunkScanner_next(&scanner).type);
+    ASSERT_EQ(END_TOKEN, ChunkScanner_next(&scanner).type);
+    ChunkScanner_drop(&scanner);
+    fclose(stream);
+    Vec_drop(&expect);
+}
+
+/** TESTS **/
+
+TEST(ChunkScannerSpec, empty_input)
+{
+    ASSERT_MATCHES_CONTIGUOUS("", 1);
+    ASSERT_MATCHES_CONTIGUOUS(" \n\t ", 2);
+}
+
+TEST(ChunkScannerSpec, tokens_straddle_chunks)
+{
+    std::string input = "ls -lah /var/log | grep -e error|sort\n  uniq -c ";
+    for (size_t chunk_size = 1; chunk_size <= input.size() + 1; ++chunk_size) {
+        ASSERT_MATCHES_CONTIGUOUS(input, chunk_size);
+    }
+}
+
+TEST(ChunkScannerSpec, word_longer_than_chunks)
+{
+    std::string input = "echo " + std::string(10000, 'x') + " | wc -c";
+    ASSERT_MATCHES_CONTIGUOUS(input, 1);
+    ASSERT_MATCHES_CONTIGUOUS(input, 64);
+}
+
+TEST(ChunkScannerSpec, substitutions_straddle_chunks)
+{
+    std::string input = "echo $(ls | wc -l) done\necho `a\nb | c`x$(a $(b) c) $y $\n$(open";
+    for (size_t chunk_size = 1; chunk_size <= input.size() + 1; ++chunk_size) {
+        ASSERT_MATCHES_CONTIGUOUS(input, chunk_size);
+    }
+}
+
+TEST(ChunkScannerSpec, random_input_matches_contiguous)
+{
+    const char alphabet[] = "ab |\t\n2>&1<$()`";
+    srand(39);
+    for (int round = 0; round < 200; ++round) {
+        std::string input;
+        size_t length = rand() % 200;
+        for (size_t i = 0; i < length; ++i) {
+            input += alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        size_t chunk_sizes[] = { 1, 2, 3, 7, 16, 4096 };
+        for (size_t chunk_size : chunk_sizes) {
+            ASSERT_MATCHES_CONTIGUOUS(input, chunk_size);
+        }
+    }
+}
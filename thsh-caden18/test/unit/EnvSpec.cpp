@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "Env.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static std::string get(Env *env, const char *name)
+{
+    Str value = Str_value(0);
+    std::string result = Env_get(env, name, strlen(name), &value) ? Str_cstr(&value) : "<unset>";
+    Str_drop(&value);
+    return result;
+}
+
+static std::vector<std::string> envp(Env *env)
+{
+    EnvBlock *block = Env_block(env);
+    std::vector<std::string> result;
+    for (char *const *entry = EnvBlock_envp(block); *entry != NULL; ++entry) {
+        result.push_back(*entry);
+    }
+    EnvBlock_drop(block);
+    return result;
+}
+
+/** TESTS **/
+
+TEST(EnvSpec, set_get_unset)
+{
+    Env env = Env_value();
+    ASSERT_EQ("<unset>", get(&env, "a"));
+    Env_set(&env, "a", "1");
+    Env_set(&env, "b", "");
+    ASSERT_EQ("1", get(&env, "a"));
+    ASSERT_EQ("", get(&env, "b"));
+    Env_set(&env, "a", "2");
+    ASSERT_EQ("2", get(&env, "a"));
+    Env_unset(&env, "a");
+    Env_unset(&env, "never");
+    ASSERT_EQ("<unset>", get(&env, "a"));
+    Env_set(&env, "a", "3");
+    ASSERT_EQ("3", get(&env, "a"));
+
+    Str value = Str_from("x=");
+    ASSERT_TRUE(Env_get(&env, "abc", 1, &value));
+    ASSERT_STREQ("x=3", Str_cstr(&value));
+    Str_drop(&value);
+    Env_drop(&env);
+}
+
+TEST(EnvSpec, only_exported_variables_in_envp)
+{
+    Env env = Env_value();
+    Env_set(&env, "local", "1");
+    Env_export(&env, "b", "2");
+    Env_export(&env, "a", NULL);
+    ASSERT_EQ(std::vector<std::string>({ "b=2", "a=" }), envp(&env));
+    Env_export(&env, "local", NULL);
+    ASSERT_EQ(std::vector<std::string>({ "local=1", "b=2", "a=" }), envp(&env));
+    Env_set(&env, "b", "3");
+    Env_unset(&env, "a");
+    ASSERT_EQ(std::vector<std::string>({ "local=1", "b=3" }), envp(&env));
+    /* Set again after unset, a variable is no longer exported. */
+    Env_set(&env, "a", "4");
+    ASSERT_EQ(std::vector<std::string>({ "local=1", "b=3" }), envp(&env));
+    Env_drop(&env);
+}
+
+TEST(EnvSpec, envp_rebuilt_only_when_exports_change)
+{
+    Env env = Env_value();
+    Env_export(&env, "a", "1");
+    uint64_t generation = Env_generation(&env);
+    EnvBlock *first = Env_block(&env);
+
+    Env_set(&env, "local", "x");
+    Env_set(&env, "a", "1");
+    Env_export(&env, "a", NULL);
+    Env_unset(&env, "local");
+    ASSERT_EQ(generation, Env_generation(&env));
+    EnvBlock *same = Env_block(&env);
+    ASSERT_EQ(first, same);
+    EnvBlock_drop(same);
+
+    Env_set(&env, "a", "2");
+    ASSERT_EQ(generation + 1, Env_generation(&env));
+    EnvBlock *second = Env_block(&env);
+    ASSERT_NE(first, second);
+    /* A block still held outlives the change. */
+    ASSERT_STREQ("a=1", EnvBlock_envp(first)[0]);
+    ASSERT_STREQ("a=2", EnvBlock_envp(second)[0]);
+    EnvBlock_drop(first);
+    Env_drop(&env);
+    ASSERT_STREQ("a=2", EnvBlock_envp(second)[0]);
+    EnvBlock_drop(second);
+}
+
+TEST(EnvSpec, many_variables)
+{
+    Env env = Env_value();
+    for (int i = 0; i < 1000; ++i) {
+        std::string name = "v" + std::to_string(i);
+        if (i % 2 == 0) {
+            Env_export(&env, name.c_str(), std::to_string(i).c_str());
+        } else {
+            Env_set(&env, name.c_str(), std::to_string(i).c_str());
+        }
+    }
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(std::to_string(i), get(&env, ("v" + std::to_string(i)).c_str()));
+    }
+    std::vector<std::string> entries = envp(&env);
+    ASSERT_EQ(500u, entries.size());
+    ASSERT_EQ("v998=998", entries.back());
+    Env_drop(&env);
+}
+
+TEST(EnvSpec, from_envp)
+{
+    char *const entries[] = {
+        (char*) "A=1", (char*) "B==2", (char*) "=skipped", (char*) "C", (char*) "A=3", NULL
+    };
+    Env env = Env_from(entries);
+    ASSERT_EQ(std::vector<std::string>({ "A=3", "B==2" }), envp(&env));
+    ASSERT_EQ("=2", get(&env, "B"));
+    Env_drop(&env);
+
+    ASSERT_EQ(getenv("PATH"), get(Env_shell(), "PATH"));
+}
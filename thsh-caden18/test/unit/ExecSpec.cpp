@@ -0,0 +1,417 @@
+#include "gtest/gtest.h"
+#include "SpecHelpers.h"
+
+extern "C" {
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Batch.h"
+#include "Env.h"
+#include "Exec.h"
+#include "Parser.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static std::string run(const char *cstr, int *status)
+{
+    FILE *out = tmpfile();
+    Node *tree = fixture(cstr);
+    *status = execute(tree, STDIN_FILENO, fileno(out));
+    Node_drop(tree);
+    std::string result = contents(out);
+    fclose(out);
+    return result;
+}
+
+static std::string run_batch(const char *script, size_t parsers, size_t depth, int *status)
+{
+    FILE *in = fmemopen((void*) script, strlen(script), "r");
+    FILE *out = tmpfile();
+    BatchOptions options = { parsers, depth };
+    *status = Batch_run(in, fileno(out), options);
+    std::string result = contents(out);
+    fclose(out);
+    fclose(in);
+    return result;
+}
+
+/** TESTS **/
+
+TEST(ExecSpec, simple_command)
+{
+    int status;
+    ASSERT_EQ("hello world\n", run("echo hello world", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, exit_status)
+{
+    int status;
+    run("false", &status);
+    ASSERT_EQ(1, status);
+    run("true", &status);
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, pipeline)
+{
+    int status;
+    ASSERT_EQ("b\n", run("echo a | tr a b | cat", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, pipeline_status_is_last_command)
+{
+    int status;
+    run("false | true", &status);
+    ASSERT_EQ(0, status);
+    run("true | false", &status);
+    ASSERT_EQ(1, status);
+}
+
+TEST(ExecSpec, command_not_found)
+{
+    int status;
+    ASSERT_EQ("", run("no-such-command-thsh", &status));
+    ASSERT_EQ(EXIT_NOT_FOUND, status);
+}
+
+TEST(ExecSpec, syntax_error)
+{
+    int status;
+    run("| wc", &status);
+    ASSERT_EQ(EXIT_SYNTAX_ERROR, status);
+}
+
+TEST(ExecSpec, sequence)
+{
+    int status;
+    ASSERT_EQ("a\nb\n", run("echo a; echo b", &status));
+    ASSERT_EQ("a\nb\n", run("echo a\n\necho b | cat\n", &status));
+    run("true; false", &status);
+    ASSERT_EQ(1, status);
+    run("false; true", &status);
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, and_or_short_circuit)
+{
+    int status;
+    ASSERT_EQ("a\nb\n", run("echo a && echo b || echo c", &status));
+    ASSERT_EQ("c\n", run("false && echo b || echo c", &status));
+    ASSERT_EQ("c\n", run("true || echo b && echo c", &status));
+    ASSERT_EQ(0, status);
+    run("false || false", &status);
+    ASSERT_EQ(1, status);
+    run("true && no-such-command-thsh", &status);
+    ASSERT_EQ(EXIT_NOT_FOUND, status);
+
+    /* A skipped pipeline starts nothing, not even its redirections. */
+    char path[] = "/tmp/thsh_skipped_XXXXXX";
+    close(mkstemp(path));
+    unlink(path);
+    std::string command = std::string("false && echo x > ") + path + " || true";
+    run(command.c_str(), &status);
+    ASSERT_EQ(0, status);
+    ASSERT_NE(0, access(path, F_OK));
+    command = std::string("true || echo $(echo x > ") + path + ")";
+    run(command.c_str(), &status);
+    ASSERT_NE(0, access(path, F_OK));
+}
+
+TEST(ExecSpec, for_loop)
+{
+    int status;
+    ASSERT_EQ("a.\nb.\nc.\nd.\n", run("for x in a $(echo b c) d; do echo $x.; done", &status));
+    ASSERT_EQ("1a\n1b\n2a\n2b\n", run("for i in 1 2; do for j in a b; do echo $i$j; done; done",
+            &status));
+    ASSERT_EQ("x\n", run("for v in x; do echo $(echo ${v}); done", &status));
+    ASSERT_EQ("", run("for x in; do echo $x; done", &status));
+    ASSERT_EQ(0, status);
+    run("for x in a b; do test $x = a; done", &status);
+    ASSERT_EQ(1, status);
+}
+
+TEST(ExecSpec, while_loop)
+{
+    char path[] = "/tmp/thsh_while_XXXXXX";
+    close(mkstemp(path));
+    int status;
+    std::string command = std::string("while test -e ") + path + "; do echo once; rm " + path
+            + "; done";
+    ASSERT_EQ("once\n", run(command.c_str(), &status));
+    ASSERT_EQ(0, status);
+    ASSERT_EQ("", run("while false; do echo never; done", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, variables)
+{
+    int status;
+    Env_export(Env_shell(), "THSH_SPEC_VALUE", "from  env");
+    ASSERT_EQ("from env [] $1 $\n", run("echo $THSH_SPEC_VALUE [$THSH_SPEC_UNSET] $1 $", &status));
+    ASSERT_EQ("2\n", run("echo ${THSH_SPEC_VALUE} | wc -w", &status));
+    Env_unset(Env_shell(), "THSH_SPEC_VALUE");
+}
+
+TEST(ExecSpec, export_and_unset)
+{
+    int status;
+    ASSERT_EQ("a\n", run("export THSH_SPEC_EXPORT=a && printenv THSH_SPEC_EXPORT", &status));
+    ASSERT_EQ("a\na\n", run("printenv THSH_SPEC_EXPORT; echo $THSH_SPEC_EXPORT", &status));
+    ASSERT_EQ("b c\n", run("export THSH_SPEC_EXPORT=b THSH_SPEC_OTHER=c; "
+            "echo $THSH_SPEC_EXPORT $THSH_SPEC_OTHER", &status));
+    ASSERT_NE(std::string::npos, run("export", &status).find("export THSH_SPEC_OTHER=c\n"));
+    run("unset THSH_SPEC_EXPORT THSH_SPEC_OTHER", &status);
+    ASSERT_EQ(0, status);
+    ASSERT_EQ("[]\n", run("echo [$THSH_SPEC_EXPORT]", &status));
+    run("printenv THSH_SPEC_EXPORT", &status);
+    ASSERT_EQ(1, status);
+    run("export 1a", &status);
+    ASSERT_EQ(1, status);
+    run("unset a-b", &status);
+    ASSERT_EQ(1, status);
+}
+
+TEST(ExecSpec, commands_found_through_exported_path)
+{
+    char dir[] = "/tmp/thsh-path-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    std::string tool = std::string(dir) + "/thsh_spec_tool";
+    FILE *file = fopen(tool.c_str(), "w");
+    fputs("#!/bin/sh\necho found\n", file);
+    fclose(file);
+    ASSERT_EQ(0, chmod(tool.c_str(), 0755));
+    std::string denied = std::string(dir) + "/thsh_spec_denied";
+    fclose(fopen(denied.c_str(), "w"));
+
+    Str saved = Str_value(64);
+    ASSERT_TRUE(Env_get(Env_shell(), "PATH", 4, &saved));
+    int status;
+    run("thsh_spec_tool", &status);
+    ASSERT_EQ(EXIT_NOT_FOUND, status);
+    std::string path = std::string(dir) + ":" + Str_cstr(&saved);
+    ASSERT_EQ("", run(("export PATH=" + path).c_str(), &status));
+    ASSERT_EQ("found\n", run("thsh_spec_tool", &status));
+    ASSERT_EQ(0, status);
+    ASSERT_EQ("found\n", run("thsh_spec_tool | cat", &status));
+    ASSERT_EQ("found\n", run((tool + " && printenv PATH > /dev/null").c_str(), &status));
+    run("thsh_spec_denied", &status);
+    ASSERT_EQ(EXIT_FAILURE, status);
+    Env_export(Env_shell(), "PATH", Str_cstr(&saved));
+    run("thsh_spec_tool", &status);
+    ASSERT_EQ(EXIT_NOT_FOUND, status);
+    Str_drop(&saved);
+
+    unlink(tool.c_str());
+    unlink(denied.c_str());
+    rmdir(dir);
+}
+
+TEST(ExecSpec, builtin_echo_true_false)
+{
+    int status;
+    ASSERT_EQ("a b\n", run("echo a   b", &status));
+    ASSERT_EQ("\n", run("echo", &status));
+    run("true", &status);
+    ASSERT_EQ(0, status);
+    run("false", &status);
+    ASSERT_EQ(1, status);
+    run("true | false", &status);
+    ASSERT_EQ(1, status);
+}
+
+TEST(ExecSpec, batch_preserves_order)
+{
+    std::string script;
+    std::string expect;
+    for (int i = 0; i < 200; ++i) {
+        script += "echo line " + std::to_string(i) + "\n";
+        if (i % 7 == 0) {
+            script += "\n";
+        }
+        expect += "line " + std::to_string(i) + "\n";
+    }
+    int status;
+    ASSERT_EQ(expect, run_batch(script.c_str(), 4, 3, &status));
+    ASSERT_EQ(0, status);
+    ASSERT_EQ(expect, run_batch(script.c_str(), 1, 1, &status));
+}
+
+TEST(ExecSpec, batch_status_is_last_line)
+{
+    int status;
+    run_batch("true\nfalse\n", 2, 8, &status);
+    ASSERT_EQ(1, status);
+    run_batch("", 2, 8, &status);
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, batch_continues_lists_and_loops)
+{
+    const char *script =
+        "for i in a b\n"
+        "do\n"
+        "  echo $i\n"
+        "done\n"
+        "echo x &&\n"
+        "echo y |\n"
+        "  cat\n"
+        "while false\n"
+        "do echo never; done; echo after\n";
+    int status;
+    for (size_t depth : { 1, 2, 16 }) {
+        ASSERT_EQ("a\nb\nx\ny\nafter\n", run_batch(script, 3, depth, &status));
+        ASSERT_EQ(0, status);
+    }
+
+    ASSERT_EQ("a\n", run_batch("echo a\nfor i in b\ndo\n  echo $i\n", 2, 4, &status));
+    ASSERT_EQ(EXIT_SYNTAX_ERROR, status);
+    ASSERT_EQ("", run_batch("echo a &&\ndone\necho b\n", 2, 4, &status));
+    ASSERT_EQ(EXIT_SYNTAX_ERROR, status);
+}
+
+TEST(ExecSpec, builtin_cat_in_pipeline)
+{
+    char path[] = "/tmp/thsh_cat_XXXXXX";
+    int fd = mkstemp(path);
+    write(fd, "one\ntwo\n", 8);
+    close(fd);
+    int status;
+    std::string command = std::string("cat ") + path + " - | cat | wc -l";
+    ASSERT_EQ("2\n", run(command.c_str(), &status));
+    ASSERT_EQ(0, status);
+    command = std::string("cat ") + path;
+    ASSERT_EQ("one\ntwo\n", run(command.c_str(), &status));
+    unlink(path);
+}
+
+TEST(ExecSpec, builtin_cat_errors)
+{
+    int status;
+    ASSERT_EQ("", run("cat /nonexistent/file", &status));
+    ASSERT_EQ(1, status);
+    ASSERT_EQ("     1\tx\n", run("echo x | cat -n", &status));
+}
+
+TEST(ExecSpec, builtin_tee)
+{
+    char path[] = "/tmp/thsh_tee_XXXXXX";
+    close(mkstemp(path));
+    int status;
+    std::string command = std::string("echo hello | tee ") + path + " | tr a-z A-Z";
+    ASSERT_EQ("HELLO\n", run(command.c_str(), &status));
+    FILE *file = fopen(path, "r");
+    ASSERT_EQ("hello\n", contents(file));
+    fclose(file);
+    unlink(path);
+}
+
+TEST(ExecSpec, builtin_survives_closed_reader)
+{
+    int status;
+    ASSERT_EQ("y\n", run("yes | cat | head -n 1", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, redirect_output)
+{
+    char path[] = "/tmp/thsh_out_XXXXXX";
+    close(mkstemp(path));
+    int status;
+    std::string command = std::string("echo one > ") + path;
+    ASSERT_EQ("", run(command.c_str(), &status));
+    command = std::string("echo two >> ") + path;
+    ASSERT_EQ("", run(command.c_str(), &status));
+    command = std::string("wc -l < ") + path;
+    ASSERT_EQ("2\n", run(command.c_str(), &status));
+    ASSERT_EQ(0, status);
+    command = std::string("echo three > ") + path;
+    run(command.c_str(), &status);
+    command = std::string("<") + path + " cat";
+    ASSERT_EQ("three\n", run(command.c_str(), &status));
+    unlink(path);
+}
+
+TEST(ExecSpec, redirect_error)
+{
+    char path[] = "/tmp/thsh_err_XXXXXX";
+    close(mkstemp(path));
+    int status;
+    std::string command = std::string("ls /nonexistent 2> ") + path;
+    ASSERT_EQ("", run(command.c_str(), &status));
+    ASSERT_NE(0, status);
+    FILE *file = fopen(path, "r");
+    ASSERT_NE("", contents(file));
+    fclose(file);
+    ASSERT_NE("", run("ls /nonexistent 2>&1 | cat", &status));
+    unlink(path);
+}
+
+TEST(ExecSpec, redirect_failure_skips_command)
+{
+    int status;
+    ASSERT_EQ("", run("echo hi > /nonexistent/file", &status));
+    ASSERT_EQ(1, status);
+    ASSERT_EQ("0\n", run("cat < /nonexistent/file | wc -l", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, builtin_redirects)
+{
+    char path[] = "/tmp/thsh_builtin_XXXXXX";
+    close(mkstemp(path));
+    int status;
+    std::string command = std::string("echo hi | cat > ") + path;
+    ASSERT_EQ("", run(command.c_str(), &status));
+    command = std::string("cat < ") + path + " | tr a-z A-Z";
+    ASSERT_EQ("HI\n", run(command.c_str(), &status));
+    command = std::string("cat /nonexistent 2>&1 > ") + path;
+    ASSERT_NE("", run(command.c_str(), &status));
+    ASSERT_EQ(1, status);
+    unlink(path);
+}
+
+TEST(ExecSpec, substitution)
+{
+    int status;
+    ASSERT_EQ("a bx\n", run("echo $(echo a   b)x", &status));
+    ASSERT_EQ("pre1 2post\n", run("echo pre$(seq 2)post", &status));
+    ASSERT_EQ("3\n", run("echo `seq 3 | wc -l`", &status));
+    ASSERT_EQ("nested\n", run("echo $(echo $(echo nested))", &status));
+    ASSERT_EQ("HI\n", run("$(echo echo) hi | tr $(echo a-z) A-Z", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, empty_substitution)
+{
+    int status;
+    ASSERT_EQ("1\n", run("echo $(true) x $(true) | wc -w", &status));
+    ASSERT_EQ("", run("$(false)", &status));
+    ASSERT_EQ(1, status);
+    ASSERT_EQ("", run("$(true)", &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(ExecSpec, substitution_capture_is_large)
+{
+    char path[] = "/tmp/thsh_capture_XXXXXX";
+    int fd = mkstemp(path);
+    std::string data;
+    for (size_t i = 0; data.size() < (3 << 20); ++i) {
+        data += std::to_string(i) + "\n";
+    }
+    write(fd, data.data(), data.size());
+    write(fd, "\n\n\n", 3);
+    close(fd);
+
+    Node *tree = fixture((std::string("cat ") + path).c_str());
+    Str out = Str_from("kept\n");
+    ASSERT_EQ(0, execute_capture(tree, STDIN_FILENO, &out));
+    data.pop_back();
+    ASSERT_EQ("kept\n" + data, std::string(Str_cstr(&out), Str_length(&out)));
+    ASSERT_LT(out.capacity, 2 * out.length + (64 << 10) + 1);
+    Str_drop(&out);
+    Node_drop(tree);
+    unlink(path);
+}
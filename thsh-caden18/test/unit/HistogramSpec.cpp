@@ -0,0 +1,65 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "Histogram.h"
+#include "Profile.h"
+}
+
+static Histogram h;
+
+TEST(HistogramSpec, empty)
+{
+    Histogram_reset(&h);
+    ASSERT_EQ(0, Histogram_count(&h));
+    ASSERT_EQ(0, Histogram_percentile(&h, 50.0));
+    ASSERT_EQ(0, Histogram_max(&h));
+}
+
+TEST(HistogramSpec, small_values_are_exact)
+{
+    Histogram_reset(&h);
+    for (uint64_t i = 1; i <= 20; ++i) {
+        Histogram_record(&h, i);
+    }
+    ASSERT_EQ(20, Histogram_count(&h));
+    ASSERT_EQ(10, Histogram_percentile(&h, 50.0));
+    ASSERT_EQ(20, Histogram_percentile(&h, 100.0));
+    ASSERT_EQ(20, Histogram_max(&h));
+}
+
+TEST(HistogramSpec, large_values_within_error_bound)
+{
+    Histogram_reset(&h);
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        Histogram_record(&h, i * 1000);
+    }
+    uint64_t p50 = Histogram_percentile(&h, 50.0);
+    uint64_t p99 = Histogram_percentile(&h, 99.0);
+    ASSERT_GE(p50, 500000);
+    ASSERT_LE(p50, 500000 * 1.07);
+    ASSERT_GE(p99, 990000);
+    ASSERT_LE(p99, 1000000);
+    ASSERT_EQ(1000000, Histogram_max(&h));
+}
+
+TEST(HistogramSpec, extreme_values)
+{
+    Histogram_reset(&h);
+    Histogram_record(&h, UINT64_MAX);
+    Histogram_record(&h, 0);
+    ASSERT_EQ(0, Histogram_percentile(&h, 50.0));
+    ASSERT_EQ(UINT64_MAX, Histogram_percentile(&h, 100.0));
+}
+
+TEST(HistogramSpec, profile_records_when_enabled)
+{
+    Profile_reset();
+    Profile_enable();
+    PROFILE_START(timer);
+    PROFILE_STOP(timer, PHASE_EXEC);
+    size_t count = Histogram_count(Profile_histogram(PHASE_EXEC));
+    Profile_disable();
+    Profile_reset();
+    ASSERT_EQ(1, count);
+    ASSERT_FALSE(Profile_enabled());
+}
@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "IoCopy.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static int file_with(const std::string &data)
+{
+    FILE *file = tmpfile();
+    int fd = dup(fileno(file));
+    fclose(file);
+    write(fd, data.data(), data.size());
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+static std::string read_all(int fd)
+{
+    std::string out;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        out.append(buffer, n);
+    }
+    return out;
+}
+
+static std::string data_of(size_t length)
+{
+    std::string data;
+    for (size_t i = 0; i < length; ++i) {
+        data += (char) ('a' + i % 26);
+    }
+    return data;
+}
+
+/** TESTS **/
+
+TEST(IoCopySpec, file_to_file)
+{
+    std::string data = data_of(3 << 20);
+    int in = file_with(data);
+    int out = file_with("");
+    ASSERT_EQ(data.size(), IoCopy_copy(in, out));
+    lseek(out, 0, SEEK_SET);
+    ASSERT_EQ(data, read_all(out));
+    close(in);
+    close(out);
+}
+
+TEST(IoCopySpec, file_to_pipe_to_file)
+{
+    std::string data = data_of(10000);
+    int in = file_with(data);
+    int ends[2];
+    ASSERT_EQ(0, pipe(ends));
+    ASSERT_EQ(data.size(), IoCopy_copy(in, ends[1]));
+    close(ends[1]);
+    int out = file_with("");
+    ASSERT_EQ(data.size(), IoCopy_copy(ends[0], out));
+    lseek(out, 0, SEEK_SET);
+    ASSERT_EQ(data, read_all(out));
+    close(ends[0]);
+    close(in);
+    close(out);
+}
+
+TEST(IoCopySpec, falls_back_to_read_write)
+{
+    std::string data = data_of(5000);
+    int in = file_with(data);
+    int pair[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+    int out = file_with("");
+    ASSERT_EQ(data.size(), IoCopy_copy(in, pair[0]));
+    shutdown(pair[0], SHUT_WR);
+    ASSERT_EQ(data.size(), IoCopy_copy(pair[1], out));
+    lseek(out, 0, SEEK_SET);
+    ASSERT_EQ(data, read_all(out));
+    close(pair[0]);
+    close(pair[1]);
+    close(in);
+    close(out);
+}
+
+TEST(IoCopySpec, tee_between_pipes)
+{
+    std::string data = data_of(20000);
+    int in[2];
+    int out[2];
+    ASSERT_EQ(0, pipe(in));
+    ASSERT_EQ(0, pipe(out));
+    write(in[1], data.data(), data.size());
+    close(in[1]);
+    int copy = file_with("");
+    ASSERT_EQ(data.size(), IoCopy_tee(in[0], out[1], copy));
+    close(out[1]);
+    ASSERT_EQ(data, read_all(out[0]));
+    lseek(copy, 0, SEEK_SET);
+    ASSERT_EQ(data, read_all(copy));
+    close(in[0]);
+    close(out[0]);
+    close(copy);
+}
+
+TEST(IoCopySpec, tee_without_pipes)
+{
+    std::string data = data_of(1000);
+    int in = file_with(data);
+    int out = file_with("");
+    int copy = file_with("");
+    ASSERT_EQ(data.size(), IoCopy_tee(in, out, copy));
+    lseek(out, 0, SEEK_SET);
+    lseek(copy, 0, SEEK_SET);
+    ASSERT_EQ(data, read_all(out));
+    ASSERT_EQ(data, read_all(copy));
+    close(in);
+    close(out);
+    close(copy);
+}
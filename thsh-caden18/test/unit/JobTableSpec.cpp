@@ -0,0 +1,207 @@
+#include <chrono>
+
+#include "gtest/gtest.h"
+#include "SpecHelpers.h"
+
+extern "C" {
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include "Exec.h"
+#include "JobTable.h"
+#include "MemStats.h"
+#include "Parser.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static std::string run(JobTable *jobs, const char *cstr, int *status)
+{
+    Node *tree = fixture(cstr);
+    FILE *out = tmpfile();
+    *status = execute_with(tree, STDIN_FILENO, fileno(out), jobs);
+    Node_drop(tree);
+    std::string result = contents(out);
+    fclose(out);
+    return result;
+}
+
+/** TESTS **/
+
+TEST(JobTableSpec, background_does_not_block)
+{
+    JobTable jobs = JobTable_value(-1);
+    int status;
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ("", run(&jobs, "sleep 1 &", &status));
+    ASSERT_EQ(0, status);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    ASSERT_EQ(1, JobTable_count(&jobs));
+    ASSERT_EQ("[1]  Running    sleep 1\n", run(&jobs, "jobs", &status));
+
+    ASSERT_EQ("", run(&jobs, "wait", &status));
+    ASSERT_EQ(0, status);
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(900));
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    JobTable_drop(&jobs);
+}
+
+TEST(JobTableSpec, job_builtins_run_in_pipelines)
+{
+    JobTable jobs = JobTable_value(-1);
+    int status;
+    run(&jobs, "sleep 5 &", &status);
+    ASSERT_EQ("[1]  Running    sleep 5\n", run(&jobs, "jobs | cat", &status));
+    ASSERT_EQ(0, status);
+    ASSERT_EQ("1\n", run(&jobs, "jobs | wc -l", &status));
+    ASSERT_EQ("", run(&jobs, "cat /dev/null | jobs -x", &status));
+    ASSERT_EQ(EXIT_SYNTAX_ERROR, status);
+
+    pid_t pgid = std::stoi(run(&jobs, "jobs -p | cat", &status));
+    ASSERT_EQ(0, kill(-pgid, SIGTERM));
+    ASSERT_EQ("", run(&jobs, "wait %1 | cat", &status));
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    JobTable_drop(&jobs);
+}
+
+TEST(JobTableSpec, wait_reports_status)
+{
+    JobTable jobs = JobTable_value(-1);
+    int status;
+    run(&jobs, "true &", &status);
+    run(&jobs, "ls /nonexistent | false &", &status);
+    ASSERT_EQ(0, status);
+    run(&jobs, "wait %2", &status);
+    ASSERT_EQ(1, status);
+    run(&jobs, "wait %2", &status);
+    ASSERT_EQ(EXIT_NOT_FOUND, status);
+    run(&jobs, "wait %1", &status);
+    ASSERT_EQ(0, status);
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    JobTable_drop(&jobs);
+}
+
+TEST(JobTableSpec, poll_reaps_finished_jobs)
+{
+    JobTable jobs = JobTable_value(-1);
+    const size_t count = 200;
+    int status;
+    for (size_t i = 0; i < count; ++i) {
+        run(&jobs, "true &", &status);
+    }
+    ASSERT_EQ(count, JobTable_count(&jobs));
+
+    struct pollfd fd = { JobTable_fd(&jobs), POLLIN, 0 };
+    ASSERT_EQ(1, poll(&fd, 1, 5000));
+    size_t reaped = 0;
+    while (reaped < count) {
+        reaped += JobTable_poll(&jobs, -1);
+    }
+    ASSERT_EQ(count, reaped);
+    ASSERT_EQ(0, poll(&fd, 1, 0));
+
+    FILE *out = tmpfile();
+    JobTable_notify(&jobs, out);
+    std::string report = contents(out);
+    fclose(out);
+    ASSERT_EQ(count, (size_t) std::count(report.begin(), report.end(), '\n'));
+    ASSERT_EQ(0, report.find("[1]  Done       true\n"));
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    JobTable_drop(&jobs);
+}
+
+TEST(JobTableSpec, notify_reports_only_finished_jobs)
+{
+    JobTable jobs = JobTable_value(-1);
+    int status;
+    run(&jobs, "sleep 5 &", &status);
+    pid_t pgid = std::stoi(run(&jobs, "jobs -p", &status));
+    run(&jobs, "true &", &status);
+    run(&jobs, "false &", &status);
+    run(&jobs, "true &", &status);
+    size_t reaped = 0;
+    while (reaped < 3) {
+        reaped += JobTable_poll(&jobs, -1);
+    }
+    /* A finished job removed by a builtin is not reported again. */
+    run(&jobs, "wait %4", &status);
+
+    FILE *out = tmpfile();
+    JobTable_notify(&jobs, out);
+    JobTable_notify(&jobs, out);
+    ASSERT_EQ("[2]  Done       true\n[3]  Exit 1     false\n", contents(out));
+    fclose(out);
+    ASSERT_EQ(1, JobTable_count(&jobs));
+
+    /* Without anyone to tell, finished jobs are only removed. */
+    run(&jobs, "true &", &status);
+    while (JobTable_poll(&jobs, -1) == 0) {
+    }
+    JobTable_notify(&jobs, NULL);
+    ASSERT_EQ(1, JobTable_count(&jobs));
+    ASSERT_EQ("[1]  Running    sleep 5\n", run(&jobs, "jobs", &status));
+
+    ASSERT_EQ(0, kill(-pgid, SIGTERM));
+    run(&jobs, "wait", &status);
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    JobTable_drop(&jobs);
+}
+
+TEST(JobTableSpec, stop_and_continue)
+{
+    JobTable jobs = JobTable_value(-1);
+    int status;
+    run(&jobs, "sleep 5 &", &status);
+    pid_t pgid = std::stoi(run(&jobs, "jobs -p", &status));
+
+    ASSERT_EQ(0, kill(-pgid, SIGSTOP));
+    std::string listing;
+    for (int i = 0; i < 100 && listing.find("Stopped") == std::string::npos; ++i) {
+        usleep(10000);
+        listing = run(&jobs, "jobs", &status);
+    }
+    ASSERT_EQ("[1]  Stopped    sleep 5\n", listing);
+
+    ASSERT_EQ("[1] sleep 5 &\n", run(&jobs, "bg", &status));
+    ASSERT_EQ("[1]  Running    sleep 5\n", run(&jobs, "jobs", &status));
+
+    ASSERT_EQ(0, kill(-pgid, SIGTERM));
+    ASSERT_EQ("sleep 5\n", run(&jobs, "fg %1", &status));
+    ASSERT_EQ(128 + SIGTERM, status);
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    run(&jobs, "fg", &status);
+    ASSERT_EQ(1, status);
+    JobTable_drop(&jobs);
+}
+
+TEST(JobTableSpec, no_table_runs_in_foreground)
+{
+    Node *tree = fixture("echo hi &");
+    ASSERT_EQ(BACKGROUND_NODE, tree->type);
+    FILE *out = tmpfile();
+    ASSERT_EQ(0, execute(tree, STDIN_FILENO, fileno(out)));
+    ASSERT_EQ("hi\n", contents(out));
+    fclose(out);
+    Node_drop(tree);
+}
+
+TEST(JobTableSpec, removed_jobs_release_their_memory)
+{
+    JobTable jobs = JobTable_value(-1);
+    MemStats_enable();
+    MemStats_reset();
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(0);
+    }
+    JobTable_add(&jobs, &pid, 1, "true");
+    for (int i = 0; i < 100 && JobTable_poll(&jobs, 10) == 0; ++i) {
+    }
+    JobTable_notify(&jobs, NULL);
+    ASSERT_EQ(0, JobTable_count(&jobs));
+    JobTable_drop(&jobs);
+    size_t live = MemStats_live();
+    MemStats_disable();
+    MemStats_reset();
+    ASSERT_EQ(0, live);
+}
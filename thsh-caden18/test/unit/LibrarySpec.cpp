@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+
+extern "C" {
+#include "Guards.h"
+#include "thsh.h"
+#include "Vec.h"
+}
+
+static thsh_status parse_cstr(const char *cstr, const thsh_options *options, Arena *arena, thsh_result *result)
+{
+    return thsh_parse(cstr, strlen(cstr), options, arena, result);
+}
+
+TEST(LibrarySpec, parses_pipeline)
+{
+    Arena arena = Arena_value(1024);
+    thsh_result result;
+    ASSERT_EQ(THSH_OK, parse_cstr("ls -lah | grep foo", NULL, &arena, &result));
+    ASSERT_EQ(PIPE_NODE, result.tree->type);
+    const Node *rhs = result.tree->data.pipe.right;
+    ASSERT_STREQ("foo", Command_word(&rhs->data.command, 1));
+    ASSERT_EQ(nullptr, result.error);
+    Arena_drop(&arena);
+}
+
+TEST(LibrarySpec, input_need_not_be_terminated)
+{
+    Arena arena = Arena_value(1024);
+    thsh_result result;
+    const char input[] = { 'l', 's', ' ', 'x', 'y' };
+    ASSERT_EQ(THSH_OK, thsh_parse(input, 4, NULL, &arena, &result));
+    ASSERT_STREQ("x", Command_word(&result.tree->data.command, 1));
+    Arena_drop(&arena);
+}
+
+TEST(LibrarySpec, reports_errors)
+{
+    Arena arena = Arena_value(1024);
+    thsh_result result;
+    ASSERT_EQ(THSH_EMPTY, parse_cstr("  \t ", NULL, &arena, &result));
+    ASSERT_EQ(THSH_SYNTAX_ERROR, parse_cstr("ls |", NULL, &arena, &result));
+    ASSERT_EQ(nullptr, result.tree);
+    ASSERT_STREQ("Expected a command after |", result.error);
+    ASSERT_EQ(THSH_SYNTAX_ERROR, parse_cstr("| ls", NULL, &arena, &result));
+    thsh_options options = { 4, 0 };
+    ASSERT_EQ(THSH_TOO_LARGE, parse_cstr("ls -l", &options, &arena, &result));
+    Arena_drop(&arena);
+}
+
+TEST(LibrarySpec, memory_is_bounded)
+{
+    std::string input;
+    for (int i = 0; i < 1000; ++i) {
+        input += "word" + std::to_string(i) + " ";
+    }
+    Arena arena = Arena_value(1024);
+    thsh_options options = { 0, 4096 };
+    thsh_result result;
+    ASSERT_EQ(THSH_NO_MEMORY, thsh_parse(input.data(), input.size(), &options, &arena, &result));
+    ASSERT_LE(arena.allocated, 4096);
+    ASSERT_EQ(0, arena.limit);
+
+    Arena_reset(&arena);
+    options.max_memory = 1 << 20;
+    ASSERT_EQ(THSH_OK, thsh_parse(input.data(), input.size(), &options, &arena, &result));
+    Arena_drop(&arena);
+}
+
+TEST(LibrarySpec, recovery_catches_guards)
+{
+    Vec v = Vec_value(1, sizeof(int));
+    Recovery recovery;
+    volatile bool recovered = false;
+    Recovery_begin(&recovery);
+    if (setjmp(recovery.env) != 0) {
+        Recovery_end(&recovery);
+        recovered = true;
+    } else {
+        Vec_ref(&v, 5);
+        Recovery_end(&recovery);
+    }
+    ASSERT_TRUE(recovered);
+    ASSERT_EQ(OUT_OF_BOUNDS, recovery.message);
+    Vec_drop(&v);
+}
+
+TEST(LibrarySpec, concurrent_parses)
+{
+    const size_t threads = 8;
+    std::vector<size_t> words(threads, 0);
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back([t, &words]() {
+            Arena arena = Arena_value(4096);
+            for (int i = 0; i < 2000; ++i) {
+                std::string line = "cmd" + std::to_string(t) + " a b | wc -l";
+                thsh_result result;
+                if (thsh_parse(line.data(), line.size(), NULL, &arena, &result) == THSH_OK) {
+                    words[t] += Command_length(&result.tree->data.pipe.left->data.command);
+                }
+                Arena_reset(&arena);
+            }
+            Arena_drop(&arena);
+        });
+    }
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+    for (size_t t = 0; t < threads; ++t) {
+        ASSERT_EQ(3 * 2000, words[t]);
+    }
+}
+
+TEST(LibrarySpec, deep_pipelines)
+{
+    std::string input = "a";
+    for (int i = 0; i < 100000; ++i) {
+        input += " | a";
+    }
+    Arena arena = Arena_value(1 << 16);
+    thsh_result result;
+    ASSERT_EQ(THSH_OK, thsh_parse(input.data(), input.size(), NULL, &arena, &result));
+    size_t stages = 1;
+    const Node *node = result.tree;
+    while (node->type == PIPE_NODE) {
+        node = node->data.pipe.right;
+        ++stages;
+    }
+    ASSERT_EQ(100001, stages);
+    Arena_drop(&arena);
+}
@@ -0,0 +1,158 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+#include "LineReader.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static int file_with(const std::string &data)
+{
+    FILE *file = tmpfile();
+    int fd = dup(fileno(file));
+    fclose(file);
+    write(fd, data.data(), data.size());
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+static std::string next_line(LineReader *reader)
+{
+    size_t length;
+    const char *line = LineReader_next(reader, &length);
+    return line != NULL ? std::string(line, length) : "(end)";
+}
+
+static std::vector<std::string> lines_of(LineReader *reader)
+{
+    std::vector<std::string> lines;
+    const char *line;
+    size_t length;
+    while ((line = LineReader_next(reader, &length)) != NULL) {
+        lines.push_back(std::string(line, length));
+    }
+    return lines;
+}
+
+static std::vector<std::string> lines_of_file(const std::string &data)
+{
+    int fd = file_with(data);
+    LineReader reader = LineReader_value(fd);
+    std::vector<std::string> lines = lines_of(&reader);
+    LineReader_drop(&reader);
+    close(fd);
+    return lines;
+}
+
+static std::vector<std::string> lines_of_pipe(const std::string &data)
+{
+    int fds[2];
+    pipe(fds);
+    std::thread writer([&]() {
+        write(fds[1], data.data(), data.size());
+        close(fds[1]);
+    });
+    LineReader reader = LineReader_value(fds[0]);
+    std::vector<std::string> lines = lines_of(&reader);
+    LineReader_drop(&reader);
+    writer.join();
+    close(fds[0]);
+    return lines;
+}
+
+/* Lines of growing lengths, some longer than a block. */
+static std::string script_of(size_t length, std::vector<std::string> *lines)
+{
+    std::string data;
+    for (size_t i = 0; data.size() < length; ++i) {
+        std::string line(i * i * 7 % (LINE_READER_BLOCK_SIZE * 3 / 2), 'a' + i % 26);
+        line += '\n';
+        lines->push_back(line);
+        data += line;
+    }
+    return data;
+}
+
+/** TESTS **/
+
+TEST(LineReaderSpec, splits_lines)
+{
+    std::vector<std::string> expected = { "echo a\n", "\n", "ls | wc" };
+    ASSERT_EQ(expected, lines_of_file("echo a\n\nls | wc"));
+    ASSERT_EQ(expected, lines_of_pipe("echo a\n\nls | wc"));
+    ASSERT_EQ(std::vector<std::string>(), lines_of_file(""));
+    ASSERT_EQ(std::vector<std::string>(), lines_of_pipe(""));
+}
+
+TEST(LineReaderSpec, lines_across_blocks)
+{
+    std::vector<std::string> expected;
+    std::string data = script_of(LINE_READER_BLOCKS * LINE_READER_BLOCK_SIZE * 3, &expected);
+    ASSERT_EQ(expected, lines_of_file(data));
+    ASSERT_EQ(expected, lines_of_pipe(data));
+
+    data.pop_back();
+    expected.back().pop_back();
+    ASSERT_EQ(expected, lines_of_file(data));
+    ASSERT_EQ(expected, lines_of_pipe(data));
+}
+
+TEST(LineReaderSpec, reads_ahead_in_batches)
+{
+    std::vector<std::string> expected;
+    const size_t blocks = 64;
+    std::string data = script_of(blocks * LINE_READER_BLOCK_SIZE, &expected);
+    int fd = file_with(data);
+    LineReader reader = LineReader_value(fd);
+    bool ring = IoRing_ready(&reader.ring);
+    ASSERT_EQ(expected, lines_of(&reader));
+    if (ring) {
+        ASSERT_LE(LineReader_syscalls(&reader), blocks / LINE_READER_BLOCKS + 2);
+    } else {
+        ASSERT_LE(LineReader_syscalls(&reader), blocks + 2);
+    }
+    LineReader_drop(&reader);
+    close(fd);
+}
+
+TEST(LineReaderSpec, sync_hands_over_the_offset)
+{
+    int fd = file_with("echo a\ncat\nunread\necho b\n");
+    LineReader reader = LineReader_value(fd);
+    ASSERT_EQ("echo a\n", next_line(&reader));
+    LineReader_sync(&reader);
+    ASSERT_EQ(7, lseek(fd, 0, SEEK_CUR));
+    ASSERT_EQ("cat\n", next_line(&reader));
+
+    /* As though cat had read one more line of the script. */
+    LineReader_sync(&reader);
+    char buffer[7];
+    ASSERT_EQ(7, read(fd, buffer, sizeof(buffer)));
+    ASSERT_EQ("echo b\n", next_line(&reader));
+    ASSERT_EQ("(end)", next_line(&reader));
+    LineReader_drop(&reader);
+    close(fd);
+}
+
+TEST(LineReaderSpec, buffered_pipe_lines)
+{
+    int fds[2];
+    pipe(fds);
+    LineReader reader = LineReader_value(fds[0]);
+    ASSERT_FALSE(LineReader_buffered(&reader));
+    write(fds[1], "a\nb", 3);
+    ASSERT_EQ("a\n", next_line(&reader));
+    ASSERT_FALSE(LineReader_buffered(&reader));
+    write(fds[1], "\n", 1);
+    close(fds[1]);
+    ASSERT_EQ("b\n", next_line(&reader));
+    ASSERT_EQ("(end)", next_line(&reader));
+    ASSERT_TRUE(LineReader_buffered(&reader));
+    LineReader_drop(&reader);
+    close(fds[0]);
+}
@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "MemStats.h"
+#include "Parser.h"
+}
+
+static Scanner fixture(Str *input, const char *cstr)
+{
+    *input = Str_from(cstr);
+    return Scanner_value(CharItr_of_Str(input));
+}
+
+/* Tracks allocations only for the duration of each test. */
+class MemStatsSpec : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        MemStats_enable();
+        MemStats_reset();
+    }
+
+    void TearDown() override
+    {
+        MemStats_disable();
+        MemStats_reset();
+    }
+};
+
+TEST_F(MemStatsSpec, tracks_live_and_peak)
+{
+    Vec v = Vec_value(4, sizeof(int));
+    ASSERT_EQ(4 * sizeof(int), MemStats_live());
+    int x = 1;
+    for (int i = 0; i < 8; ++i) {
+        Vec_set(&v, i, &x);
+    }
+    ASSERT_EQ(8 * sizeof(int), MemStats_live());
+    Vec_drop(&v);
+    ASSERT_EQ(0, MemStats_live());
+    ASSERT_EQ(8 * sizeof(int), MemStats_peak());
+}
+
+TEST_F(MemStatsSpec, attributes_callsites)
+{
+    Vec v = Vec_value(1, sizeof(int));
+    int x = 1;
+    Vec_set(&v, 0, &x);
+    Vec_set(&v, 1, &x);
+    Vec_set(&v, 2, &x);
+
+    MemSite sites[8];
+    size_t count = MemStats_sites(sites, 8);
+    size_t allocs = 0;
+    size_t reallocs = 0;
+    for (size_t i = 0; i < count; ++i) {
+        allocs += sites[i].allocs;
+        reallocs += sites[i].reallocs;
+    }
+    ASSERT_EQ(1, allocs);
+    ASSERT_EQ(2, reallocs);
+    Vec_drop(&v);
+}
+
+TEST_F(MemStatsSpec, parse_releases_everything)
+{
+    Str input;
+    Scanner scanner = fixture(&input, "ls -lah | grep foo | wc -l");
+    Node *ast = parse(&scanner);
+    Node_drop(ast);
+    Str_drop(&input);
+    ASSERT_EQ(0, MemStats_live());
+    ASSERT_LT(0, MemStats_peak());
+}
+
+TEST_F(MemStatsSpec, dump_is_tab_separated)
+{
+    Str s = Str_from("hello");
+    char buffer[4096] = { 0 };
+    FILE *out = fmemopen(buffer, sizeof(buffer), "w");
+    MemStats_dump(out);
+    fclose(out);
+    ASSERT_EQ(0, strncmp("file\tline\tallocs\treallocs\tlive\tpeak\n", buffer, 36));
+    ASSERT_NE(nullptr, strstr(buffer, "MemStatsSpec.cpp\t"));
+    Str_drop(&s);
+}
+
+/* Whether `file` is the path of a file named `name`. */
+static bool names(const char *file, const char *name)
+{
+    size_t length = strlen(file);
+    size_t suffix = strlen(name);
+    return length >= suffix && strcmp(file + length - suffix, name) == 0
+            && (length == suffix || file[length - suffix - 1] == '/');
+}
+
+TEST_F(MemStatsSpec, charges_the_caller)
+{
+    Str s = Str_from("hello");
+    int from_line = __LINE__ - 1;
+    Str_append(&s, ", world and everyone else in it");
+    int append_line = __LINE__ - 1;
+
+    MemSite sites[8];
+    size_t count = MemStats_sites(sites, 8);
+    ASSERT_EQ(2, count);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_TRUE(names(sites[i].file, "MemStatsSpec.cpp")) << sites[i].file;
+        if (sites[i].line == from_line) {
+            ASSERT_EQ(1, sites[i].allocs);
+            ASSERT_EQ(Str_length(&s) + 1, sites[i].live);
+        } else {
+            ASSERT_EQ(append_line, sites[i].line);
+            ASSERT_EQ(1, sites[i].reallocs);
+        }
+    }
+    Str_drop(&s);
+
+    Str input;
+    Scanner scanner = fixture(&input, "ls -lah | grep foo | wc -l");
+    Node *ast = parse(&scanner);
+    count = MemStats_sites(sites, 8);
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_FALSE(names(sites[i].file, "Vec.c")) << sites[i].line;
+        ASSERT_FALSE(names(sites[i].file, "Str.c")) << sites[i].line;
+    }
+    Node_drop(ast);
+    Str_drop(&input);
+}
+
+TEST_F(MemStatsSpec, disabled_ignores_allocations)
+{
+    MemStats_disable();
+    ASSERT_FALSE(MemStats_enabled());
+    Str s = Str_from("hello");
+    ASSERT_EQ(0, MemStats_live());
+    Str_drop(&s);
+    ASSERT_EQ(0, MemStats_live());
+}
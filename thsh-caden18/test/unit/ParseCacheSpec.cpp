@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "ParseCache.h"
+}
+
+static Node* cached(ParseCache *cache, const char *line)
+{
+    return ParseCache_parse(cache, line, strlen(line));
+}
+
+TEST(ParseCacheSpec, miss_then_hit_shares_tree)
+{
+    ParseCache cache = ParseCache_value(1 << 16);
+    Node *first = cached(&cache, "ls -lah | grep foo");
+    Node *second = cached(&cache, "ls -lah | grep foo");
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(PIPE_NODE, first->type);
+    ASSERT_EQ(1, cache.misses);
+    ASSERT_EQ(1, cache.hits);
+    ASSERT_EQ(3, first->refs);
+    Node_drop(first);
+    Node_drop(second);
+    ParseCache_drop(&cache);
+}
+
+TEST(ParseCacheSpec, distinct_lines_distinct_trees)
+{
+    ParseCache cache = ParseCache_value(1 << 16);
+    Node *a = cached(&cache, "grep foo");
+    Node *b = cached(&cache, "grep bar");
+    ASSERT_NE(a, b);
+    ASSERT_STREQ("bar", Command_word(&b->data.command, 1));
+    ASSERT_EQ(2, cache.misses);
+    Node_drop(a);
+    Node_drop(b);
+    ParseCache_drop(&cache);
+}
+
+TEST(ParseCacheSpec, tree_outlives_cache)
+{
+    ParseCache cache = ParseCache_value(1 << 16);
+    Node *tree = cached(&cache, "echo hello");
+    ParseCache_drop(&cache);
+    ASSERT_EQ(1, tree->refs);
+    ASSERT_STREQ("hello", Command_word(&tree->data.command, 1));
+    Node_drop(tree);
+}
+
+TEST(ParseCacheSpec, evicts_least_recently_used)
+{
+    ParseCache cache = ParseCache_value(1 << 16);
+    Node *tree = cached(&cache, "a");
+    size_t entry_bytes = cache.bytes;
+    Node_drop(tree);
+    ParseCache_drop(&cache);
+
+    cache = ParseCache_value(entry_bytes * 2);
+    Node_drop(cached(&cache, "a"));
+    Node_drop(cached(&cache, "b"));
+    Node_drop(cached(&cache, "a")); /* a is now newer than b */
+    Node_drop(cached(&cache, "c")); /* evicts b */
+    ASSERT_EQ(1, cache.evictions);
+    ASSERT_LE(cache.bytes, cache.budget);
+    Node_drop(cached(&cache, "a"));
+    ASSERT_EQ(2, cache.hits);
+    Node_drop(cached(&cache, "b"));
+    ASSERT_EQ(4, cache.misses);
+    ParseCache_drop(&cache);
+}
+
+TEST(ParseCacheSpec, grows_buckets)
+{
+    ParseCache cache = ParseCache_value(1 << 24);
+    char line[32];
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(line, sizeof(line), "cmd %d", i);
+        Node_drop(cached(&cache, line));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(line, sizeof(line), "cmd %d", i);
+        Node_drop(cached(&cache, line));
+    }
+    ASSERT_EQ(1000, cache.misses);
+    ASSERT_EQ(1000, cache.hits);
+    ParseCache_drop(&cache);
+}
@@ -23,9 +23,9 @@ TEST(ParserSpec, simple_command)
     Scanner scanner = fixture("grep foo bar.txt");
     Node *ast = parse(&scanner);
     ASSERT_EQ(COMMAND_NODE, ast->type);
-    ASSERT_STREQ("grep", Str_cstr(StrVec_ref(&ast->data.command, 0)));
-    ASSERT_STREQ("foo", Str_cstr(StrVec_ref(&ast->data.command, 1)));
-    ASSERT_STREQ("bar.txt", Str_cstr(StrVec_ref(&ast->data.command, 2)));
+    ASSERT_STREQ("grep", Command_word(&ast->data.command, 0));
+    ASSERT_STREQ("foo", Command_word(&ast->data.command, 1));
+    ASSERT_STREQ("bar.txt", Command_word(&ast->data.command, 2));
     Node_drop(ast);
 }
 
@@ -38,13 +38,13 @@ TEST(ParserSpec, pipe_command)
 
     Node *lhs = ast->data.pipe.left;
     ASSERT_EQ(COMMAND_NODE, lhs->type);
-    ASSERT_STREQ("ls", Str_cstr(StrVec_ref(&lhs->data.command, 0)));
-    ASSERT_STREQ("-lah", Str_cstr(StrVec_ref(&lhs->data.command, 1)));
+    ASSERT_STREQ("ls", Command_word(&lhs->data.command, 0));
+    ASSERT_STREQ("-lah", Command_word(&lhs->data.command, 1));
 
     Node *rhs = ast->data.pipe.right;
     ASSERT_EQ(COMMAND_NODE, rhs->type);
-    ASSERT_STREQ("grep", Str_cstr(StrVec_ref(&rhs->data.command, 0)));
-    ASSERT_STREQ("foo", Str_cstr(StrVec_ref(&rhs->data.command, 1)));
+    ASSERT_STREQ("grep", Command_word(&rhs->data.command, 0));
+    ASSERT_STREQ("foo", Command_word(&rhs->data.command, 1));
 
     Node_drop(ast);
 }
@@ -58,22 +58,481 @@ TEST(ParserSpec, multiple_pipe_command)
 
     Node *lhs = ast->data.pipe.left;
     ASSERT_EQ(COMMAND_NODE, lhs->type);
-    ASSERT_STREQ("ls", Str_cstr(StrVec_ref(&lhs->data.command, 0)));
-    ASSERT_STREQ("-lah", Str_cstr(StrVec_ref(&lhs->data.command, 1)));
+    ASSERT_STREQ("ls", Command_word(&lhs->data.command, 0));
+    ASSERT_STREQ("-lah", Command_word(&lhs->data.command, 1));
 
     Node *rhs = ast->data.pipe.right;
     ASSERT_EQ(PIPE_NODE, rhs->type);
 
     Node *rhs_lhs = rhs->data.pipe.left;
     ASSERT_EQ(COMMAND_NODE, rhs_lhs->type);
-    ASSERT_STREQ("grep", Str_cstr(StrVec_ref(&rhs_lhs->data.command, 0)));
-    ASSERT_STREQ("-E", Str_cstr(StrVec_ref(&rhs_lhs->data.command, 1)));
-    ASSERT_STREQ("foo", Str_cstr(StrVec_ref(&rhs_lhs->data.command, 2)));
+    ASSERT_STREQ("grep", Command_word(&rhs_lhs->data.command, 0));
+    ASSERT_STREQ("-E", Command_word(&rhs_lhs->data.command, 1));
+    ASSERT_STREQ("foo", Command_word(&rhs_lhs->data.command, 2));
 
     Node *rhs_rhs = rhs->data.pipe.right;
     ASSERT_EQ(COMMAND_NODE, rhs_rhs->type);
-    ASSERT_STREQ("less", Str_cstr(StrVec_ref(&rhs_rhs->data.command, 0)));
+    ASSERT_STREQ("less", Command_word(&rhs_rhs->data.command, 0));
 
     Node_drop(ast);
 }
 
+
+TEST(ParserSpec, long_command_spills_words)
+{
+    Scanner scanner = fixture("echo a bb ccc dddd eeeee ffffff");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(COMMAND_NODE, ast->type);
+    ASSERT_EQ(7, Command_length(&ast->data.command));
+    char *const *argv = Command_argv(&ast->data.command);
+    ASSERT_STREQ("echo", argv[0]);
+    ASSERT_STREQ("dddd", argv[4]);
+    ASSERT_STREQ("ffffff", argv[6]);
+    ASSERT_EQ(nullptr, argv[7]);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, short_command_is_inline)
+{
+    Scanner scanner = fixture("wc -l");
+    Node *ast = parse(&scanner);
+    char *const *argv = Command_argv(&ast->data.command);
+    ASSERT_EQ((const void*) ast->data.command.argv.inline_argv, (const void*) argv);
+    ASSERT_STREQ("-l", argv[1]);
+    ASSERT_EQ(nullptr, argv[2]);
+    ASSERT_EQ(sizeof("wc") + sizeof("-l"), Node_footprint(ast) - sizeof(Node));
+    ASSERT_LE(sizeof(Node), 64);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, redirects)
+{
+    Scanner scanner = fixture("<in sort -r >out 2>&1 | wc >> log 2> err");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(PIPE_NODE, ast->type);
+
+    const CommandValue *sort = &ast->data.pipe.left->data.command;
+    ASSERT_EQ(2, Command_length(sort));
+    ASSERT_STREQ("sort", Command_word(sort, 0));
+    ASSERT_STREQ("-r", Command_word(sort, 1));
+    ASSERT_EQ(nullptr, Command_argv(sort)[2]);
+    ASSERT_EQ(3, Command_redirect_count(sort));
+    const Redirect *redirects = Command_redirects(sort);
+    ASSERT_EQ(REDIRECT_IN, redirects[0].type);
+    ASSERT_STREQ("in", redirects[0].target);
+    ASSERT_EQ(REDIRECT_OUT, redirects[1].type);
+    ASSERT_STREQ("out", redirects[1].target);
+    ASSERT_EQ(REDIRECT_ERR_TO_OUT, redirects[2].type);
+    ASSERT_EQ(nullptr, redirects[2].target);
+
+    const CommandValue *wc = &ast->data.pipe.right->data.command;
+    ASSERT_EQ(1, Command_length(wc));
+    redirects = Command_redirects(wc);
+    ASSERT_EQ(REDIRECT_APPEND, redirects[0].type);
+    ASSERT_STREQ("log", redirects[0].target);
+    ASSERT_EQ(REDIRECT_ERR, redirects[1].type);
+    ASSERT_STREQ("err", redirects[1].target);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, long_command_redirects)
+{
+    Scanner scanner = fixture("a b c d e > f");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(5, Command_length(&ast->data.command));
+    ASSERT_STREQ("e", Command_word(&ast->data.command, 4));
+    ASSERT_STREQ("f", Command_redirects(&ast->data.command)[0].target);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, redirect_errors)
+{
+    const char *inputs[] = { "ls >", "ls > | wc", "< in", "ls | >out" };
+    const char *errors[] = {
+        "Expected a file name after a redirection",
+        "Expected a file name after a redirection",
+        "Expected a command",
+        "Expected a command",
+    };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        Scanner scanner = fixture(inputs[i]);
+        Node *ast = parse(&scanner);
+        ASSERT_EQ(ERROR_NODE, ast->type);
+        ASSERT_STREQ(errors[i], ast->data.error);
+        Node_drop(ast);
+    }
+}
+
+TEST(ParserSpec, substitutions)
+{
+    Scanner scanner = fixture("ls -l $(which cc)x y`echo a | $(echo tr) a b` > out");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(COMMAND_NODE, ast->type);
+    const CommandValue *ls = &ast->data.command;
+    ASSERT_EQ(4, Command_length(ls));
+    ASSERT_STREQ("$(which cc)x", Command_word(ls, 2));
+    ASSERT_STREQ("out", Command_redirects(ls)[0].target);
+    ASSERT_EQ(2, Command_substitution_count(ls));
+
+    const Substitution *which = &Command_substitutions(ls)[0];
+    ASSERT_EQ(2, which->word);
+    ASSERT_EQ(0, which->start);
+    ASSERT_EQ(11, which->length);
+    ASSERT_EQ(COMMAND_NODE, which->tree->type);
+    ASSERT_STREQ("cc", Command_word(&which->tree->data.command, 1));
+
+    const Substitution *echo = &Command_substitutions(ls)[1];
+    ASSERT_EQ(3, echo->word);
+    ASSERT_EQ(1, echo->start);
+    ASSERT_EQ(PIPE_NODE, echo->tree->type);
+    const CommandValue *tr = &echo->tree->data.pipe.right->data.command;
+    ASSERT_EQ(1, Command_substitution_count(tr));
+    ASSERT_GT(Node_footprint(ast), Node_footprint(echo->tree) + Node_footprint(which->tree));
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, substitution_errors)
+{
+    const char *inputs[] = {
+        "echo $(ls", "echo `ls", "echo $()", "echo $(ls |)", "echo $(ls >)", "ls > $(f)", "echo $(a)$(<)",
+        "echo x > out_$HOME", "cat < ${f}", "for x in a b; do echo hi >> out_$x; done"
+    };
+    const char *errors[] = {
+        "Expected ) or ` to close a command substitution",
+        "Expected ) or ` to close a command substitution",
+        "Expected a command in a command substitution",
+        "Expected a command in a command substitution",
+        "Expected a file name after a redirection",
+        "Expected a file name without a command substitution or variable",
+        "Expected a file name after a redirection",
+        "Expected a file name without a command substitution or variable",
+        "Expected a file name without a command substitution or variable",
+        "Expected a file name without a command substitution or variable",
+    };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        Scanner scanner = fixture(inputs[i]);
+        Node *ast = parse(&scanner);
+        ASSERT_EQ(ERROR_NODE, ast->type);
+        ASSERT_STREQ(errors[i], ast->data.error);
+        Node_drop(ast);
+    }
+
+    /* A '$' that begins no variable is part of the file name. */
+    Scanner scanner = fixture("echo x > cost$ 2> $1");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(COMMAND_NODE, ast->type);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, background)
+{
+    Scanner scanner = fixture("sleep 1 | cat&");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(BACKGROUND_NODE, ast->type);
+    Node *pipeline = ast->data.background.pipeline;
+    ASSERT_EQ(PIPE_NODE, pipeline->type);
+    ASSERT_STREQ("cat", Command_word(&pipeline->data.pipe.right->data.command, 0));
+    Node_drop(ast);
+
+    const char *inputs[] = { "a & b", "&", "a | &" };
+    const char *errors[] = {
+        "Expected the end of the line after &",
+        "Expected a command",
+        "Expected a command",
+    };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        scanner = fixture(inputs[i]);
+        ast = parse(&scanner);
+        ASSERT_EQ(ERROR_NODE, ast->type);
+        ASSERT_STREQ(errors[i], ast->data.error);
+        Node_drop(ast);
+    }
+}
+
+TEST(ParserSpec, lists)
+{
+    Scanner scanner = fixture("a && b | c; d || e; f &\n\n g\n");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(AND_NODE, ast->type);
+    ASSERT_STREQ("a", Command_word(&ast->data.list.left->data.command, 0));
+    Node *rest = ast->data.list.right;
+    ASSERT_EQ(SEQUENCE_NODE, rest->type);
+    ASSERT_EQ(PIPE_NODE, rest->data.list.left->type);
+    rest = rest->data.list.right;
+    ASSERT_EQ(OR_NODE, rest->type);
+    ASSERT_STREQ("d", Command_word(&rest->data.list.left->data.command, 0));
+    rest = rest->data.list.right;
+    ASSERT_EQ(SEQUENCE_NODE, rest->type);
+    ASSERT_STREQ("e", Command_word(&rest->data.list.left->data.command, 0));
+    rest = rest->data.list.right;
+    ASSERT_EQ(SEQUENCE_NODE, rest->type);
+    ASSERT_EQ(BACKGROUND_NODE, rest->data.list.left->type);
+    ASSERT_EQ(COMMAND_NODE, rest->data.list.right->type);
+    ASSERT_STREQ("g", Command_word(&rest->data.list.right->data.command, 0));
+    Node_drop(ast);
+
+    /* A trailing ';' ends the list; a newline after && continues it. */
+    scanner = fixture("a ;");
+    ast = parse(&scanner);
+    ASSERT_EQ(COMMAND_NODE, ast->type);
+    Node_drop(ast);
+    scanner = fixture("a ||\n b > out\nc");
+    ast = parse(&scanner);
+    ASSERT_EQ(OR_NODE, ast->type);
+    ASSERT_EQ(1, Command_redirect_count(&ast->data.list.right->data.list.left->data.command));
+    ASSERT_EQ(SEQUENCE_NODE, ast->data.list.right->type);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, long_and_chain)
+{
+    std::string input = "true";
+    for (int i = 0; i < 100000; ++i) {
+        input += " && true";
+    }
+    Scanner scanner = fixture(input.c_str());
+    Node *ast = parse(&scanner);
+    size_t clauses = 1;
+    for (Node *node = ast; node->type == AND_NODE; node = node->data.list.right) {
+        ++clauses;
+    }
+    ASSERT_EQ(100001, clauses);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, list_errors)
+{
+    const char *inputs[] = { "; a", "a ;; b", "a && ; b", "a && b &", "a ||", "a\n| b",
+        "a >\nb", "$(a &&)" };
+    const char *errors[] = {
+        "Expected a command",
+        "Expected a command",
+        "Expected a command",
+        "Expected a pipeline without && or || before &",
+        "Expected a command after && or ||",
+        "Expected a command",
+        "Expected a file name after a redirection",
+        "Expected a command in a command substitution",
+    };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        Scanner scanner = fixture(inputs[i]);
+        Node *ast = parse(&scanner);
+        ASSERT_EQ(ERROR_NODE, ast->type);
+        ASSERT_STREQ(errors[i], ast->data.error);
+        Node_drop(ast);
+    }
+}
+
+TEST(ParserSpec, loops)
+{
+    Scanner scanner = fixture("for x in a $(ls) $y; do echo $x; done && while true\ndo\n a; b\ndone");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(AND_NODE, ast->type);
+    Node *loop = ast->data.list.left;
+    ASSERT_EQ(FOR_NODE, loop->type);
+    const CommandValue *head = &loop->data.loop.head->data.command;
+    ASSERT_EQ(4, Command_length(head));
+    ASSERT_STREQ("x", Command_word(head, 0));
+    ASSERT_EQ(2, Command_substitution_count(head));
+    ASSERT_NE(nullptr, Command_substitutions(head)[0].tree);
+    ASSERT_EQ(nullptr, Command_substitutions(head)[1].tree);
+    const CommandValue *body = &loop->data.loop.body->data.command;
+    ASSERT_STREQ("$x", Command_word(body, 1));
+    ASSERT_EQ(1, Command_substitution_count(body));
+    ASSERT_EQ(0, Command_substitutions(body)[0].start);
+    ASSERT_EQ(2, Command_substitutions(body)[0].length);
+
+    loop = ast->data.list.right;
+    ASSERT_EQ(WHILE_NODE, loop->type);
+    ASSERT_EQ(COMMAND_NODE, loop->data.loop.head->type);
+    ASSERT_EQ(SEQUENCE_NODE, loop->data.loop.body->type);
+    Node_drop(ast);
+
+    /* Keywords are only keywords where a command would begin. */
+    scanner = fixture("for do in for done; do echo done; for y in; do echo for; done; done");
+    ast = parse(&scanner);
+    ASSERT_EQ(FOR_NODE, ast->type);
+    ASSERT_STREQ("do", Command_word(&ast->data.loop.head->data.command, 0));
+    Node *inner = ast->data.loop.body->data.list.right;
+    ASSERT_EQ(FOR_NODE, inner->type);
+    ASSERT_EQ(1, Command_length(&inner->data.loop.head->data.command));
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, loop_errors)
+{
+    const char *inputs[] = {
+        "done", "do a", "a | for x in b; do c; done", "for 1 in a; do b; done",
+        "for x a; do b; done", "for x in a | b; do c; done", "for x in a > f; do b; done",
+        "while a; b; done", "for x in a b do c; done", "for x in a; do done",
+        "for x in a; do b; done c", "for x in a; do b; done &", "for x in a; do b", "while a"
+    };
+    const char *errors[] = {
+        "Expected a command, found a keyword",
+        "Expected a command, found a keyword",
+        "Expected a command, found a keyword",
+        "Expected a variable name after for",
+        "Expected in after the name of a for loop",
+        "Expected ; or a new line after the words of a for loop",
+        "Expected ; or a new line after the words of a for loop",
+        "Expected a command, found a keyword",
+        "Expected do after the head of a loop",
+        "Expected a command, found a keyword",
+        "Expected ;, &&, || or a new line after done",
+        "Expected ;, &&, || or a new line after done",
+        PARSE_INCOMPLETE_LOOP,
+        PARSE_INCOMPLETE_LOOP,
+    };
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        Scanner scanner = fixture(inputs[i]);
+        Node *ast = parse(&scanner);
+        ASSERT_EQ(ERROR_NODE, ast->type) << inputs[i];
+        ASSERT_STREQ(errors[i], ast->data.error) << inputs[i];
+        Node_drop(ast);
+    }
+}
+
+TEST(ParserSpec, trailing_pipe_is_incomplete)
+{
+    Scanner scanner = fixture("ls |");
+    Node *ast = parse(&scanner);
+    ASSERT_EQ(ERROR_NODE, ast->type);
+    ASSERT_EQ(PARSE_INCOMPLETE, ast->data.error);
+    Node_drop(ast);
+}
+
+TEST(ParserSpec, push_parser_resumes)
+{
+    PushParser parser = PushParser_value();
+    ASSERT_FALSE(PushParser_pending(&parser));
+    const char *first = "ls -lah |\n";
+    ASSERT_EQ(nullptr, PushParser_push(&parser, first, strlen(first)));
+    ASSERT_TRUE(PushParser_pending(&parser));
+    ASSERT_EQ(nullptr, PushParser_push(&parser, " \n", 2));
+    const char *second = "grep foo | \n";
+    ASSERT_EQ(nullptr, PushParser_push(&parser, second, strlen(second)));
+    const char *third = "wc -l\n";
+    Node *ast = PushParser_push(&parser, third, strlen(third));
+    ASSERT_FALSE(PushParser_pending(&parser));
+    ASSERT_EQ(PIPE_NODE, ast->type);
+    ASSERT_STREQ("-lah", Command_word(&ast->data.pipe.left->data.command, 1));
+    Node *rhs = ast->data.pipe.right;
+    ASSERT_STREQ("foo", Command_word(&rhs->data.pipe.left->data.command, 1));
+    ASSERT_STREQ("wc", Command_word(&rhs->data.pipe.right->data.command, 0));
+    Node_drop(ast);
+
+    ast = PushParser_push(&parser, "echo\n", 5);
+    ASSERT_EQ(COMMAND_NODE, ast->type);
+    Node_drop(ast);
+    ASSERT_EQ(nullptr, PushParser_finish(&parser));
+    PushParser_drop(&parser);
+}
+
+TEST(ParserSpec, push_parser_errors)
+{
+    PushParser parser = PushParser_value();
+    ASSERT_EQ(nullptr, PushParser_push(&parser, "a |", 3));
+    Node *ast = PushParser_push(&parser, "| b", 3);
+    ASSERT_EQ(ERROR_NODE, ast->type);
+    ASSERT_STREQ("Expected a command", ast->data.error);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    Node_drop(ast);
+
+    ast = PushParser_push(&parser, "\n", 1);
+    ASSERT_EQ(PARSE_EMPTY_INPUT, ast->data.error);
+    Node_drop(ast);
+
+    ASSERT_EQ(nullptr, PushParser_push(&parser, "a |", 3));
+    ast = PushParser_finish(&parser);
+    ASSERT_EQ(PARSE_INCOMPLETE, ast->data.error);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    Node_drop(ast);
+
+    ASSERT_EQ(nullptr, PushParser_push(&parser, "a ; b &&", 8));
+    ast = PushParser_finish(&parser);
+    ASSERT_EQ(PARSE_INCOMPLETE_LIST, ast->data.error);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    Node_drop(ast);
+    PushParser_drop(&parser);
+}
+
+TEST(ParserSpec, push_parser_resumes_loops)
+{
+    PushParser parser = PushParser_value();
+    const char *lines[] = { "a &&\n", "for x in 1 2\n", "do\n", "  while b; do c; done\n" };
+    for (const char *line : lines) {
+        ASSERT_EQ(nullptr, PushParser_push(&parser, line, strlen(line)));
+        ASSERT_TRUE(PushParser_pending(&parser));
+    }
+    Node *ast = PushParser_push(&parser, "done\n", 5);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    ASSERT_EQ(AND_NODE, ast->type);
+    Node *loop = ast->data.list.right;
+    ASSERT_EQ(FOR_NODE, loop->type);
+    ASSERT_EQ(WHILE_NODE, loop->data.loop.body->type);
+    Node_drop(ast);
+
+    ASSERT_EQ(nullptr, PushParser_push(&parser, "while a\n", 8));
+    ast = PushParser_finish(&parser);
+    ASSERT_EQ(PARSE_INCOMPLETE_LOOP, ast->data.error);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    Node_drop(ast);
+    PushParser_drop(&parser);
+}
+
+TEST(ParserSpec, push_parser_parses_long_loops_once)
+{
+    PushParser parser = PushParser_value();
+    const char *head[] = { "for x in done for\n", "do\n", "  while a | b; do\n" };
+    for (const char *line : head) {
+        ASSERT_EQ(nullptr, PushParser_push(&parser, line, strlen(line)));
+    }
+    /* Keywords that are only words, and a 'done' naming a variable within a substitution. */
+    const char *words[] = {
+        "    echo done for\n", "    echo $(for\n", "done in a; do echo $done; done)\n"
+    };
+    for (const char *line : words) {
+        ASSERT_EQ(nullptr, PushParser_push(&parser, line, strlen(line)));
+    }
+    const size_t lines = 20000;
+    for (size_t i = 0; i < lines; ++i) {
+        ASSERT_EQ(nullptr, PushParser_push(&parser, "    echo $x\n", 12));
+    }
+    ASSERT_EQ(nullptr, PushParser_push(&parser, "  done\n", 7));
+    ASSERT_TRUE(PushParser_pending(&parser));
+    Node *ast = PushParser_push(&parser, "done\n", 5);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    ASSERT_EQ(FOR_NODE, ast->type);
+    ASSERT_EQ(3, Command_length(&ast->data.loop.head->data.command));
+    Node *inner = ast->data.loop.body;
+    ASSERT_EQ(WHILE_NODE, inner->type);
+    ASSERT_EQ(PIPE_NODE, inner->data.loop.head->type);
+    size_t commands = 1;
+    for (Node *body = inner->data.loop.body; body->type == SEQUENCE_NODE;
+            body = body->data.list.right) {
+        ++commands;
+    }
+    ASSERT_EQ(lines + 2, commands);
+    Node_drop(ast);
+    PushParser_drop(&parser);
+}
+
+TEST(ParserSpec, push_parser_resumes_lists)
+{
+    PushParser parser = PushParser_value();
+    const char *first = "a; b &&\n";
+    ASSERT_EQ(nullptr, PushParser_push(&parser, first, strlen(first)));
+    ASSERT_TRUE(PushParser_pending(&parser));
+    ASSERT_EQ(nullptr, PushParser_push(&parser, "\n", 1));
+    const char *second = "c | \n";
+    ASSERT_EQ(nullptr, PushParser_push(&parser, second, strlen(second)));
+    Node *ast = PushParser_push(&parser, "d\n", 2);
+    ASSERT_FALSE(PushParser_pending(&parser));
+    ASSERT_EQ(SEQUENCE_NODE, ast->type);
+    Node *rest = ast->data.list.right;
+    ASSERT_EQ(AND_NODE, rest->type);
+    ASSERT_STREQ("b", Command_word(&rest->data.list.left->data.command, 0));
+    ASSERT_EQ(PIPE_NODE, rest->data.list.right->type);
+    Node_drop(ast);
+    PushParser_drop(&parser);
+}
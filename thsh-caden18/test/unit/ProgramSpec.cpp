@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include "SpecHelpers.h"
+
+extern "C" {
+#include <unistd.h>
+#include "Exec.h"
+#include "Parser.h"
+#include "Program.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+/* Run `tree` by walking it, or compiled, for its output and status. */
+static std::string run(const Node *tree, bool compiled, int *status)
+{
+    FILE *out = tmpfile();
+    if (compiled) {
+        Program program = Program_compile(tree);
+        *status = Program_run(&program, STDIN_FILENO, fileno(out), NULL);
+        Program_drop(&program);
+    } else {
+        *status = execute(tree, STDIN_FILENO, fileno(out));
+    }
+    std::string result = contents(out);
+    fclose(out);
+    return result;
+}
+
+static std::vector<Opcode> opcodes(const char *cstr)
+{
+    Node *tree = fixture(cstr);
+    Program program = Program_compile(tree);
+    std::vector<Opcode> result;
+    for (size_t i = 0; i < Vec_length(&program.code); ++i) {
+        result.push_back((Opcode) ((Instruction*) Vec_ref(&program.code, i))->opcode);
+    }
+    Program_drop(&program);
+    Node_drop(tree);
+    return result;
+}
+
+/** TESTS **/
+
+TEST(ProgramSpec, matches_tree_walk)
+{
+    const char *scripts[] = {
+        "echo a",
+        "echo a | cat",
+        "false",
+        "/bin/echo a b",
+        "no_such_command_thsh",
+        "echo a; echo b; false",
+        "true && echo a && echo b",
+        "false && echo a || echo b",
+        "true || echo a && echo b",
+        "false || false || echo a; echo b",
+        "false && echo a; true || echo b",
+        "echo $(echo a b) c",
+        "for i in a b c; do echo $i; done",
+        "for i in; do echo $i; done",
+        "for i in $(echo a b); do echo $i; false; done",
+        "for i in a b; do for j in 1 2; do echo $i$j; done; done; echo $i",
+        "for i in a b; do echo $(echo $i) | cat; done",
+        "for i in a b c; do true && echo $i || echo no; done",
+        "for i in a b; do for i in c; do echo $i; done; echo $i; done",
+        "while false; do echo a; done",
+        "while true && false; do echo a; done",
+        "for i in 1 2; do while false; do echo a; done; done",
+        "for i in 1 2; do echo $i; done && echo a || echo b",
+        "false; for i in 1; do false; done || echo failed",
+        "echo a |",
+        "for i in a; do",
+        "done",
+    };
+    for (const char *script : scripts) {
+        Node *tree = fixture(script);
+        int walked, compiled;
+        std::string expected = run(tree, false, &walked);
+        EXPECT_EQ(expected, run(tree, true, &compiled)) << script;
+        EXPECT_EQ(walked, compiled) << script;
+        Node_drop(tree);
+    }
+}
+
+TEST(ProgramSpec, lone_builtins_are_called_directly)
+{
+    ASSERT_EQ(std::vector<Opcode>({ OP_BUILTIN, OP_HALT }), opcodes("echo a"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_RUN, OP_HALT }), opcodes("echo $HOME"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_RUN, OP_HALT }), opcodes("echo a > /dev/null"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_RUN, OP_HALT }), opcodes("echo a | cat"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_RUN, OP_HALT }), opcodes("echo a &"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_RUN, OP_HALT }), opcodes("jobs"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_RUN, OP_HALT }), opcodes("ls"));
+}
+
+TEST(ProgramSpec, lists_and_loops_are_flat)
+{
+    ASSERT_EQ(std::vector<Opcode>({
+        OP_BUILTIN, OP_JUMP_IF_FAILED, OP_BUILTIN, OP_JUMP_IF_SUCCEEDED, OP_BUILTIN, OP_HALT
+    }), opcodes("true && echo a || echo b"));
+    ASSERT_EQ(std::vector<Opcode>({
+        OP_FOR, OP_NEXT, OP_BUILTIN, OP_REPEAT, OP_HALT
+    }), opcodes("for i in a b; do true; done"));
+    ASSERT_EQ(std::vector<Opcode>({
+        OP_WHILE, OP_BUILTIN, OP_TEST, OP_BUILTIN, OP_REPEAT, OP_HALT
+    }), opcodes("while false; do true; done"));
+    ASSERT_EQ(std::vector<Opcode>({ OP_ERROR, OP_HALT }), opcodes("echo a |"));
+}
+
+TEST(ProgramSpec, deep_loops)
+{
+    /* Deeper than the frames kept on the stack. */
+    std::string script;
+    for (int i = 0; i < 12; ++i) {
+        script += "for v" + std::to_string(i) + " in " + std::to_string(i) + "; do ";
+    }
+    script += "echo";
+    for (int i = 0; i < 12; ++i) {
+        script += " $v" + std::to_string(i);
+    }
+    for (int i = 0; i < 12; ++i) {
+        script += "; done";
+    }
+    Node *tree = fixture(script.c_str());
+    int walked, compiled;
+    std::string output = run(tree, true, &compiled);
+    ASSERT_EQ(run(tree, false, &walked), output);
+    ASSERT_EQ(walked, compiled);
+    ASSERT_EQ(std::string("0 1 2 3 4 5 6 7 8 9 10 11\n"), output);
+    Node_drop(tree);
+}
@@ -0,0 +1,192 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "Rescan.h"
+#include "ParallelScan.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static void ASSERT_SPANS_EQ(const TokenSpans *expect, const TokenSpans *actual)
+{
+    ASSERT_EQ(Vec_length(expect), Vec_length(actual));
+    for (size_t i = 0; i < Vec_length(expect); ++i) {
+        Token *e = (Token*) Vec_ref(expect, i);
+        Token *a = (Token*) Vec_ref(actual, i);
+        ASSERT_EQ(e->type, a->type) << "token " << i;
+        ASSERT_EQ(e->flags, a->flags) << "token " << i;
+        ASSERT_EQ(e->offset, a->offset) << "token " << i;
+        ASSERT_EQ(e->length, a->length) << "token " << i;
+    }
+}
+
+/*
+ * Apply an edit to `text`, incrementally rescan `spans`, and check the
+ * result against a full scan of the edited text.
+ */
+static size_t edit_and_check(
+        Str *text,
+        TokenSpans *spans,
+        size_t offset,
+        size_t deleted,
+        const char *inserted)
+{
+    Edit edit = { offset, deleted, strlen(inserted) };
+    Str_splice(text, offset, deleted, inserted, edit.inserted);
+    size_t relexed = TokenSpans_rescan(spans, Str_cstr(text), Str_length(text), edit);
+    TokenSpans full = TokenSpans_scan(Str_cstr(text), Str_length(text));
+    ASSERT_SPANS_EQ(&full, spans);
+    Vec_drop(&full);
+    return relexed;
+}
+
+/** TESTS **/
+
+TEST(RescanSpec, scan_spans)
+{
+    const char *input = " ls -l| wc ";
+    TokenSpans spans = TokenSpans_scan(input, strlen(input));
+    ASSERT_EQ(4, Vec_length(&spans));
+    Token *pipe = (Token*) Vec_ref(&spans, 2);
+    ASSERT_EQ(PIPE_TOKEN, pipe->type);
+    ASSERT_EQ(6, pipe->offset);
+    ASSERT_EQ(1, pipe->length);
+    ASSERT_EQ(0, pipe->flags);
+    Vec_drop(&spans);
+}
+
+TEST(RescanSpec, insert_into_word)
+{
+    Str text = Str_from("ls -lah | grep foo | wc -l");
+    TokenSpans spans = TokenSpans_scan(Str_cstr(&text), Str_length(&text));
+    ASSERT_EQ(1, edit_and_check(&text, &spans, 12, 0, "x"));
+    ASSERT_STREQ("ls -lah | grxep foo | wc -l", Str_cstr(&text));
+    Vec_drop(&spans);
+    Str_drop(&text);
+}
+
+TEST(RescanSpec, append_to_end)
+{
+    Str text = Str_from("ls -la");
+    TokenSpans spans = TokenSpans_scan(Str_cstr(&text), Str_length(&text));
+    edit_and_check(&text, &spans, 6, 0, "h");
+    edit_and_check(&text, &spans, 7, 0, " ");
+    edit_and_check(&text, &spans, 8, 0, "|");
+    edit_and_check(&text, &spans, 9, 0, "w");
+    ASSERT_EQ(4, Vec_length(&spans));
+    Vec_drop(&spans);
+    Str_drop(&text);
+}
+
+TEST(RescanSpec, split_and_join_words)
+{
+    Str text = Str_from("abcd efg");
+    TokenSpans spans = TokenSpans_scan(Str_cstr(&text), Str_length(&text));
+    edit_and_check(&text, &spans, 2, 0, " ");
+    ASSERT_EQ(3, Vec_length(&spans));
+    edit_and_check(&text, &spans, 2, 1, "");
+    ASSERT_EQ(2, Vec_length(&spans));
+    edit_and_check(&text, &spans, 4, 1, "");
+    ASSERT_EQ(1, Vec_length(&spans));
+    edit_and_check(&text, &spans, 0, 7, "|");
+    ASSERT_EQ(1, Vec_length(&spans));
+    Vec_drop(&spans);
+    Str_drop(&text);
+}
+
+TEST(RescanSpec, relexes_locally)
+{
+    Str text = Str_value(0);
+    for (int i = 0; i < 500; ++i) {
+        Str_append(&text, "word | ");
+    }
+    TokenSpans spans = TokenSpans_scan(Str_cstr(&text), Str_length(&text));
+    ASSERT_LE(edit_and_check(&text, &spans, 1400, 0, "x"), 2);
+    ASSERT_LE(edit_and_check(&text, &spans, 1401, 1, ""), 2);
+    Vec_drop(&spans);
+    Str_drop(&text);
+}
+
+TEST(RescanSpec, random_edits_match_full_scan)
+{
+    const char alphabet[] = "ab |\t\n2>&1<";
+    srand(42);
+    Str text = Str_from("echo a | grep b c|d");
+    TokenSpans spans = TokenSpans_scan(Str_cstr(&text), Str_length(&text));
+    for (int i = 0; i < 2000; ++i) {
+        size_t length = Str_length(&text);
+        size_t offset = rand() % (length + 1);
+        size_t deleted = rand() % 3;
+        if (offset + deleted > length) {
+            deleted = length - offset;
+        }
+        char inserted[4] = { 0 };
+        size_t inserted_count = rand() % 4;
+        for (size_t j = 0; j < inserted_count; ++j) {
+            inserted[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        edit_and_check(&text, &spans, offset, deleted, inserted);
+        if (HasFatalFailure()) {
+            break;
+        }
+    }
+    Vec_drop(&spans);
+    Str_drop(&text);
+}
+
+TEST(RescanSpec, parallel_matches_sequential)
+{
+    const char *lines[] = {
+        "ls -lah | grep foo\n",
+        "\n",
+        "   echo a b c|wc -l  \n",
+        "cat file.txt\t| sort | uniq\n",
+        "|\n",
+        "echo $(ls\n",
+        "| wc -l)\n",
+        "echo `a\n",
+        "b`\n",
+        "x$(a $(b)\n",
+        ")\n",
+        "`\n",
+    };
+    srand(7);
+    Str input = Str_value(0);
+    for (int i = 0; i < 3000; ++i) {
+        Str_append(&input, lines[rand() % (sizeof(lines) / sizeof(lines[0]))]);
+    }
+    Str_append(&input, "tail without newline");
+
+    TokenSpans expect = TokenSpans_scan(Str_cstr(&input), Str_length(&input));
+    size_t chunk_sizes[] = { 1, 7, 64, 4096, 1 << 20 };
+    for (size_t chunk_size : chunk_sizes) {
+        for (size_t threads = 1; threads <= 4; ++threads) {
+            TokenSpans actual = TokenSpans_scan_parallel(
+                    Str_cstr(&input), Str_length(&input), threads, chunk_size);
+            ASSERT_SPANS_EQ(&expect, &actual);
+            Vec_drop(&actual);
+        }
+    }
+    Vec_drop(&expect);
+    Str_drop(&input);
+}
+
+TEST(RescanSpec, parallel_substitutions_spanning_lines)
+{
+    const char *input = "echo $(ls\n| wc -l)\necho `a\nb`\n";
+    TokenSpans expect = TokenSpans_scan(input, strlen(input));
+    ASSERT_EQ(4, Vec_length(&expect));
+    for (size_t chunk_size = 1; chunk_size <= strlen(input); ++chunk_size) {
+        TokenSpans actual = TokenSpans_scan_parallel(input, strlen(input), 2, chunk_size);
+        ASSERT_SPANS_EQ(&expect, &actual);
+        Vec_drop(&actual);
+    }
+    Vec_drop(&expect);
+}
+
+TEST(RescanSpec, parallel_empty_input)
+{
+    TokenSpans spans = TokenSpans_scan_parallel("", 0, 4, 16);
+    ASSERT_EQ(0, Vec_length(&spans));
+    Vec_drop(&spans);
+}
@@ -0,0 +1,148 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <unistd.h>
+#include "Exec.h"
+#include "Runner.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static std::string write_script(const std::string &body)
+{
+    char path[] = "/tmp/thsh-runner-XXXXXX";
+    int fd = mkstemp(path);
+    EXPECT_EQ((ssize_t) body.size(), write(fd, body.data(), body.size()));
+    close(fd);
+    return path;
+}
+
+static std::string run_scripts(
+        const std::vector<std::string> &paths,
+        size_t workers,
+        std::vector<int> &statuses,
+        int *status,
+        const char *cache_dir = NULL)
+{
+    std::vector<const char*> cpaths;
+    for (const std::string &path : paths) {
+        cpaths.push_back(path.c_str());
+    }
+    statuses.assign(paths.size(), -1);
+    FILE *out = tmpfile();
+    *status = Runner_run(cpaths.data(), cpaths.size(), workers, fileno(out), statuses.data(),
+            cache_dir);
+    std::string result;
+    char buffer[256];
+    lseek(fileno(out), 0, SEEK_SET);
+    ssize_t n;
+    while ((n = read(fileno(out), buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, n);
+    }
+    fclose(out);
+    return result;
+}
+
+/** TESTS **/
+
+TEST(RunnerSpec, output_in_script_order)
+{
+    std::vector<std::string> paths;
+    std::string expect;
+    for (int i = 0; i < 24; ++i) {
+        std::string n = std::to_string(i);
+        paths.push_back(write_script("echo " + n + "\n\necho a " + n + " | cat\n"));
+        expect += n + "\na " + n + "\n";
+    }
+    for (size_t workers : { 1, 3, 8, 64 }) {
+        std::vector<int> statuses;
+        int status;
+        ASSERT_EQ(expect, run_scripts(paths, workers, statuses, &status));
+        ASSERT_EQ(0, status);
+    }
+    for (const std::string &path : paths) {
+        unlink(path.c_str());
+    }
+}
+
+TEST(RunnerSpec, per_script_status)
+{
+    std::vector<std::string> paths = {
+        write_script("true\n"),
+        write_script("true\nfalse\n"),
+        "/tmp/thsh-runner-does-not-exist",
+        write_script("false\ntrue\n"),
+    };
+    std::vector<int> statuses;
+    int status;
+    run_scripts(paths, 2, statuses, &status);
+    ASSERT_EQ(0, statuses[0]);
+    ASSERT_EQ(1, statuses[1]);
+    ASSERT_EQ(EXIT_NOT_FOUND, statuses[2]);
+    ASSERT_EQ(0, statuses[3]);
+    ASSERT_EQ(EXIT_NOT_FOUND, status);
+    unlink(paths[0].c_str());
+    unlink(paths[1].c_str());
+    unlink(paths[3].c_str());
+}
+
+TEST(RunnerSpec, no_scripts)
+{
+    std::vector<int> statuses;
+    int status;
+    ASSERT_EQ("", run_scripts({}, 4, statuses, &status));
+    ASSERT_EQ(0, status);
+}
+
+TEST(RunnerSpec, script_cache)
+{
+    char dir[] = "/tmp/thsh-runner-cache-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    std::string body = "echo a | cat\n\nfor i in b c; do echo $i; done\nfalse && echo d || echo $(echo e)\n";
+    std::vector<std::string> paths = { write_script(body), write_script(body + "echo f\n") };
+    std::string expect = "a\nb\nc\ne\na\nb\nc\ne\nf\n";
+    std::vector<int> statuses;
+    int status;
+    /* Cold, then read back from the cache. */
+    ASSERT_EQ(expect, run_scripts(paths, 2, statuses, &status, dir));
+    ASSERT_EQ(expect, run_scripts(paths, 2, statuses, &status, dir));
+    ASSERT_EQ(0, status);
+
+    /* A changed script is parsed again, whatever its mtime. */
+    FILE *script = fopen(paths[0].c_str(), "w");
+    fputs("echo changed\n", script);
+    fclose(script);
+    ASSERT_EQ("changed\na\nb\nc\ne\nf\n", run_scripts(paths, 1, statuses, &status, dir));
+    ASSERT_EQ("changed\na\nb\nc\ne\nf\n", run_scripts(paths, 1, statuses, &status, dir));
+    for (const std::string &path : paths) {
+        unlink(path.c_str());
+    }
+    std::string command = std::string("rm -rf ") + dir;
+    ASSERT_EQ(0, system(command.c_str()));
+}
+
+TEST(RunnerSpec, lists_and_loops_span_lines)
+{
+    char dir[] = "/tmp/thsh-runner-cache-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    std::vector<std::string> paths = {
+        write_script("for i in a b\ndo\n  echo $i\ndone\necho one |\ncat\nfalse ||\n\necho two\n"),
+        write_script("echo before\nfor i in a; do\necho $i\n"),
+        write_script("echo before\nfor i in a; done\necho after\n"),
+        write_script("echo x &&\n"),
+    };
+    for (const char *cache_dir : { (const char*) NULL, (const char*) dir, (const char*) dir }) {
+        std::vector<int> statuses;
+        int status;
+        ASSERT_EQ("a\nb\none\ntwo\nbefore\nbefore\n",
+                run_scripts(paths, 2, statuses, &status, cache_dir));
+        ASSERT_EQ(std::vector<int>({ 0, EXIT_SYNTAX_ERROR, EXIT_SYNTAX_ERROR, EXIT_SYNTAX_ERROR }),
+                statuses);
+        ASSERT_EQ(EXIT_SYNTAX_ERROR, status);
+    }
+    for (const std::string &path : paths) {
+        unlink(path.c_str());
+    }
+    std::string command = std::string("rm -rf ") + dir;
+    ASSERT_EQ(0, system(command.c_str()));
+}
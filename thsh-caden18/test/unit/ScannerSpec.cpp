@@ -12,31 +12,26 @@ static Scanner fixture(const char *cstr)
     return Scanner_value(CharItr_of_Str(&input));
 }
 
-static Token Token_init(TokenType type, const char *cstr)
-{
-    Token token = {
-        type,
-        Str_from(cstr)
-    };
-    return token;
-}
+typedef struct Expected {
+    TokenType type;
+    const char *lexeme;
+} Expected;
 
-static void ASSERT_TOKEN_EQ(Token expect, Token actual)
+static void ASSERT_TOKEN_EQ(Expected expect, Token actual, const char *source)
 {
     ASSERT_EQ(expect.type, actual.type);
-    ASSERT_STREQ(Str_cstr(&expect.lexeme), Str_cstr(&actual.lexeme));
+    ASSERT_EQ(std::string(expect.lexeme),
+            std::string(Token_lexeme(actual, source), actual.length));
 }
 
-static void ASSERT_TOKENS_EQ(Token expected[], size_t count, Scanner s)
+static void ASSERT_TOKENS_EQ(Expected expected[], size_t count, Scanner s)
 {
     for (size_t i = 0; i < count; ++i) {
         ASSERT_TRUE(Scanner_has_next(&s));
-        Token expect = expected[i];
-        ASSERT_TOKEN_EQ(expect, Scanner_peek(&s));
+        Expected expect = expected[i];
+        ASSERT_TOKEN_EQ(expect, Scanner_peek(&s), s.source);
         Token next = Scanner_next(&s);
-        ASSERT_TOKEN_EQ(expect, next);
-        Str_drop(&expect.lexeme);
-        Str_drop(&next.lexeme);
+        ASSERT_TOKEN_EQ(expect, next, s.source);
     }
     ASSERT_FALSE(Scanner_has_next(&s));
 }
@@ -53,86 +48,214 @@ TEST(ScannerSpec, empty_string)
 TEST(ScannerSpec, single_word)
 {
     Scanner scanner = fixture("ls");
-    Token expected[] = {
-        { WORD_TOKEN, Str_from("ls") }
+    Expected expected[] = {
+        { WORD_TOKEN, "ls" }
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, single_word_special_chars)
 {
     Scanner scanner = fixture("hello-world-123");
-    Token expected[] = {
-        { WORD_TOKEN, Str_from("hello-world-123") }
+    Expected expected[] = {
+        { WORD_TOKEN, "hello-world-123" }
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, single_word_with_whitespace)
 {
     Scanner scanner = fixture(" \t ls  \t");
-    Token expected[] = {
-        { WORD_TOKEN, Str_from("ls") }
+    Expected expected[] = {
+        { WORD_TOKEN, "ls" }
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, two_words)
 {
     Scanner scanner = fixture("ls -lah");
-    Token expected[] = {
-        { WORD_TOKEN, Str_from("ls") },
-        { WORD_TOKEN, Str_from("-lah") },
+    Expected expected[] = {
+        { WORD_TOKEN, "ls" },
+        { WORD_TOKEN, "-lah" },
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, many_words)
 {
     Scanner scanner = fixture("the quick brown fox jumped over the fence");
-    Token expected[] = {
-        { WORD_TOKEN, Str_from("the") },
-        { WORD_TOKEN, Str_from("quick") },
-        { WORD_TOKEN, Str_from("brown") },
-        { WORD_TOKEN, Str_from("fox") },
-        { WORD_TOKEN, Str_from("jumped") },
-        { WORD_TOKEN, Str_from("over") },
-        { WORD_TOKEN, Str_from("the") },
-        { WORD_TOKEN, Str_from("fence") },
+    Expected expected[] = {
+        { WORD_TOKEN, "the" },
+        { WORD_TOKEN, "quick" },
+        { WORD_TOKEN, "brown" },
+        { WORD_TOKEN, "fox" },
+        { WORD_TOKEN, "jumped" },
+        { WORD_TOKEN, "over" },
+        { WORD_TOKEN, "the" },
+        { WORD_TOKEN, "fence" },
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, single_pipe)
 {
     Scanner scanner = fixture("|");
-    Token expected[] = {
-        { PIPE_TOKEN, Str_from("|") },
+    Expected expected[] = {
+        { PIPE_TOKEN, "|" },
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, whitespace_pipe)
 {
     Scanner scanner = fixture(" \t | \t ");
-    Token expected[] = {
-        { PIPE_TOKEN, Str_from("|") },
+    Expected expected[] = {
+        { PIPE_TOKEN, "|" },
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
 }
 
 TEST(ScannerSpec, many_words_and_pipes)
 {
     Scanner scanner = fixture("  \t the | \t quick \t \t brown | fox \t   | jumped   ");
-    Token expected[] = {
-        { WORD_TOKEN, Str_from("the") },
-        { PIPE_TOKEN, Str_from("|") },
-        { WORD_TOKEN, Str_from("quick") },
-        { WORD_TOKEN, Str_from("brown") },
-        { PIPE_TOKEN, Str_from("|") },
-        { WORD_TOKEN, Str_from("fox") },
-        { PIPE_TOKEN, Str_from("|") },
-        { WORD_TOKEN, Str_from("jumped") },
+    Expected expected[] = {
+        { WORD_TOKEN, "the" },
+        { PIPE_TOKEN, "|" },
+        { WORD_TOKEN, "quick" },
+        { WORD_TOKEN, "brown" },
+        { PIPE_TOKEN, "|" },
+        { WORD_TOKEN, "fox" },
+        { PIPE_TOKEN, "|" },
+        { WORD_TOKEN, "jumped" },
+    };
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
+}
+
+TEST(ScannerSpec, redirect_operators)
+{
+    Scanner scanner = fixture("sort<in >out>>log 2>err 2>&1 x2>y 2 > z");
+    Expected expected[] = {
+        { WORD_TOKEN, "sort" },
+        { LESS_TOKEN, "<" },
+        { WORD_TOKEN, "in" },
+        { GREAT_TOKEN, ">" },
+        { WORD_TOKEN, "out" },
+        { DGREAT_TOKEN, ">>" },
+        { WORD_TOKEN, "log" },
+        { ERR_GREAT_TOKEN, "2>" },
+        { WORD_TOKEN, "err" },
+        { ERR_TO_OUT_TOKEN, "2>&1" },
+        { WORD_TOKEN, "x2" },
+        { GREAT_TOKEN, ">" },
+        { WORD_TOKEN, "y" },
+        { WORD_TOKEN, "2" },
+        { GREAT_TOKEN, ">" },
+        { WORD_TOKEN, "z" },
+    };
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
+}
+
+TEST(ScannerSpec, list_operators)
+{
+    Scanner scanner = fixture("a;b&&c||d & e|f 2>&1&&g;;");
+    Expected expected[] = {
+        { WORD_TOKEN, "a" },
+        { SEMI_TOKEN, ";" },
+        { WORD_TOKEN, "b" },
+        { AND_IF_TOKEN, "&&" },
+        { WORD_TOKEN, "c" },
+        { OR_IF_TOKEN, "||" },
+        { WORD_TOKEN, "d" },
+        { AMP_TOKEN, "&" },
+        { WORD_TOKEN, "e" },
+        { PIPE_TOKEN, "|" },
+        { WORD_TOKEN, "f" },
+        { ERR_TO_OUT_TOKEN, "2>&1" },
+        { AND_IF_TOKEN, "&&" },
+        { WORD_TOKEN, "g" },
+        { SEMI_TOKEN, ";" },
+        { SEMI_TOKEN, ";" },
+    };
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
+}
+
+TEST(ScannerSpec, substitutions_are_part_of_words)
+{
+    Scanner scanner = fixture("echo $(ls | wc -l)x `date >&2` $(a $(b) (c)) $HOME|$(open");
+    Expected expected[] = {
+        { WORD_TOKEN, "echo" },
+        { WORD_TOKEN, "$(ls | wc -l)x" },
+        { WORD_TOKEN, "`date >&2`" },
+        { WORD_TOKEN, "$(a $(b) (c))" },
+        { WORD_TOKEN, "$HOME" },
+        { PIPE_TOKEN, "|" },
+        { WORD_TOKEN, "$(open" },
+    };
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), scanner);
+}
+
+TEST(ScannerSpec, variables)
+{
+    const char *texts[] = { "$x", "${long_name2}rest", "$_9-", "$9", "${x", "${}", "$", "x" };
+    size_t lengths[] = { 2, 13, 3, 0, 0, 0, 0, 0 };
+    size_t names[] = { 1, 2, 1 };
+    size_t name_lengths[] = { 1, 10, 2 };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+        size_t name, name_length;
+        ASSERT_EQ(lengths[i], Scanner_variable(texts[i], strlen(texts[i]), &name, &name_length));
+        if (lengths[i] > 0) {
+            ASSERT_EQ(names[i], name);
+            ASSERT_EQ(name_lengths[i], name_length);
+        }
+    }
+}
+
+TEST(ScannerSpec, tokens_are_compact)
+{
+    ASSERT_LE(sizeof(Token), 16);
+    Scanner s = fixture("ls");
+    Token token = Scanner_peek(&s);
+    ASSERT_EQ(0, token.offset);
+    ASSERT_EQ(2, token.length);
+}
+
+TEST(ScannerSpec, token_flags)
+{
+    Scanner s = fixture("a b|c\n  d");
+    uint8_t flags[] = {
+        TOKEN_SPACE_BEFORE | TOKEN_LINE_START,
+        TOKEN_SPACE_BEFORE,
+        0,
+        0,
+        TOKEN_SPACE_BEFORE | TOKEN_LINE_START,
+    };
+    for (uint8_t expect : flags) {
+        ASSERT_EQ(expect, Scanner_next(&s).flags);
+    }
+    ASSERT_FALSE(Scanner_has_next(&s));
+}
+
+TEST(ScannerSpec, mark_and_reset)
+{
+    Scanner s = fixture("a | b c");
+    Scanner_next(&s);
+    ScannerMark mark = Scanner_mark(&s);
+    ASSERT_EQ(PIPE_TOKEN, Scanner_next(&s).type);
+    ASSERT_EQ(WORD_TOKEN, Scanner_next(&s).type);
+    ScannerMark end = Scanner_mark(&s);
+    Scanner_next(&s);
+    ASSERT_FALSE(Scanner_has_next(&s));
+
+    Scanner_reset(&s, mark);
+    Expected expected[] = {
+        { PIPE_TOKEN, "|" },
+        { WORD_TOKEN, "b" },
+        { WORD_TOKEN, "c" },
     };
-    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Token), scanner);
+    ASSERT_TOKENS_EQ(expected, sizeof(expected) / sizeof(Expected), s);
+
+    Scanner_reset(&s, end);
+    ASSERT_EQ(6, Scanner_next(&s).offset);
+    ASSERT_FALSE(Scanner_has_next(&s));
 }
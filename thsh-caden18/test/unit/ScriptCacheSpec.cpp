@@ -0,0 +1,323 @@
+#include "gtest/gtest.h"
+#include "SpecHelpers.h"
+
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+#include "Exec.h"
+#include "Parser.h"
+#include "ScriptCache.h"
+}
+
+/** HELPER FUNCTIONS **/
+
+static std::string encoded(const Node *tree)
+{
+    ScriptEncoder encoder = ScriptEncoder_value();
+    ScriptEncoder_add(&encoder, tree);
+    std::string bytes(Str_cstr(&encoder.bytes), Str_length(&encoder.bytes));
+    ScriptEncoder_drop(&encoder);
+    return bytes;
+}
+
+static std::string make_dir()
+{
+    char dir[] = "/tmp/thsh-script-cache-XXXXXX";
+    EXPECT_NE(nullptr, mkdtemp(dir));
+    return dir;
+}
+
+/* An empty script in `dir`, which cache files there are kept for. */
+static std::string make_source(const std::string &dir, const char *name = "script")
+{
+    std::string path = dir + "/" + name;
+    FILE *file = fopen(path.c_str(), "w");
+    EXPECT_NE(nullptr, file);
+    fclose(file);
+    return path;
+}
+
+static void remove_dir(const std::string &dir)
+{
+    std::string command = "rm -rf " + dir;
+    ASSERT_EQ(0, system(command.c_str()));
+}
+
+/* The only file in `dir`. */
+static std::string cache_file(const std::string &dir)
+{
+    std::string command = "ls " + dir + "/*.thc";
+    FILE *ls = popen(command.c_str(), "r");
+    char path[256] = "";
+    EXPECT_NE(nullptr, fgets(path, sizeof(path), ls));
+    pclose(ls);
+    std::string result = path;
+    result.erase(result.find_last_not_of('\n') + 1);
+    return result;
+}
+
+/* Fails unless each substitution of the pipeline `tree` without a tree is a variable. */
+static void ASSERT_VARIABLES_WHOLE(const Node *tree)
+{
+    if (tree->type == PIPE_NODE) {
+        ASSERT_VARIABLES_WHOLE(tree->data.pipe.left);
+        ASSERT_VARIABLES_WHOLE(tree->data.pipe.right);
+    } else if (tree->type == COMMAND_NODE) {
+        const CommandValue *command = &tree->data.command;
+        const Substitution *substitutions = Command_substitutions(command);
+        for (size_t i = 0; i < Command_substitution_count(command); ++i) {
+            const Substitution *substitution = &substitutions[i];
+            if (substitution->tree == NULL) {
+                size_t name, length;
+                const char *text = Command_word(command, substitution->word) + substitution->start;
+                ASSERT_EQ(substitution->length,
+                        Scanner_variable(text, substitution->length, &name, &length));
+            }
+        }
+    }
+}
+
+static const ScriptKey KEY = { 0x1234, 42, 1700000000, 5 };
+
+/** TESTS **/
+
+TEST(ScriptCacheSpec, trees_round_trip)
+{
+    const char *lines[] = {
+        "echo a",
+        "ls -l a b c d e | grep x > out 2> err < in >> log 2>&1",
+        "echo $(echo `date` $(true)) ${HOME}x$y",
+        "sleep 1 | cat &",
+        "a; b && c || d; e &",
+        "for i in a $(ls); do echo $i && for j in b; do true; done; done",
+        "while false; do echo a | cat; done; echo b",
+        "echo a |",
+        "done",
+    };
+    std::string dir = make_dir();
+    std::string source = make_source(dir);
+    ScriptEncoder encoder = ScriptEncoder_value();
+    std::vector<std::string> expect;
+    for (const char *line : lines) {
+        Node *tree = fixture(line);
+        ScriptEncoder_add(&encoder, tree);
+        expect.push_back(encoded(tree));
+        Node_drop(tree);
+    }
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), source.c_str(), &KEY));
+    ScriptEncoder_drop(&encoder);
+
+    CachedScript cached;
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    Arena arena = Arena_value(4096);
+    for (const std::string &bytes : expect) {
+        Node *tree = CachedScript_next(&cached, Arena_allocator(&arena));
+        ASSERT_NE(nullptr, tree);
+        ASSERT_EQ(bytes, encoded(tree));
+        Node_drop(tree);
+        Arena_reset(&arena);
+    }
+    ASSERT_EQ(nullptr, CachedScript_next(&cached, Arena_allocator(&arena)));
+    CachedScript_drop(&cached);
+    Arena_drop(&arena);
+    remove_dir(dir);
+}
+
+TEST(ScriptCacheSpec, long_lists_round_trip)
+{
+    std::string line = "true";
+    for (int i = 0; i < 100000; ++i) {
+        line += " && true";
+    }
+    Node *tree = fixture(line.c_str());
+    std::string bytes = encoded(tree);
+    std::string dir = make_dir();
+    std::string source = make_source(dir);
+    ScriptEncoder encoder = ScriptEncoder_value();
+    ScriptEncoder_add(&encoder, tree);
+    Node_drop(tree);
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), source.c_str(), &KEY));
+    ScriptEncoder_drop(&encoder);
+    CachedScript cached;
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    tree = CachedScript_next(&cached, &LIBC_ALLOCATOR);
+    ASSERT_EQ(bytes, encoded(tree));
+    Node_drop(tree);
+    CachedScript_drop(&cached);
+    remove_dir(dir);
+}
+
+TEST(ScriptCacheSpec, other_keys_miss)
+{
+    std::string dir = make_dir();
+    std::string source = make_source(dir);
+    CachedScript cached;
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    ScriptEncoder encoder = ScriptEncoder_value();
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), source.c_str(), &KEY));
+    ScriptEncoder_drop(&encoder);
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    ASSERT_EQ(nullptr, CachedScript_next(&cached, &LIBC_ALLOCATOR));
+    CachedScript_drop(&cached);
+
+    ScriptKey touched = KEY;
+    touched.mtime_nsec += 1;
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &touched));
+    ScriptKey edited = KEY;
+    edited.hash += 1;
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &edited));
+    remove_dir(dir);
+}
+
+TEST(ScriptCacheSpec, one_file_per_script)
+{
+    std::string dir = make_dir();
+    std::string source = make_source(dir);
+    std::string other = make_source(dir, "other");
+    std::string files = "ls " + dir + "/*.thc | wc -l";
+    ScriptEncoder encoder = ScriptEncoder_value();
+    ScriptKey edited = KEY;
+    for (int edit = 0; edit < 3; ++edit) {
+        edited.hash += 1;
+        ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), source.c_str(), &edited));
+    }
+    /* The same script by another path. */
+    std::string alias = dir + "/./script";
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), alias.c_str(), &edited));
+    FILE *ls = popen(files.c_str(), "r");
+    int count = 0;
+    ASSERT_EQ(1, fscanf(ls, "%d", &count));
+    pclose(ls);
+    ASSERT_EQ(1, count);
+
+    CachedScript cached;
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &edited));
+    CachedScript_drop(&cached);
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), other.c_str(), &edited));
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), other.c_str(), &edited));
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), other.c_str(), &edited));
+    CachedScript_drop(&cached);
+
+    std::string missing = dir + "/missing";
+    ASSERT_FALSE(ScriptEncoder_save(&encoder, dir.c_str(), missing.c_str(), &edited));
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), missing.c_str(), &edited));
+    ScriptEncoder_drop(&encoder);
+    remove_dir(dir);
+}
+
+TEST(ScriptCacheSpec, keys_follow_content_and_mtime)
+{
+    char path[] = "/tmp/thsh-script-key-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_EQ(6, write(fd, "echo a", 6));
+    ScriptKey first, second, third;
+    ASSERT_TRUE(ScriptKey_of(fd, &first));
+    ASSERT_EQ(6u, first.size);
+    ASSERT_EQ(5, lseek(fd, 5, SEEK_SET));
+    ASSERT_EQ(1, write(fd, "b", 1));
+    ASSERT_TRUE(ScriptKey_of(fd, &second));
+    ASSERT_NE(first.hash, second.hash);
+    struct timespec times[2] = { { 0, UTIME_OMIT }, { 1000, 0 } };
+    ASSERT_EQ(0, futimens(fd, times));
+    ASSERT_TRUE(ScriptKey_of(fd, &third));
+    ASSERT_EQ(second.hash, third.hash);
+    ASSERT_EQ(1000, third.mtime_sec);
+    close(fd);
+    unlink(path);
+
+    ScriptKey key;
+    ASSERT_FALSE(ScriptKey_of(-1, &key));
+}
+
+TEST(ScriptCacheSpec, damaged_files)
+{
+    std::string dir = make_dir();
+    std::string source = make_source(dir);
+    ScriptEncoder encoder = ScriptEncoder_value();
+    Node *tree = fixture("echo $(echo a b c) ${HOME}x$y | cat > out");
+    ScriptEncoder_add(&encoder, tree);
+    ScriptEncoder_add(&encoder, tree);
+    Node_drop(tree);
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), source.c_str(), &KEY));
+    size_t length = Str_length(&encoder.bytes);
+    ScriptEncoder_drop(&encoder);
+    std::string path = cache_file(dir);
+
+    /* Every byte of the lines overwritten in turn. */
+    CachedScript cached;
+    Arena arena = Arena_value(4096);
+    int fd = open(path.c_str(), O_RDWR);
+    off_t header = lseek(fd, 0, SEEK_END) - length;
+    for (size_t i = 0; i < length; ++i) {
+        char byte, garbage = (char) 0xff;
+        ASSERT_EQ(1, pread(fd, &byte, 1, header + i));
+        ASSERT_EQ(1, pwrite(fd, &garbage, 1, header + i));
+        ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+        while ((tree = CachedScript_next(&cached, Arena_allocator(&arena))) != NULL) {
+            ASSERT_VARIABLES_WHOLE(tree);
+            Node_drop(tree);
+        }
+        CachedScript_drop(&cached);
+        Arena_reset(&arena);
+        ASSERT_EQ(1, pwrite(fd, &byte, 1, header + i));
+    }
+
+    /* A variable whose '$' is gone is not one, and cannot be expanded. */
+    std::string bytes(length, '\0');
+    ASSERT_EQ((ssize_t) length, pread(fd, &bytes[0], length, header));
+    size_t dollar = bytes.find("${HOME}");
+    ASSERT_NE(std::string::npos, dollar);
+    ASSERT_EQ(1, pwrite(fd, "x", 1, header + dollar));
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    tree = CachedScript_next(&cached, &LIBC_ALLOCATOR);
+    ASSERT_EQ(ERROR_NODE, tree->type);
+    ASSERT_EQ(SCRIPT_CACHE_CORRUPT, tree->data.error);
+    Node_drop(tree);
+    ASSERT_EQ(nullptr, CachedScript_next(&cached, &LIBC_ALLOCATOR));
+    CachedScript_drop(&cached);
+    ASSERT_EQ(1, pwrite(fd, "$", 1, header + dollar));
+
+    /* A truncated file is not even opened; its header says how long it is. */
+    ASSERT_EQ(0, ftruncate(fd, header + length - 1));
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    ASSERT_EQ(0, ftruncate(fd, 4));
+    ASSERT_FALSE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    close(fd);
+    Arena_drop(&arena);
+
+    /* The lines of a file cut short within a tree end in an error. */
+    encoder = ScriptEncoder_value();
+    tree = fixture("echo a");
+    ScriptEncoder_add(&encoder, tree);
+    Node_drop(tree);
+    encoder.lines = 2;
+    ASSERT_TRUE(ScriptEncoder_save(&encoder, dir.c_str(), source.c_str(), &KEY));
+    ScriptEncoder_drop(&encoder);
+    ASSERT_TRUE(CachedScript_open(&cached, dir.c_str(), source.c_str(), &KEY));
+    tree = CachedScript_next(&cached, &LIBC_ALLOCATOR);
+    ASSERT_EQ(COMMAND_NODE, tree->type);
+    Node_drop(tree);
+    tree = CachedScript_next(&cached, &LIBC_ALLOCATOR);
+    ASSERT_EQ(ERROR_NODE, tree->type);
+    ASSERT_EQ(SCRIPT_CACHE_CORRUPT, tree->data.error);
+    Node_drop(tree);
+    ASSERT_EQ(nullptr, CachedScript_next(&cached, &LIBC_ALLOCATOR));
+    CachedScript_drop(&cached);
+    remove_dir(dir);
+}
+
+TEST(ScriptCacheSpec, default_dir)
+{
+    const char *saved = getenv("THSH_CACHE_DIR");
+    std::string previous = saved != NULL ? saved : "";
+    setenv("THSH_CACHE_DIR", "/tmp/thsh-cache-dir", 1);
+    Str dir = ScriptCache_dir();
+    ASSERT_STREQ("/tmp/thsh-cache-dir", Str_cstr(&dir));
+    Str_drop(&dir);
+    if (saved != NULL) {
+        setenv("THSH_CACHE_DIR", previous.c_str(), 1);
+    } else {
+        unsetenv("THSH_CACHE_DIR");
+    }
+}
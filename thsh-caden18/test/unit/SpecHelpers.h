@@ -0,0 +1,41 @@
+#ifndef SPEC_HELPERS_H
+#define SPEC_HELPERS_H
+
+#include <string>
+
+extern "C" {
+#include <stdio.h>
+#include <unistd.h>
+#include "Parser.h"
+}
+
+/*
+ * Helpers shared by the specs that parse command lines and read back what
+ * they wrote.
+ */
+
+/* Parse `cstr` into a tree owned by the caller. */
+inline Node* fixture(const char *cstr)
+{
+    Str input = Str_from(cstr);
+    Scanner scanner = Scanner_value(CharItr_of_Str(&input));
+    Node *tree = parse(&scanner);
+    Str_drop(&input);
+    return tree;
+}
+
+/* Read back everything written to a tmpfile. */
+inline std::string contents(FILE *file)
+{
+    fflush(file);
+    std::string out;
+    char buffer[256];
+    lseek(fileno(file), 0, SEEK_SET);
+    ssize_t n;
+    while ((n = read(fileno(file), buffer, sizeof(buffer))) > 0) {
+        out.append(buffer, n);
+    }
+    return out;
+}
+
+#endif